@@ -151,7 +151,7 @@ SHOURNAL_SET_VERBOSITY(){
 
 # Do *not* touch the next line. The version is updated automatically on build from cmake according
 # to the version set there
-_shournal_version=2.3
+_shournal_version=2.4
 
 # 0: debug, 1: info, 2: warning, 3: error
 [[ -z ${_shournal_bash_integration_log_level+x} ]] && _shournal_bash_integration_log_level=2
@@ -245,7 +245,8 @@ _libshournal_is_loaded(){
 _shournal_trigger_update(){
     # trigger is unset immediately in our .so, if active
     export _LIBSHOURNAL_TRIGGER=$1
-    echo '' > /dev/null # close event is recorded in our .so
+    # our .so only checks for the trigger when /dev/null is opened
+    echo '' > /dev/null
 }
 
 _shournal_get_current_cmd(){
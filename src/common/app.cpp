@@ -17,6 +17,7 @@ static_assert (false, "SHOURNAL_MSENTERGROUP not defined");
 
 const char* app::SHOURNAL = "shournal";
 const char* app::SHOURNAL_RUN = "shournal-run";
+const char* app::SHOURNAL_MSENTER = "shournal-msenter";
 // groupnames should be smaller than 16 characters (portability).
 const char* app::MSENTER_ONLY_GROUP = SHOURNAL_MSENTERGROUP; // defined in cmake
 const char* app::ENV_VAR_SOCKET_NB = "_SHOURNAL_SOCKET_NB";
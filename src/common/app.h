@@ -6,6 +6,7 @@ namespace app {
 
 const extern char* SHOURNAL;
 const extern char* SHOURNAL_RUN;
+const extern char* SHOURNAL_MSENTER;
 const extern char* MSENTER_ONLY_GROUP;
 const extern char* ENV_VAR_SOCKET_NB;
 
@@ -54,19 +54,22 @@ CXXHash::DigestResult CXXHash::digestWholeFile(int fd, int bufSize)
 ///                 performed at all.
 /// @param maxCountOfReads stop reading and digest after that count of 'read'-
 ///                        operations.
+/// @param startOffset the offset at which the data to digest starts. The seed
+///                    must already be there.
 /// @returns the calculated hash, the count of bytes read and the actual count
 ///          of reads which is never greater than param maxCountOfReads.
 ///          If the actual count of reads is zero, the hash is invalid.
 /// @throws ExcOs, CXXHashError
 CXXHash::DigestResult CXXHash::digestFile(int fd, int bufSize,
-                                off64_t seekstep, int maxCountOfReads)
+                                off64_t seekstep, int maxCountOfReads,
+                                off64_t startOffset)
 {
     m_buf.resize(bufSize);
     this->reset(0);
     const bool doSeek = seekstep > bufSize;
 
     DigestResult res {0, 0, 0};
-    off64_t offset=0;
+    off64_t offset=startOffset;
 
     for(res.countOfReads=0; res.countOfReads < maxCountOfReads ; ++res.countOfReads) {
         ssize_t readBytes = os::read(fd, m_buf.data(), static_cast<size_t>(m_buf.size()));
@@ -39,7 +39,8 @@ public:
 
     DigestResult digestWholeFile(int fd, int bufSize);
     DigestResult digestFile(int fd, int bufSize, off64_t seekstep,
-                            int maxCountOfReads=std::numeric_limits<int>::max());
+                            int maxCountOfReads=std::numeric_limits<int>::max(),
+                            off64_t startOffset=0);
 
 public:
     CXXHash(const CXXHash&) = delete;
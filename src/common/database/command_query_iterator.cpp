@@ -1,30 +1,50 @@
 
 #include <QDebug>
+#include <QHash>
+#include <algorithm>
+
 #include "command_query_iterator.h"
 #include "util.h"
 #include "db_connection.h"
 #include "db_conversions.h"
 #include "db_controller.h"
 
+const int CommandQueryIterator::DEFAULT_PAGE_SIZE = 256;
+
+namespace  {
+
+int toSqlLimit(int maxCount){
+    return (maxCount == std::numeric_limits<int>::max()) ? SqlQuery::NO_LIMIT : maxCount;
+}
+
+} // namespace
 
-///  @param reverseIter: if true, instead of calling next(), previous() will be called
-/// on the passed query.
-CommandQueryIterator::CommandQueryIterator(std::shared_ptr<QSqlQueryThrow>& query, bool reverseIter) :
+/// @param query: an executed query, whose columns are in the order
+/// expected by fillCommand.
+CommandQueryIterator::CommandQueryIterator(std::shared_ptr<QSqlQueryThrow>& query) :
     m_cmdQuery(query),
     m_tmpQuery(db_connection::mkQuery()),
-    m_reverseIter(reverseIter)
+    m_pageSize(DEFAULT_PAGE_SIZE)
 {
+    m_tmpQuery->setForwardOnly(true);
 }
 
-// set cursor to next or previous, if reverseIter was set on constructor
 bool CommandQueryIterator::next()
 {
     m_cmd.clear();
-    const bool nextRet = (m_reverseIter) ? m_cmdQuery->previous() : m_cmdQuery->next();
-    if(nextRet){
-        fillCommand();
+    if(! hasNext()){
+        return false;
     }
-    return nextRet;
+    m_pageIdx++;
+    m_cmd = std::move(m_page[m_pageIdx]);
+    return true;
+}
+
+/// Cheap peek, whether a following call of next() succeeds, e.g. to
+/// test for an empty result.
+bool CommandQueryIterator::hasNext()
+{
+    return m_pageIdx + 1 < m_page.size() || fetchPage();
 }
 
 CommandInfo &CommandQueryIterator::value()
@@ -32,57 +52,182 @@ CommandInfo &CommandQueryIterator::value()
     return m_cmd;
 }
 
-int CommandQueryIterator::computeSize()
+int CommandQueryIterator::pageSize() const
 {
-    return m_cmdQuery->computeSize();
+    return m_pageSize;
 }
 
+/// @param pageSize: the number of commands, whose file events are
+/// fetched at once. Larger pages mean less queries but more memory.
+void CommandQueryIterator::setPageSize(int pageSize)
+{
+    m_pageSize = std::max(pageSize, 1);
+}
 
+const CmdQueryProjection &CommandQueryIterator::projection() const
+{
+    return m_projection;
+}
+
+/// Must be set before the first call of next() or hasNext()
+void CommandQueryIterator::setProjection(const CmdQueryProjection &projection)
+{
+    m_projection = projection;
+}
 
-void CommandQueryIterator::fillCommand()
+/// Read the next page of commands and prefetch their file events.
+/// @return false, if no commands are left.
+bool CommandQueryIterator::fetchPage()
+{
+    m_page.clear();
+    m_pageIdx = -1;
+    QVector<qint64> cmdIds;
+    cmdIds.reserve(m_pageSize);
+    QHash<qint64, int> pageIdxById;
+    while(m_page.size() < m_pageSize && m_cmdQuery->next()){
+        m_page.push_back(CommandInfo());
+        fillCommand(m_page.last());
+        cmdIds.push_back(m_page.last().idInDb);
+        pageIdxById.insert(m_page.last().idInDb, m_page.size() - 1);
+    }
+    if(m_page.isEmpty()){
+        return false;
+    }
+    fillWrittenFiles(cmdIds, pageIdxById);
+    fillReadFiles(cmdIds, pageIdxById);
+    if(m_projection.fileCountsPerDir){
+        fillFileCountsPerDir(cmdIds, pageIdxById);
+    }
+    return true;
+}
+
+
+void CommandQueryIterator::fillCommand(CommandInfo& cmd)
 {
     int i=0;
-    m_cmd.idInDb = qVariantTo_throw<qint64>(m_cmdQuery->value(i++));
-    m_cmd.text = m_cmdQuery->value(i++).toString();
-    m_cmd.returnVal = m_cmdQuery->value(i++).toInt();
-    m_cmd.startTime = m_cmdQuery->value(i++).toDateTime();
-    m_cmd.endTime = m_cmdQuery->value(i++).toDateTime();
-    m_cmd.workingDirectory = m_cmdQuery->value(i++).toString();
+    cmd.idInDb = qVariantTo_throw<qint64>(m_cmdQuery->value(i++));
+    cmd.text = m_cmdQuery->value(i++).toString();
+    cmd.returnVal = m_cmdQuery->value(i++).toInt();
+    cmd.startTime = db_conversions::toDateTime(m_cmdQuery->value(i++));
+    cmd.endTime = db_conversions::toDateTime(m_cmdQuery->value(i++));
+    cmd.workingDirectory = m_cmdQuery->value(i++).toString();
 
-    m_cmd.sessionInfo.uuid = m_cmdQuery->value(i++).toByteArray();
-    m_cmd.sessionInfo.comment = m_cmdQuery->value(i++).toString();
+    cmd.sessionInfo.uuid = m_cmdQuery->value(i++).toByteArray();
+    cmd.sessionInfo.comment = m_cmdQuery->value(i++).toString();
 
     QVariant hashChunksize = m_cmdQuery->value(i++);
     if(! hashChunksize.isNull()){
-        qVariantTo_throw(hashChunksize, &m_cmd.hashMeta.chunkSize) ;
-        qVariantTo_throw(m_cmdQuery->value(i++), &m_cmd.hashMeta.maxCountOfReads);
+        qVariantTo_throw(hashChunksize, &cmd.hashMeta.chunkSize) ;
+        qVariantTo_throw(m_cmdQuery->value(i++), &cmd.hashMeta.maxCountOfReads);
     } else {
         i++;
     }
-    m_cmd.username = m_cmdQuery->value(i++).toString();
-    m_cmd.hostname = m_cmdQuery->value(i++).toString();
-
-    fillWrittenFiles();
-    m_cmd.fileReadInfos = db_controller::queryReadInfos_byCmdId(m_cmd.idInDb);
+    cmd.username = m_cmdQuery->value(i++).toString();
+    cmd.hostname = m_cmdQuery->value(i++).toString();
 }
 
-void CommandQueryIterator::fillWrittenFiles()
+/// Query the written files of the page's commands, at most
+/// maxCountWFiles per command. If supported, the limit is applied by
+/// sqlite, otherwise here.
+void CommandQueryIterator::fillWrittenFiles(const QVector<qint64>& cmdIds,
+                                            const QHash<qint64, int>& pageIdxById)
 {
-    m_tmpQuery->prepare("select id,path,name,mtime,size,hash from writtenFile where cmdId=?");
-    m_tmpQuery->addBindValue(m_cmd.idInDb);
-    m_tmpQuery->exec();
+    const QString cmdIdList = db_conversions::idsToSqlList(cmdIds);
+    const int maxCount = toSqlLimit(m_projection.maxCountWFiles);
+    if(maxCount == 0){
+        m_tmpQuery->exec("select cmdId,count(*) from writtenFile "
+                         "where cmdId in (" + cmdIdList + ") group by cmdId");
+        while(m_tmpQuery->next()){
+            const auto cmdId = qVariantTo_throw<qint64>(m_tmpQuery->value(0));
+            m_page[pageIdxById.value(cmdId)].fileWriteCount = m_tmpQuery->value(1).toInt();
+        }
+        return;
+    }
+    const bool limitInSql = maxCount != SqlQuery::NO_LIMIT &&
+                            db_connection::supportsWindowFunctions();
+    QString queryStr = "select writtenFile.cmdId,writtenFile.id,directory.path,name,"
+                       "mtime,size,hash,process.exe ";
+    if(limitInSql){
+        queryStr += ",count(*) over (partition by writtenFile.cmdId),"
+                    "row_number() over (partition by writtenFile.cmdId "
+                    "order by writtenFile.id) as rowNum ";
+    }
+    queryStr += "from writtenFile "
+                "join directory on directory.id=writtenFile.dirId "
+                "left join process on process.id=writtenFile.processId "
+                "where writtenFile.cmdId in (" + cmdIdList + ")";
+    if(limitInSql){
+        queryStr = "select * from (" + queryStr + ") where rowNum <= " +
+                   QString::number(maxCount);
+    }
+    m_tmpQuery->exec(queryStr);
     while(m_tmpQuery->next()){
         int i=0;
+        const auto cmdId = qVariantTo_throw<qint64>(m_tmpQuery->value(i++));
+        CommandInfo& cmd = m_page[pageIdxById.value(cmdId)];
         FileWriteInfo fInfo;
         fInfo.idInDb = qVariantTo_throw<qint64>(m_tmpQuery->value(i++));
         fInfo.path = m_tmpQuery->value(i++).toString();
         fInfo.name = m_tmpQuery->value(i++).toString();
-        fInfo.mtime = m_tmpQuery->value(i++).toDateTime();
+        fInfo.mtime = db_conversions::toDateTime(m_tmpQuery->value(i++));
         fInfo.size =  qVariantTo_throw<qint64>(m_tmpQuery->value(i++));
         fInfo.hash = db_conversions::toHashValue(m_tmpQuery->value(i++));
-        m_cmd.fileWriteInfos.push_back(fInfo);
+        fInfo.processExe = m_tmpQuery->value(i++).toString();
+        cmd.fileWriteInfos.push_back(fInfo);
+        if(limitInSql){
+            cmd.fileWriteCount = m_tmpQuery->value(i++).toInt();
+        }
+    }
+    if(! limitInSql){
+        for(auto& cmd : m_page){
+            cmd.fileWriteCount = cmd.fileWriteInfos.size();
+            if(maxCount != SqlQuery::NO_LIMIT && cmd.fileWriteInfos.size() > maxCount){
+                cmd.fileWriteInfos.resize(maxCount);
+            }
+        }
     }
 }
 
+void CommandQueryIterator::fillReadFiles(const QVector<qint64>& cmdIds,
+                                         const QHash<qint64, int>& pageIdxById)
+{
+    QHash<qint64, int> totalCounts;
+    auto readInfosByCmdId = db_controller::queryReadInfos_byCmdIds(
+                cmdIds, m_tmpQuery, toSqlLimit(m_projection.maxCountRFiles), &totalCounts);
+    for(auto it = readInfosByCmdId.begin(); it != readInfosByCmdId.end(); ++it){
+        m_page[pageIdxById.value(it.key())].fileReadInfos = std::move(it.value());
+    }
+    for(auto it = totalCounts.begin(); it != totalCounts.end(); ++it){
+        m_page[pageIdxById.value(it.key())].fileReadCount = it.value();
+    }
+}
 
+/// Count the written and read files per directory (e.g. for statistics),
+/// which also works, if the file infos are limited.
+void CommandQueryIterator::fillFileCountsPerDir(const QVector<qint64>& cmdIds,
+                                                const QHash<qint64, int>& pageIdxById)
+{
+    const QString cmdIdList = db_conversions::idsToSqlList(cmdIds);
+    m_tmpQuery->exec("select writtenFile.cmdId,directory.path,count(*) from writtenFile "
+                     "join directory on directory.id=writtenFile.dirId "
+                     "where writtenFile.cmdId in (" + cmdIdList + ") "
+                     "group by writtenFile.cmdId,writtenFile.dirId");
+    while(m_tmpQuery->next()){
+        const auto cmdId = qVariantTo_throw<qint64>(m_tmpQuery->value(0));
+        auto& cmd = m_page[pageIdxById.value(cmdId)];
+        cmd.fileCountsPerDir[m_tmpQuery->value(1).toString()].writeCount =
+                m_tmpQuery->value(2).toInt();
+    }
 
+    m_tmpQuery->exec("select readFileCmd.cmdId,directory.path,count(*) from readFileCmd "
+                     "join readFile on readFile.id=readFileCmd.readFileId "
+                     "join directory on directory.id=readFile.dirId "
+                     "where readFileCmd.cmdId in (" + cmdIdList + ") "
+                     "group by readFileCmd.cmdId,readFile.dirId");
+    while(m_tmpQuery->next()){
+        const auto cmdId = qVariantTo_throw<qint64>(m_tmpQuery->value(0));
+        auto& cmd = m_page[pageIdxById.value(cmdId)];
+        cmd.fileCountsPerDir[m_tmpQuery->value(1).toString()].readCount =
+                m_tmpQuery->value(2).toInt();
+    }
+}
@@ -1,34 +1,65 @@
 #pragma once
 
 #include <memory>
+#include <limits>
+#include <QVector>
+#include <QHash>
 
 #include "qsqlquerythrow.h"
 #include "commandinfo.h"
 #include "db_connection.h"
 
+/// Declares which parts of the commands are needed by the consumer of
+/// a CommandQueryIterator, so less is queried. By default everything
+/// except the file counts per directory.
+struct CmdQueryProjection {
+    // query at most that many written/read file infos per command. The total
+    // counts are always set (CommandInfo::fileWriteCount/fileReadCount).
+    int maxCountWFiles {std::numeric_limits<int>::max()};
+    int maxCountRFiles {std::numeric_limits<int>::max()};
+    // fill CommandInfo::fileCountsPerDir (considering all files)
+    bool fileCountsPerDir {false};
+};
+
+/// Iterates over the commands of a (forward-only) query. The written and read files
+/// are not queried per command, but for a page of upcoming
+/// commands at once (see setPageSize), so memory stays constant
+/// on arbitrarily large results.
 class CommandQueryIterator
 {
 public:
-    CommandQueryIterator(std::shared_ptr<QSqlQueryThrow> &query, bool reverseIter);
+    static const int DEFAULT_PAGE_SIZE;
+
+    explicit CommandQueryIterator(std::shared_ptr<QSqlQueryThrow> &query);
 
     bool next();
+    bool hasNext();
 
     CommandInfo& value();
 
-    int computeSize();
+    int pageSize() const;
+    void setPageSize(int pageSize);
+
+    const CmdQueryProjection& projection() const;
+    void setProjection(const CmdQueryProjection &projection);
 
 public:
     CommandQueryIterator(const CommandQueryIterator &) = delete ;
     void operator=(const CommandQueryIterator &) = delete ;
 
 private:
-
-    void fillCommand();
-    void fillWrittenFiles();
+    bool fetchPage();
+    void fillCommand(CommandInfo& cmd);
+    void fillWrittenFiles(const QVector<qint64>& cmdIds, const QHash<qint64, int>& pageIdxById);
+    void fillReadFiles(const QVector<qint64>& cmdIds, const QHash<qint64, int>& pageIdxById);
+    void fillFileCountsPerDir(const QVector<qint64>& cmdIds,
+                              const QHash<qint64, int>& pageIdxById);
 
     std::shared_ptr<QSqlQueryThrow> m_cmdQuery;
     QueryPtr m_tmpQuery;
     CommandInfo m_cmd;
-    bool m_reverseIter;
+    int m_pageSize;
+    CmdQueryProjection m_projection;
+    QVector<CommandInfo> m_page;
+    int m_pageIdx {-1};
 };
-
@@ -137,6 +137,9 @@ void CommandInfo::clear()
 {
     fileWriteInfos.clear();
     fileReadInfos.clear();
+    fileWriteCount = 0;
+    fileReadCount = 0;
+    fileCountsPerDir.clear();
     idInDb = db::INVALID_INT_ID;
 }
 
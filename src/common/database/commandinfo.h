@@ -2,6 +2,7 @@
 
 #include <QString>
 #include <QVector>
+#include <QHash>
 #include <QJsonObject>
 
 #include "hashmeta.h"
@@ -48,6 +49,14 @@ struct CmdJsonWriteCfg {
     int maxCountRFiles{std::numeric_limits<int>::max()};
 };
 
+/// Number of written and read files of a command within a directory
+struct DirFileCount {
+    int writeCount {0};
+    int readCount {0};
+};
+
+typedef QHash<QString, DirFileCount> DirFileCounts;
+
 struct CommandInfo
 {
     // Invalid return value set, if no return value could be determined (e.g. because
@@ -72,6 +81,12 @@ struct CommandInfo
     FileWriteInfos fileWriteInfos;
     FileReadInfos fileReadInfos;
 
+    // The file infos above may be limited when queried
+    // (see CmdQueryProjection), the counts are not.
+    int fileWriteCount {0};
+    int fileReadCount {0};
+    DirFileCounts fileCountsPerDir;
+
     void write(QJsonObject &json, bool withMilliseconds=false,
                const CmdJsonWriteCfg& writeCfg=CmdJsonWriteCfg(true)) const;
 
@@ -15,7 +15,8 @@ const QHash<QString, E_CompareOperator>& termEnumHash(){
         {"-eq", E_CompareOperator::EQ},
         {"-ne", E_CompareOperator::NE},
         {"-like", E_CompareOperator::LIKE},
-        {"-between", E_CompareOperator::BETWEEN}
+        {"-between", E_CompareOperator::BETWEEN},
+        {"-subtree", E_CompareOperator::SUBTREE}
     };
     return termEnumHash;
 }
@@ -42,6 +43,8 @@ bool CompareOperator::fromTerminal(const QString &val){
     return true;
 }
 
+/// @throws QExcProgramming for SUBTREE, which is no sql operator but a range
+/// (see SqlQuery::mkComparisonSql).
 QString CompareOperator::asSql() const
 {
     QString sqlOperator;
@@ -54,6 +57,8 @@ QString CompareOperator::asSql() const
     case E_CompareOperator::NE: sqlOperator = "!="; break;
     case E_CompareOperator::LIKE: sqlOperator = " LIKE "; break;
     case E_CompareOperator::BETWEEN: sqlOperator = " BETWEEN "; break;
+    case E_CompareOperator::SUBTREE:
+        throw QExcProgramming("SUBTREE has no sql operator, it is expanded to a range");
     }
     return sqlOperator;
 }
@@ -70,6 +75,7 @@ QString CompareOperator::asTerminal() const
     case E_CompareOperator::NE: sqlOperator = "-ne"; break;
     case E_CompareOperator::LIKE: sqlOperator = "-like"; break;
     case E_CompareOperator::BETWEEN: sqlOperator = "-between"; break;
+    case E_CompareOperator::SUBTREE: sqlOperator = "-subtree"; break;
     }
     return sqlOperator;
 }
@@ -19,8 +19,12 @@
 #include "app.h"
 #include "util.h"
 #include "staticinitializer.h"
+#include "storedfiles.h"
+#include "qfilethrow.h"
+#include "cleanupresource.h"
 
 static QSqlDatabase* g_db = nullptr;
+static bool g_hasFullTextIndex = false;
 
 static QVersionNumber queryVersion(QSqlQueryThrow& query){
     query.exec("select ver from version");
@@ -69,12 +73,115 @@ static void handleDifferentVersions(const QVersionNumber& dbVersion,
         sqlite_database_scheme_updates::v2_2(query);
     }
 
+    if(dbVersion < QVersionNumber{2, 4}){
+        logDebug << "updating db to 2.4...";
+        sqlite_database_scheme_updates::v2_4(query);
+    }
+
     query.prepare("replace into version (id, ver) values (1, ?)");
     query.addBindValue(app::version().toString());
     query.exec();
 
 }
 
+/// Stored read files (scripts) are kept as blobs in their own database
+/// file, attached as 'blobs'. So they neither cost an inode each nor
+/// bloat the main database, and can be compacted on their own
+/// (see StoredFiles).
+static void attachReadFileStore(QSqlQueryThrow& query){
+    const QString path = db_connection::getDatabaseDir() + "/readFiles.db";
+    const bool pathExisted = QFileInfo::exists(path);
+    query.prepare("ATTACH DATABASE ? AS blobs");
+    query.addBindValue(path);
+    query.exec();
+    if(! pathExisted){
+        query.exec("PRAGMA blobs.auto_vacuum=INCREMENTAL");
+    }
+    query.exec(
+        "CREATE TABLE IF NOT EXISTS blobs.`blob` ("
+          "`id` INTEGER,"
+          "`hash` TEXT NOT NULL UNIQUE,"
+          "`compressed` INTEGER NOT NULL,"
+          "`data` BLOB NOT NULL,"
+          "PRIMARY KEY(`id`)"
+        ")"
+    );
+    // read the blobs through a memory mapping rather than read-calls
+    query.exec("PRAGMA blobs.mmap_size=268435456");
+}
+
+/// Read files stored by versions before 2.4 reside in the read files dir,
+/// named by their readFile id. Move them into the blob store, so they are
+/// deduplicated and compressed as well. Each chunk is a transaction and a
+/// file is deleted only after the transaction which references its blob is
+/// committed, so an interrupted migration continues on the next open.
+/// Unreadable files are marked as not stored (so they are warned about only
+/// once) and deleted as well. Finally the then empty dir is removed, so
+/// later opens skip the migration.
+static void migrateLegacyReadFiles(QSqlQueryThrow& query){
+    const QDir dir(StoredFiles::getReadFilesDir());
+    if(! dir.exists()){
+        return;
+    }
+    auto removeDir = finally([&dir] {
+        if(QDir().rmdir(dir.path())){
+            logDebug << "removed the legacy read files dir" << dir.path();
+        }
+    });
+    const QStringList fnames = dir.entryList(QDir::Files);
+    if(fnames.isEmpty()){
+        return;
+    }
+    logInfo << qtr("Moving %1 stored read files into the database").arg(fnames.size());
+    StoredFiles storedFiles;
+    const int CHUNK_SIZE = 1000;
+    for(int i=0; i < fnames.size(); i += CHUNK_SIZE){
+        QStringList migrated;
+        query.transaction();
+        for(const QString& fname : fnames.mid(i, CHUNK_SIZE)){
+            bool isId;
+            const qint64 id = fname.toLongLong(&isId);
+            if(! isId){
+                continue;
+            }
+            query.prepare("select 1 from readFile where id=? and isStoredToDisk=1 "
+                          "and blobHash is null");
+            query.addBindValue(id);
+            query.exec();
+            if(! query.next()){
+                // an orphan, e.g. after a crash while deleting
+                migrated.push_back(fname);
+                continue;
+            }
+            QByteArray data;
+            try {
+                QFileThrow f(dir.absoluteFilePath(fname));
+                f.open(QFile::OpenModeFlag::ReadOnly);
+                data = f.readAll();
+            } catch (const QExcIo& e) {
+                logWarning << qtr("Failed to move the stored read file %1 into the "
+                                  "database, it is discarded: %2").arg(fname, e.descrip());
+                query.prepare("update readFile set isStoredToDisk=0 where id=?");
+                query.addBindValue(id);
+                query.exec();
+                migrated.push_back(fname);
+                continue;
+            }
+            const QString blobHash = StoredFiles::mkBlobHash(data);
+            storedFiles.addBlob(blobHash, data);
+            query.prepare("update readFile set blobHash=? where id=?");
+            query.addBindValue(blobHash);
+            query.addBindValue(id);
+            query.exec();
+            migrated.push_back(fname);
+        }
+        query.commit();
+        for(const QString& fname : migrated){
+            storedFiles.deleteReadFile(fname);
+        }
+    }
+}
+
 /// @throws QExcDatabase
 static void openAndPrepareSqliteDb()
 {
@@ -88,13 +195,20 @@ static void openAndPrepareSqliteDb()
     }
 
     QSqlQueryThrow query(*g_db);
-    // Allow for delete queries with cascades
 
     // quoting sqlite.org/foreignkeys.html
     // "It is not possible to enable or disable foreign key constraints in the
     //  middle of a multi-statement transaction (when SQLite is not in autocommit mode)"
-    // So, do it before...
-    query.exec("PRAGMA foreign_keys=ON");
+    // Scheme updates may re-create tables, which must be done with
+    // foreign keys disabled (see sqlite.org/lang_altertable.html), so
+    // enable them only after the (creation- and) update-transaction.
+    query.exec("PRAGMA foreign_keys=OFF");
+
+    if(! pathExisted){
+        // must be set before any table is created. Allows to give space
+        // back to the filesystem after deleting commands.
+        query.exec("PRAGMA auto_vacuum=INCREMENTAL");
+    }
 
     query.transaction();
 
@@ -120,7 +234,14 @@ static void openAndPrepareSqliteDb()
     if(dbVersion != app::version()){
         handleDifferentVersions(dbVersion, query);
     }
+    g_hasFullTextIndex = sqlite_database_scheme_updates::setupFullTextIndex(query);
+    query.commit();
 
+    // Allow for delete queries with cascades
+    query.exec("PRAGMA foreign_keys=ON");
+
+    attachReadFileStore(query);
+    migrateLegacyReadFiles(query);
 }
 
 
@@ -151,6 +272,33 @@ QueryPtr db_connection::mkQuery()
     return std::make_shared<QSqlQueryThrow>(*g_db);
 }
 
+/// @return the version of the sqlite library used by the database driver
+const QVersionNumber &db_connection::sqliteVersion()
+{
+    static const QVersionNumber version = [](){
+        auto query = mkQuery();
+        query->exec("select sqlite_version()");
+        query->next(true);
+        return QVersionNumber::fromString(query->value(0).toString());
+    }();
+    return version;
+}
+
+/// window functions (e.g. row_number() over ...) require sqlite 3.25
+bool db_connection::supportsWindowFunctions()
+{
+    return sqliteVersion() >= QVersionNumber{3, 25};
+}
+
+/// @return true, if the trigram-tables cmdText_fts and directory_fts exist
+/// and work with this sqlite library (see
+/// sqlite_database_scheme_updates::setupFullTextIndex).
+bool db_connection::hasFullTextIndex()
+{
+    setupIfNeeded();
+    return g_hasFullTextIndex;
+}
+
 /// merely for test purposes
 void db_connection::close()
 {
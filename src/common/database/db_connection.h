@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <QVersionNumber>
 
 #include "qsqlquerythrow.h"
 
@@ -14,6 +15,10 @@ QString mkDbPath();
 void setupIfNeeded();
 QueryPtr mkQuery();
 
+const QVersionNumber& sqliteVersion();
+bool supportsWindowFunctions();
+bool hasFullTextIndex();
+
 void close();
 }
 
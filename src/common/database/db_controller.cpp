@@ -3,11 +3,16 @@
 #include <QSql>
 #include <QSqlDriver>
 #include <QDateTime>
+#include <QSet>
+#include <QRegularExpression>
 #include <cassert>
+#include <algorithm>
 
 #include "db_controller.h"
 #include "db_connection.h"
 #include "db_conversions.h"
+#include "db_dictionary.h"
+#include "db_partitions.h"
 #include "db_globals.h"
 #include "qexcdatabase.h"
 #include "qsqlquerythrow.h"
@@ -22,54 +27,101 @@ using namespace db_conversions;
 
 namespace  {
 
+typedef QHash<ProcessKey, QVariant> ProcessIds;
+
+/// Insert the processes referenced by the file events. The same process
+/// may already exist from a previous flush of the command's events.
+/// @return the ids of the inserted processes by pid and start time
+ProcessIds
+insertProcesses(const QueryPtr& query, const QString& schema, const CommandInfo &cmd,
+                const ProcessInfos& processes,
+                const FileWriteEventHash &writeEvents, const FileReadEventHash &readEvents)
+{
+    QSet<ProcessKey> keys;
+    for(const auto& e : writeEvents){
+        keys.insert(ProcessKey(e.pid, e.pidStartTime));
+    }
+    for(const auto& e : readEvents){
+        keys.insert(ProcessKey(e.pid, e.pidStartTime));
+    }
+    ProcessIds processIds;
+    for(const ProcessKey& key : keys){
+        const auto it = processes.find(key);
+        if(it == processes.end()){
+            continue;
+        }
+        processIds[key] = query->insertIfNotExist(schema + ".process", {
+                                {"cmdId", cmd.idInDb},
+                                {"pid", it->pid},
+                                {"parentPid", it->parentPid},
+                                {"exe", QString::fromStdString(it->exe)},
+                                {"argv", fromArgv(it->argv)}
+                            });
+    }
+    return processIds;
+}
+
 void
-insertFileWriteEvents(const QueryPtr& query, const CommandInfo &cmd,
-                const FileWriteEventHash &writeEvents )
+insertFileWriteEvents(const QueryPtr& query, const QString& schema, DbDictionary& dict,
+                      const CommandInfo &cmd,
+                      const FileWriteEventHash &writeEvents, const ProcessIds& processIds)
 {
-    query->prepare("insert into writtenFile (cmdId,path,name,mtime,size,hash) "
-                  "values (?,?,?,?,?,?)");
+    query->prepare("insert into " + schema + ".writtenFile "
+                   "(cmdId,dirId,name,mtime,size,hash,processId) values (?,?,?,?,?,?,?)");
     for(const auto& fileEvent : writeEvents) {
         query->addBindValue(cmd.idInDb);
 
         auto pathFnamePair =  splitAbsPath(QString::fromStdString(fileEvent.fullPath));
-        query->addBindValue(pathFnamePair.first);
+        query->addBindValue(dict.dirId(pathFnamePair.first));
         query->addBindValue(pathFnamePair.second);
         query->addBindValue(fromMtime(fileEvent.mtime));
 
         query->addBindValue(static_cast<qint64>(fileEvent.size));
         query->addBindValue(fromHashValue(fileEvent.hash));
+        query->addBindValue(processIds.value(ProcessKey(fileEvent.pid, fileEvent.pidStartTime)));
         query->exec();
     }
 }
 
 
 void
-insertFileReadEvents(const QueryPtr& query, const CommandInfo &cmd,
+insertFileReadEvents(const QueryPtr& query, const QString& schema, DbDictionary& dict,
+                     const CommandInfo &cmd,
                      const QVariant& envId, const QVariant& hashMetaId,
-                     const FileReadEventHash &readEvents )
+                     const FileReadEventHash &readEvents, const ScriptStaging& scriptStaging,
+                     const ProcessIds& processIds)
 {
     StoredFiles storedFiles;
 
     for(const auto& event : readEvents) {
         const auto pathFnamePair =  splitAbsPath(QString::fromStdString(event.fullPath));
+        const bool isStored = event.stagedOffset != -1;
+        // only one script at a time is held in memory
+        const QByteArray bytes = (isStored) ? scriptStaging.read(event.stagedOffset,
+                                                                 event.stagedSize)
+                                            : QByteArray();
+        const QString blobHash = (isStored) ? StoredFiles::mkBlobHash(bytes) : QString();
         bool existed;
         const auto readFileId = query->insertIfNotExist("readFile", {
                                     {"envId", envId },
                                     {"name", pathFnamePair.second},
-                                    {"path", pathFnamePair.first},
+                                    {"dirId", dict.dirId(pathFnamePair.first)},
                                     {"mtime",fromMtime(event.mtime)},
                                     {"size", qint64(event.size)},
                                     {"mode", event.mode},
                                     {"hash", fromHashValue(event.hash)},
                                     {"hashmetaId", hashMetaId},
-                                    {"isStoredToDisk", ! event.bytes.isNull()}
+                                    {"isStoredToDisk", isStored},
+                                    {"blobHash", blobHash}
                                 }, &existed);
-        if(! existed && ! event.bytes.isNull()){
-            storedFiles.addReadFile(readFileId.toString(), event.bytes);
+        if(! existed && isStored){
+            storedFiles.addBlob(blobHash, bytes);
         }
-        query->prepare("insert into readFileCmd (cmdId, readFileId) values (?,?)");
+        query->prepare("insert into " + schema + ".readFileCmd (cmdId, readFileId, processId) "
+                       "values (?,?,?)");
         query->addBindValue(cmd.idInDb);
         query->addBindValue(readFileId);
+        query->addBindValue(processIds.value(ProcessKey(event.pid, event.pidStartTime)));
         query->exec();
     }
 }
@@ -78,24 +130,54 @@ insertFileReadEvents(const QueryPtr& query, const CommandInfo &cmd,
 
 
 
+const int DELETE_CHUNK_SIZE = 1000;
+
+/// @return sql for the ids in temp.delCandidate of the given table
+QString deleteCandidates(const char* table){
+    return QString("(select id from temp.delCandidate where tbl='") + table + "')";
+}
+
+/// Remember the parents of the given commands, which may become
+/// orphans, once the commands are deleted. This way only those
+/// have to be checked instead of whole tables.
+/// @param cmdIdList: comma separated ids or a subquery selecting them
+void collectParentsOfCmds(const QueryPtr& query, const QString& cmdIdList){
+    const QString insert = "insert or ignore into temp.delCandidate (tbl, id) ";
+    const QString whereCmd = " where cmd.id in (" + cmdIdList + ")";
+    query->exec(insert + "select 'hashmeta', hashmetaId from cmd" + whereCmd +
+                " and hashmetaId is not null");
+    query->exec(insert + "select 'session', sessionId from cmd" + whereCmd +
+                " and sessionId is not null");
+    query->exec(insert + "select 'env', envId from cmd" + whereCmd);
+    query->exec(insert + "select 'cmdText', txtId from cmd" + whereCmd);
+    query->exec(insert + "select 'directory', workingDirId from cmd" + whereCmd);
+    query->exec(insert + "select 'directory', dirId from writtenFile "
+                "where writtenFile.cmdId in (" + cmdIdList + ")");
+    query->exec(insert + "select 'readFile', readFileId from readFileCmd "
+                "where readFileCmd.cmdId in (" + cmdIdList + ")");
+}
+
 /// sql allows for cascade deleting orphans (children), here we kill
-/// parents, where all children died
+/// parents, where all children died. Only the parents collected
+/// by collectParentsOfCmds are considered.
 void
 deleteChildlessParents(const QueryPtr& query){
-    logDebug << "delete from hashmeta...";
-    query->exec("delete from hashmeta where not exists "
-               "(select 1 from cmd where cmd.hashmetaId=hashmeta.id)");
-    logDebug << "delete from session...";
-    query->exec("delete from session where not exists "
-               "(select 1 from cmd where cmd.sessionId=session.id)");
+    const QString insert = "insert or ignore into temp.delCandidate (tbl, id) ";
+
+    const QString orphanReadFiles = "readFile.id in " + deleteCandidates("readFile") +
+            " and not exists (select 1 from readFileCmd where readFileCmd.readFileId=readFile.id)";
+    // their environment and directory may become orphans as well
+    query->exec(insert + "select 'env', envId from readFile where " + orphanReadFiles);
+    query->exec(insert + "select 'directory', dirId from readFile where " + orphanReadFiles);
 
-    // delete stored read files (script files) in filesystem AND database
+    query->exec(insert + "select 'blob', blobHash from readFile where "
+                "blobHash is not null and " + orphanReadFiles);
+
+    // delete read files (script files) stored in the filesystem by
+    // older versions
     query->setForwardOnly(true);
-    query->prepare("select readFile.id from readFile where "
-        "readFile.isStoredToDisk=? and "
-        "not exists (select 1 from readFileCmd where readFileCmd.readFileId=readFile.id) ");
-    query->bindValue(0, true);
-    query->exec();
+    query->exec("select readFile.id from readFile where readFile.isStoredToDisk=1 and "
+                "readFile.blobHash is null and " + orphanReadFiles);
     StoredFiles storedFiles;
     logDebug << "looping though read 'script' files to evtl. delete from filesystem...";
     while(query->next()){
@@ -106,37 +188,296 @@ deleteChildlessParents(const QueryPtr& query){
         }
     }
     logDebug << "delete from readFile...";
-    query->exec("delete from readFile where not exists "
-               "(select 1 from readFileCmd where readFileCmd.readFileId=readFile.id)");
+    query->exec("delete from readFile where " + orphanReadFiles);
+
+    // blobs are shared by all read files with the same content
+    logDebug << "delete from blob...";
+    query->exec("delete from blobs.blob where blob.hash in " + deleteCandidates("blob") +
+                " and not exists (select 1 from readFile where readFile.blobHash=blob.hash)");
+
+    logDebug << "delete from hashmeta...";
+    query->exec("delete from hashmeta where hashmeta.id in " + deleteCandidates("hashmeta") +
+                " and not exists (select 1 from cmd where cmd.hashmetaId=hashmeta.id)");
+    logDebug << "delete from session...";
+    query->exec("delete from session where session.id in " + deleteCandidates("session") +
+                " and not exists (select 1 from cmd where cmd.sessionId=session.id)");
 
-    // Do it last -> foreign key in readFile
+    // Do it after readFile -> foreign key in readFile
     logDebug << "delete from env...";
-    query->exec("delete from env where not exists (select 1 from cmd where "
-               "cmd.envId=env.id)");
+    query->exec("delete from env where env.id in " + deleteCandidates("env") +
+                " and not exists (select 1 from cmd where cmd.envId=env.id)"
+                " and not exists (select 1 from readFile where readFile.envId=env.id)");
+
+    logDebug << "delete from cmdText...";
+    query->exec("delete from cmdText where cmdText.id in " + deleteCandidates("cmdText") +
+                " and not exists (select 1 from cmd where cmd.txtId=cmdText.id)");
+
+    // directories form a tree, so deleting the leaves may turn
+    // their parents into leaves.
+    logDebug << "delete from directory...";
+    const QString orphanDirs = "directory.id in " + deleteCandidates("directory") + " and "
+            "not exists (select 1 from directory child where "
+            "child.parentId=directory.id) and "
+            "not exists (select 1 from cmd where cmd.workingDirId=directory.id) and "
+            "not exists (select 1 from writtenFile where "
+            "writtenFile.dirId=directory.id) and "
+            "not exists (select 1 from readFile where readFile.dirId=directory.id)";
+    do {
+        query->exec(insert + "select 'directory', parentId from directory where " +
+                    orphanDirs + " and parentId is not null");
+        query->exec("delete from directory where " + orphanDirs);
+    } while(query->numRowsAffected() > 0);
+}
+
+/// Partitions, where all commands match the query, are deleted by
+/// removing their file instead of row by row. Only possible for
+/// queries solely on the start time, e.g. --older-than.
+/// @return the count of deleted commands
+int deleteWholePartitions(const QueryPtr& query, const SqlQuery& sqlQuery){
+    const QString& startTimeCol = db_controller::QueryColumns::instance().cmd_starttime;
+    bool isExact;
+    const auto range = sqlQuery.numericRange(startTimeCol, &isExact);
+    const bool onlyStartTime = std::all_of(
+                sqlQuery.terms().begin(), sqlQuery.terms().end(),
+                [&startTimeCol](const SqlQuery::Term& t){ return t.column == startTimeCol; });
+    if(! isExact || ! onlyStartTime){
+        return 0;
+    }
+    int countOfDeleted = 0;
+    for(const auto& p : db_partitions::attached()){
+        if(p.beginMs < range.first || p.endMs - 1 > range.second){
+            continue;
+        }
+        query->exec("select count(*) from " + p.schema + ".cmd");
+        query->next(true);
+        countOfDeleted += query->value(0).toInt();
+        query->exec("delete from temp.delCandidate");
+        collectParentsOfCmds(query, "select id from " + p.schema + ".cmd");
+        // Clean up the dictionaries as if the partition was gone already and
+        // only delete its file afterwards, so a failed cleanup leaves the
+        // partition intact.
+        db_partitions::detach(p);
+        query->transaction();
+        deleteChildlessParents(query);
+        query->commit();
+        db_partitions::removeFile(p);
+    }
+    return countOfDeleted;
+}
+
+/// If the database is in incremental auto vacuum mode, give the
+/// free pages back to the filesystem. Must not be called within
+/// a transaction.
+void incrementalVacuumIfEnabled(const QueryPtr& query, const QString& schema){
+    query->exec("PRAGMA " + schema + ".auto_vacuum");
+    if(! query->next() || query->value(0).toInt() != 2){
+        return;
+    }
+    logDebug << "incremental vacuum of" << schema << "...";
+    query->exec("PRAGMA " + schema + ".incremental_vacuum");
+    // sqlite frees the pages step by step
+    while(query->next()){}
+}
+
+
+/// Trigram fts5 MATCH-expression for a LIKE-pattern: its literal fragments
+/// between the wildcards (% and _) as phrases, which must all be contained.
+/// Fragments shorter than three characters cannot be looked up in a trigram
+/// index and are skipped, so the expression matches a superset of the pattern.
+/// @return empty, if no fragment is long enough.
+QString likeToTrigramMatch(const QString& pattern){
+    static const QRegularExpression wildcards("[%_]");
+    QStringList phrases;
+    for(QString fragment : pattern.split(wildcards, QString::SkipEmptyParts)){
+        if(fragment.size() >= 3){
+            phrases.push_back('"' + fragment.replace('"', "\"\"") + '"');
+        }
+    }
+    return phrases.join(" AND ");
+}
+
+/// Conditions on interned strings (command text, directory paths) are
+/// evaluated once against their dictionary table, where the strings are
+/// indexed (e.g. for the range of a SUBTREE comparison), so only the
+/// ids are compared per command or file.
+/// LIKE-comparisons are prefiltered by the trigram index, if available
+/// (see db_connection::hasFullTextIndex).
+/// @param values: the values to bind for sql
+/// @return false, if the term's column is not interned.
+bool mkDictionaryTermSql(const SqlQuery::Term& term, bool useFullTextIndex,
+                         QString& sql, QVariantList& values){
+    struct DictionaryCol {
+        QString idCol;
+        QString table;
+        QString col;
+    };
+    const auto & cols = db_controller::QueryColumns::instance();
+    static const QHash<QString, DictionaryCol> dictionaryCols = {
+        {cols.cmd_txt, {"cmd.txtId", "cmdText", "txt"}},
+        {cols.cmd_workingDir, {"cmd.workingDirId", "directory", "path"}},
+        {cols.wFile_path, {"writtenFile.dirId", "directory", "path"}},
+        {cols.rFile_path, {"readFile.dirId", "directory", "path"}},
+    };
+    auto it = dictionaryCols.find(term.column);
+    if(it == dictionaryCols.end() || term.comparisons.isEmpty()){
+        return false;
+    }
+    const QString dictCol = it->table + "." + it->col;
+    QStringList conds;
+    for(const auto& cmp : term.comparisons){
+        const QString match = (useFullTextIndex &&
+                               cmp.op.asEnum() == E_CompareOperator::LIKE &&
+                               ! cmp.value.isNull()) ? likeToTrigramMatch(cmp.value.toString())
+                                                     : QString();
+        if(match.isEmpty()){
+            conds.push_back(SqlQuery::mkComparisonSql(dictCol, cmp, values));
+            continue;
+        }
+        // the LIKE still applies, as the match is only a superset
+        values.push_back(match);
+        conds.push_back("( " + it->table + ".id in (select rowid from " + it->table + "_fts "
+                        "where " + it->table + "_fts MATCH ?) and " +
+                        SqlQuery::mkComparisonSql(dictCol, cmp, values) + ")");
+    }
+    sql = " ( " + it->idCol + " in (select " + it->table + ".id from " + it->table +
+          " where " + conds.join(term.junction) + ") ) ";
+    return true;
+}
+
+/// Conditions on written or read files are moved into an EXISTS-subquery
+/// per file table (semi-join), so each command is found at most once without
+/// joining all matching file rows and grouping them by cmd.id afterwards.
+/// All conditions on the same file table refer to the same file.
+/// @param values: the values to bind, in placeholder order
+QString mkCmdWhereClause(const SqlQuery& sqlQ, QVariantList& values){
+    if(sqlQ.terms().isEmpty()){
+        // set via setQuery, so no file tables
+        values = sqlQ.values();
+        return sqlQ.query();
+    }
+    QStringList cmdConds;
+    QStringList wConds;
+    QStringList rConds;
+    QVariantList wValues;
+    QVariantList rValues;
+    bool wDirUsed = false;
+    bool rDirUsed = false;
+    bool wProcessUsed = false;
+    bool rProcessUsed = false;
+    const bool useFullTextIndex = db_connection::hasFullTextIndex();
+    for(const auto& term : sqlQ.terms()){
+        QString sql;
+        QVariantList termValues;
+        const bool isDictTerm = mkDictionaryTermSql(term, useFullTextIndex, sql, termValues);
+        if(! isDictTerm){
+            sql = term.sql;
+            termValues = term.values;
+        }
+        if(term.tablename == "writtenFile" || term.tablename == "writtenFileDir" ||
+                term.tablename == "writtenFileProcess"){
+            wConds.push_back(sql);
+            wValues += termValues;
+            wDirUsed |= ! isDictTerm && term.tablename == "writtenFileDir";
+            wProcessUsed |= term.tablename == "writtenFileProcess";
+        } else if(term.tablename == "readFile" || term.tablename == "readFileDir" ||
+                  term.tablename == "readFileProcess"){
+            rConds.push_back(sql);
+            rValues += termValues;
+            rDirUsed |= ! isDictTerm && term.tablename == "readFileDir";
+            rProcessUsed |= term.tablename == "readFileProcess";
+        } else {
+            cmdConds.push_back(sql);
+            values += termValues;
+        }
+    }
+    if(! wConds.isEmpty()){
+        cmdConds.push_back(
+              QString(" exists (select 1 from writtenFile ") +
+              ((wDirUsed) ? "join directory as writtenFileDir on "
+                            "writtenFileDir.id=writtenFile.dirId " : "") +
+              ((wProcessUsed) ? "join process as writtenFileProcess on "
+                                "writtenFileProcess.id=writtenFile.processId " : "") +
+              "where writtenFile.cmdId=cmd.id and " + wConds.join(" and ") + ") ");
+        values += wValues;
+    }
+    if(! rConds.isEmpty()){
+        cmdConds.push_back(
+              QString(" exists (select 1 from readFileCmd "
+                      "join readFile on readFile.id=readFileCmd.readFileId ") +
+              ((rDirUsed) ? "join directory as readFileDir on "
+                            "readFileDir.id=readFile.dirId " : "") +
+              ((rProcessUsed) ? "join process as readFileProcess on "
+                                "readFileProcess.id=readFileCmd.processId " : "") +
+              "where readFileCmd.cmdId=cmd.id and " + rConds.join(" and ") + ") ");
+        values += rValues;
+    }
+    return cmdConds.join(" and ");
+}
+
+QString mkQueryForCmd(const SqlQuery &sqlQ, bool reverseResultIter, QVariantList& values){
+    const QString queryStr =
+            "select cmd.id, cmdText.txt, "
+            "cmd.returnVal, cmd.startTime, cmd.endTime, cmdWorkingDir.path,"
+            "session.id, session.comment,"
+            "hashmeta.chunkSize, hashmeta.maxCountOfReads,"
+            "env.username, env.hostname "
+            "from cmd "
+            "join cmdText on cmdText.id=cmd.txtId "
+            "join directory as cmdWorkingDir on cmdWorkingDir.id=cmd.workingDirId "
+            "join env on cmd.envId=env.id "
+            "left join hashmeta on hashmeta.id=cmd.hashmetaId " // left joins last, if possible!
+            "left join `session` on cmd.sessionId=session.id "
+            "where ";
+
+    // do not change this -> order matters in html-plot...
+    // Both are served by idx_cmd_startTime (its entries end with the rowid).
+    const QString orderBy = "order by cmd.startTime " + sqlQ.ascendingStr() +
+                            ", cmd.id " + sqlQ.ascendingStr() +
+                            sqlQ.mkLimitString();
+
+    QString fullQuery = queryStr + mkCmdWhereClause(sqlQ, values) + " " + orderBy;
+    if(reverseResultIter){
+        // Let sqlite reverse the (limited) result, so the cursor can stay forward-only.
+        // Columns 4 and 1 are cmd.startTime and cmd.id.
+        const QString reverseOrder = (sqlQ.ascending()) ? "desc " : "asc ";
+        fullQuery = "select * from (" + fullQuery + ") "
+                    "order by 4 " + reverseOrder + ", 1 " + reverseOrder;
+    }
+    return fullQuery;
 }
 
 
+const char* READ_INFO_COLUMNS = "readFile.id,readFileDir.path,readFile.name,readFile.mtime,"
+                                "readFile.size,readFile.mode,readFile.hash,readFile.isStoredToDisk,"
+                                "readFile.blobHash ";
+
+/// Read the columns READ_INFO_COLUMNS, starting at column i
+FileReadInfo readInfoFromQuery(const QueryPtr& query, int i=0){
+    FileReadInfo fInfo;
+    fInfo.idInDb = qVariantTo_throw<qint64>(query->value(i++));
+    fInfo.path = query->value(i++).toString();
+    fInfo.name = query->value(i++).toString();
+    fInfo.mtime = toDateTime(query->value(i++));
+    fInfo.size =  qVariantTo_throw<qint64>(query->value(i++));
+    fInfo.mode =  qVariantTo_throw<mode_t>(query->value(i++));
+    fInfo.hash = db_conversions::toHashValue(query->value(i++));
+    fInfo.isStoredToDisk = query->value(i++).toBool();
+    fInfo.blobHash = query->value(i++).toString();
+    return fInfo;
+}
+
 FileReadInfos
 queryFileReadInfos(const SqlQuery& sqlQ, const QueryPtr& query_=nullptr, const QString& optionalJoins={}){
     const QueryPtr query = (query_ != nullptr) ? query_ : db_connection::mkQuery();
     FileReadInfos readInfos;
-    query->prepare("select readFile.id,path,name,mtime,size,mode,hash,isStoredToDisk from readFile "
+    query->prepare(QString("select ") + READ_INFO_COLUMNS +
+                   "from readFile "
+                   "join directory as readFileDir on readFileDir.id=readFile.dirId "
                    + optionalJoins + " where " + sqlQ.query());
     query->addBindValues(sqlQ.values());
     query->exec();
     while(query->next()){
-        int i=0;
-        FileReadInfo fInfo;
-        fInfo.idInDb = qVariantTo_throw<qint64>(query->value(i++));
-        fInfo.path = query->value(i++).toString();
-        fInfo.name = query->value(i++).toString();
-        fInfo.mtime = query->value(i++).toDateTime();
-        fInfo.size =  qVariantTo_throw<qint64>(query->value(i++));
-        fInfo.mode =  qVariantTo_throw<mode_t>(query->value(i++));
-        fInfo.hash = db_conversions::toHashValue(query->value(i++));
-        fInfo.isStoredToDisk = query->value(i++).toBool();
-
-        readInfos.push_back(fInfo);
+        readInfos.push_back(readInfoFromQuery(query));
     }
     return readInfos;
 }
@@ -154,6 +495,18 @@ queryFileReadInfos(const SqlQuery& sqlQ, const QueryPtr& query_=nullptr, const Q
 /// @throws QExcDatabase
 qint64 db_controller::addCommand(const CommandInfo &cmd)
 {
+    // Archiving may take a while, so only try it once per process (the
+    // observer daemon archives when storing its first command). A failure
+    // must not cost the command.
+    static bool archivingTried = false;
+    if(! archivingTried){
+        archivingTried = true;
+        try {
+            db_partitions::archiveIfPartitioned();
+        } catch (const std::exception& ex) {
+            logWarning << qtr("Failed to archive completed years: %1").arg(ex.what());
+        }
+    }
     auto query = db_connection::mkQuery();
     query->transaction();
 
@@ -185,20 +538,25 @@ qint64 db_controller::addCommand(const CommandInfo &cmd)
         query->exec();
     }
 
-    query->prepare("insert into cmd (txt,envId,hashmetaId,returnVal,"
-                  "startTime,endTime,workingDirectory,sessionId) "
+    DbDictionary dict;
+    const qint64 txtId = dict.cmdTextId(cmd.text);
+    const qint64 workingDirId = dict.dirId(cmd.workingDirectory);
+
+    // new commands always go to the main database (see db_partitions)
+    query->prepare("insert into main.cmd (txtId,envId,hashmetaId,returnVal,"
+                  "startTime,endTime,workingDirId,sessionId) "
                   "values (?,?,"
                   "(select id from hashmeta where chunkSize=? and maxCountOfReads=?),"
                   "?,?,?,?,?)"
                   );
-    query->addBindValue(cmd.text);
+    query->addBindValue(txtId);
     query->addBindValue(envId);
     query->addBindValue(cmd.hashMeta.chunkSize);
     query->addBindValue(cmd.hashMeta.maxCountOfReads);
     query->addBindValue(cmd.returnVal);
-    query->addBindValue(cmd.startTime);
-    query->addBindValue(cmd.endTime);
-    query->addBindValue(cmd.workingDirectory);
+    query->addBindValue(fromDateTime(cmd.startTime));
+    query->addBindValue(fromDateTime(cmd.endTime));
+    query->addBindValue(workingDirId);
     query->addBindValue(cmd.sessionInfo.uuid);
     query->exec();
 
@@ -212,14 +570,18 @@ qint64 db_controller::addCommand(const CommandInfo &cmd)
 void db_controller::updateCommand(const CommandInfo &cmd)
 {
     assert(cmd.idInDb != db::INVALID_INT_ID);
+    const QString schema = db_partitions::schemaOfCmd(cmd.idInDb, cmd.startTime);
     auto query = db_connection::mkQuery();
+    query->transaction();
 
-    query->prepare("update cmd set txt=?,returnVal=?,startTime=?,endTime=? "
+    DbDictionary dict;
+    const qint64 txtId = dict.cmdTextId(cmd.text);
+    query->prepare("update " + schema + ".cmd set txtId=?,returnVal=?,startTime=?,endTime=? "
                    "where `id`=?");
-    query->addBindValue(cmd.text);
+    query->addBindValue(txtId);
     query->addBindValue(cmd.returnVal);
-    query->addBindValue(cmd.startTime);
-    query->addBindValue(cmd.endTime);
+    query->addBindValue(fromDateTime(cmd.startTime));
+    query->addBindValue(fromDateTime(cmd.endTime));
     query->addBindValue(cmd.idInDb);
 
     query->exec();
@@ -228,98 +590,145 @@ void db_controller::updateCommand(const CommandInfo &cmd)
 
 
 /// Add file events belonging to param cmd which must belong to a valid
-/// database entry (idInDb must valid)
+/// database entry (idInDb must valid). The collected read files of readEvents
+/// are read from scriptStaging. The events are attributed to the
+/// processes with their pid and start time, if found in processes.
 void db_controller::addFileEvents(const CommandInfo &cmd, const FileWriteEventHash &writeEvents,
-                                  const FileReadEventHash &readEvents)
+                                  const FileReadEventHash &readEvents,
+                                  const ScriptStaging& scriptStaging,
+                                  const ProcessInfos& processes)
 {
     assert(cmd.idInDb != db::INVALID_INT_ID);
+    const QString schema = db_partitions::schemaOfCmd(cmd.idInDb, cmd.startTime);
     auto query = db_connection::mkQuery();
     query->transaction();
 
-    query->prepare("select envId,hashmetaId from cmd where `id`=?");
+    query->prepare("select envId,hashmetaId from " + schema + ".cmd where `id`=?");
     query->addBindValue(cmd.idInDb);
     query->exec();
     query->next(true);
     const QVariant envId = query->value(0);
     const QVariant hashMetaId = query->value(1);
 
-    insertFileWriteEvents(query, cmd, writeEvents);
-    insertFileReadEvents(query, cmd, envId, hashMetaId, readEvents);
+    const ProcessIds processIds = insertProcesses(query, schema, cmd, processes,
+                                                  writeEvents, readEvents);
+    DbDictionary dict;
+    insertFileWriteEvents(query, schema, dict, cmd, writeEvents, processIds);
+    insertFileReadEvents(query, schema, dict, cmd, envId, hashMetaId, readEvents,
+                         scriptStaging, processIds);
 }
 
 
 
 /// Deletes the command and corresponding file events (read and write).
-/// @param sqlQuery: may only refer to columns of the 'cmd'-table.
+/// The commands are deleted in chunks, each within its own transaction,
+/// so other processes (e.g. shournal-run storing a command) are not
+/// locked out for the whole time.
+/// If partitioned, all partitions are considered (see db_partitions).
+/// @param sqlQuery: may only refer to columns of the 'cmd'-table including
+/// its command text and working directory (see QueryColumns).
+/// @param progress: if set, called after each chunk with the number of
+///                  processed and total matching commands.
 /// @returns numRowsAffected
-int db_controller::deleteCommand(const SqlQuery &sqlQuery)
+int db_controller::deleteCommand(const SqlQuery &sqlQuery, const DeleteProgress& progress)
 {
+    db_partitions::attachAll();
     auto query = db_connection::mkQuery();
-    query->transaction();
+    query->setForwardOnly(true);
+    query->exec("create temp table if not exists delCandidate ("
+                "tbl TEXT NOT NULL, id NOT NULL, PRIMARY KEY(tbl, id))");
+    int numRowsAffected = deleteWholePartitions(query, sqlQuery);
 
     logDebug << "deleting cmd" << sqlQuery.query();
-    query->prepare("delete from cmd where " + sqlQuery.query());
+    query->prepare("select cmd.id from cmd "
+                   "join cmdText on cmdText.id=cmd.txtId "
+                   "join directory as cmdWorkingDir on cmdWorkingDir.id=cmd.workingDirId "
+                   "where " + sqlQuery.query());
     query->addBindValues(sqlQuery.values());
-
-    InterruptProtect ip;
-
     query->exec();
-    int numRowsAffected = query->numRowsAffected();
-    // the respective triggers have also caused the deletion of orphans in
-    // writtenFile, readFileCmd, etc., however, we still need to handle childless parents:
-    deleteChildlessParents(query);
+    QVector<qint64> cmdIds;
+    while(query->next()){
+        cmdIds.push_back(qVariantTo_throw<qint64>(query->value(0)));
+    }
+
+    const QStringList cmdSchemas = db_partitions::cmdSchemas();
+    for(int i=0; i < cmdIds.size(); i += DELETE_CHUNK_SIZE){
+        const QString cmdIdList = idsToSqlList(cmdIds.mid(i, DELETE_CHUNK_SIZE));
+        {
+            InterruptProtect ip;
+            query->transaction();
+            query->exec("delete from temp.delCandidate");
+            collectParentsOfCmds(query, cmdIdList);
+            // the respective triggers cause the deletion of orphans in
+            // writtenFile, readFileCmd, etc., however, we still need to
+            // handle childless parents:
+            for(const QString& schema : cmdSchemas){
+                query->exec("delete from " + schema + ".cmd where id in (" + cmdIdList + ")");
+                numRowsAffected += query->numRowsAffected();
+            }
+            deleteChildlessParents(query);
+            query->commit();
+        }
+        if(progress){
+            progress(std::min(i + DELETE_CHUNK_SIZE, cmdIds.size()), cmdIds.size());
+        }
+    }
+    if(numRowsAffected > 0){
+        incrementalVacuumIfEnabled(query, "main");
+        // compact the store of read files
+        incrementalVacuumIfEnabled(query, "blobs");
+    }
     return numRowsAffected;
 }
 
+/// Rebuild the database file and the store of read files and switch
+/// to incremental auto vacuum mode, so deleteCommand reclaims disk space
+/// afterwards. Takes a while for large databases.
+void db_controller::vacuum()
+{
+    auto query = db_connection::mkQuery();
+    for(const QString schema : {"main", "blobs"}){
+        query->exec("PRAGMA " + schema + ".auto_vacuum=INCREMENTAL");
+        query->exec("VACUUM " + schema);
+    }
+}
+
 
 /// @param reverseResultIter: if true, the returned Iterator will traverse the resultset in
-/// reverse order on continous 'next'-calls.
+/// reverse order on continous 'next'-calls. Useful to get e.g. the last n commands
+/// in ascending order.
 std::unique_ptr<CommandQueryIterator>
 db_controller::queryForCmd(const SqlQuery &sqlQ, bool reverseResultIter){
+    db_partitions::attachForQuery(sqlQ);
     auto pQuery = db_connection::mkQuery();
-    std::unique_ptr<CommandQueryIterator> cmdIter(
-                new CommandQueryIterator(pQuery, reverseResultIter));
-
-    const QString queryStr =
-            "select cmd.id, cmd.txt, "
-            "cmd.returnVal, cmd.startTime, cmd.endTime, cmd.workingDirectory,"
-            "session.id, session.comment,"
-            "hashmeta.chunkSize, hashmeta.maxCountOfReads,"
-            "env.username, env.hostname "
-            "from cmd "             +
-            QString((sqlQ.containsTablename("writtenFile")) ?
-                        "join writtenFile on cmd.id=writtenFile.cmdId " : "") +
-            QString((sqlQ.containsTablename("readFile")) ?
-                        "join readFileCmd on cmd.id=readFileCmd.cmdId "
-                        "join readFile on readFileCmd.readFileId=readFile.id " :
-                        "") +
-            "join env on cmd.envId=env.id "
-            "left join hashmeta on hashmeta.id=cmd.hashmetaId " // left joins last, if possible!
-            "left join `session` on cmd.sessionId=session.id "
-            "where ";
-
-    // do not change this -> order matters in html-plot...
-    const QString orderBy = "order by cmd.startTime " + sqlQ.ascendingStr() +
-                            sqlQ.mkLimitString();
+    // stream the results instead of caching them within QtSql
+    pQuery->setForwardOnly(true);
 
-    // we need the size (at other places) but QSQLITE does not support QSqlQuery::size.
-    // To use a workaround, forward mode must not be enabled.
-    // See also https://stackoverflow.com/a/26500811/7015849
-    // if( ! reverseResultIter){
-    //     pQuery->setForwardOnly(true);
-    // }
-    const QString fullQuery = queryStr + sqlQ.query() + " group by cmd.id " + orderBy;
+    QVariantList values;
+    const QString fullQuery = mkQueryForCmd(sqlQ, reverseResultIter, values);
     pQuery->prepare(fullQuery);
-    pQuery->addBindValues(sqlQ.values());
+    pQuery->addBindValues(values);
     logDebug << "executing" << fullQuery;
     pQuery->exec();
 
-    if(reverseResultIter){
-        // place cursor right after the last record, so a call to "previous" points to last.
-        pQuery->last();
-        pQuery->next();
+    return std::unique_ptr<CommandQueryIterator>(new CommandQueryIterator(pQuery));
+}
+
+/// @return the 'detail'-column of sqlite's query plan of the query
+/// generated by queryForCmd, e.g. to verify that indexes are used.
+QStringList db_controller::explainQueryForCmd(const SqlQuery &sqlQ, bool reverseResultIter)
+{
+    db_partitions::attachForQuery(sqlQ);
+    auto pQuery = db_connection::mkQuery();
+    QVariantList values;
+    pQuery->prepare("explain query plan " + mkQueryForCmd(sqlQ, reverseResultIter, values));
+    pQuery->addBindValues(values);
+    pQuery->exec();
+    QStringList details;
+    while(pQuery->next()){
+        details.push_back(pQuery->value(3).toString());
     }
-    return cmdIter;
+    return details;
 }
 
 /// if no entry can be found, the id of the returned file info is invalid.
@@ -344,6 +753,71 @@ FileReadInfos db_controller::queryReadInfos_byCmdId(qint64 cmdId, const QueryPtr
                               "readFile.id=readFileCmd.readFileId ");
 }
 
+/// Batched version of queryReadInfos_byCmdId.
+/// @param maxCountPerCmd: return at most that many read files per command
+/// @param totalCounts: if not null, the number of read files of each command
+///                     (regardless of maxCountPerCmd) is stored here.
+/// @return the read files of the given commands, keyed by command id. Commands
+/// without read files are not contained.
+QHash<qint64, FileReadInfos>
+db_controller::queryReadInfos_byCmdIds(const QVector<qint64> &cmdIds, const QueryPtr &query_,
+                                       int maxCountPerCmd, QHash<qint64, int> *totalCounts)
+{
+    QHash<qint64, FileReadInfos> readInfosByCmdId;
+    if(cmdIds.isEmpty()){
+        return readInfosByCmdId;
+    }
+    const QueryPtr query = (query_ != nullptr) ? query_ : db_connection::mkQuery();
+    const QString cmdIdList = idsToSqlList(cmdIds);
+    if(maxCountPerCmd == 0){
+        if(totalCounts != nullptr){
+            query->exec("select cmdId,count(*) from readFileCmd "
+                        "where cmdId in (" + cmdIdList + ") group by cmdId");
+            while(query->next()){
+                totalCounts->insert(qVariantTo_throw<qint64>(query->value(0)),
+                                    query->value(1).toInt());
+            }
+        }
+        return readInfosByCmdId;
+    }
+    // Let sqlite limit the files per command, if possible.
+    const bool limitInSql = maxCountPerCmd != SqlQuery::NO_LIMIT &&
+                            db_connection::supportsWindowFunctions();
+    QString queryStr = QString("select readFileCmd.cmdId,") + READ_INFO_COLUMNS;
+    if(limitInSql){
+        queryStr += ",count(*) over (partition by readFileCmd.cmdId),"
+                    "row_number() over (partition by readFileCmd.cmdId "
+                    "order by readFileCmd.id) as rowNum ";
+    }
+    queryStr += "from readFileCmd "
+                "join readFile on readFile.id=readFileCmd.readFileId "
+                "join directory as readFileDir on readFileDir.id=readFile.dirId "
+                "where readFileCmd.cmdId in (" + cmdIdList + ")";
+    if(limitInSql){
+        queryStr = "select * from (" + queryStr + ") where rowNum <= " +
+                   QString::number(maxCountPerCmd);
+    }
+    query->exec(queryStr);
+    while(query->next()){
+        const auto cmdId = qVariantTo_throw<qint64>(query->value(0));
+        readInfosByCmdId[cmdId].push_back(readInfoFromQuery(query, 1));
+        if(limitInSql && totalCounts != nullptr){
+            // the count follows the 9 READ_INFO_COLUMNS
+            totalCounts->insert(cmdId, query->value(10).toInt());
+        }
+    }
+    if(! limitInSql){
+        for(auto it = readInfosByCmdId.begin(); it != readInfosByCmdId.end(); ++it){
+            if(totalCounts != nullptr){
+                totalCounts->insert(it.key(), it.value().size());
+            }
+            if(maxCountPerCmd != SqlQuery::NO_LIMIT && it.value().size() > maxCountPerCmd){
+                it.value().resize(maxCountPerCmd);
+            }
+        }
+    }
+    return readInfosByCmdId;
+}
 
 /// @param restrictingFilesize: only return hashmeta-entries for which at least one file
 /// exists which was recorded using a given hashmeta and whose size is exactly that.
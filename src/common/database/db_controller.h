@@ -2,9 +2,14 @@
 
 #include <QByteArray>
 #include <QVector>
+#include <QHash>
+#include <QStringList>
 #include <memory>
+#include <functional>
 
 #include "fileeventtypes.h"
+#include "scriptstaging.h"
+#include "processcache.h"
 #include "commandinfo.h"
 #include "sqlquery.h"
 #include "db_connection.h"
@@ -20,14 +25,22 @@ qint64 addCommand(const CommandInfo &cmd);
 void updateCommand(const CommandInfo &cmd);
 
 void addFileEvents(const CommandInfo &cmd, const FileWriteEventHash &writeEvents,
-                   const FileReadEventHash &readEvents);
+                   const FileReadEventHash &readEvents, const ScriptStaging& scriptStaging,
+                   const ProcessInfos& processes=ProcessInfos());
 
-int deleteCommand(const SqlQuery &query);
+typedef std::function<void(int processed, int total)> DeleteProgress;
+int deleteCommand(const SqlQuery &query, const DeleteProgress& progress=nullptr);
+void vacuum();
 
 std::unique_ptr<CommandQueryIterator> queryForCmd(const SqlQuery& sqlQ, bool reverseResultIter=false);
+QStringList explainQueryForCmd(const SqlQuery& sqlQ, bool reverseResultIter=false);
 
 FileReadInfo queryReadInfo_byId(qint64 id, const QueryPtr& query_=nullptr);
 FileReadInfos queryReadInfos_byCmdId(qint64 cmdId, const QueryPtr& query_=nullptr);
+QHash<qint64, FileReadInfos> queryReadInfos_byCmdIds(const QVector<qint64>& cmdIds,
+                                                     const QueryPtr& query_=nullptr,
+                                                     int maxCountPerCmd=SqlQuery::NO_LIMIT,
+                                                     QHash<qint64, int>* totalCounts=nullptr);
 
 HashMetas queryHashmetas(qint64 restrictingFilesize);
 
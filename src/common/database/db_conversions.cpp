@@ -1,21 +1,40 @@
 
 #include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include "db_conversions.h"
 #include "util.h"
 
+/// Timestamps are stored as integer milliseconds since epoch, so
+/// indexes stay small and comparisons are numeric.
+QVariant db_conversions::fromDateTime(const QDateTime &dt)
+{
+    if(! dt.isValid()){
+        return QVariant(QVariant::LongLong);
+    }
+    return QVariant(dt.toMSecsSinceEpoch());
+}
+
+QDateTime db_conversions::toDateTime(const QVariant &var)
+{
+    if(var.isNull()){
+        return {};
+    }
+    return QDateTime::fromMSecsSinceEpoch(var.toLongLong());
+}
+
 QVariant db_conversions::fromMtime(time_t mtime)
 {
-    return QVariant(QDateTime::fromTime_t(static_cast<uint>(mtime)));
+    return QVariant(static_cast<qint64>(mtime) * 1000);
 }
 
-/// sqlite cannot store uint64 as int - store as blob instead.
+/// sqlite cannot store uint64 as int - store the bits as signed int64 instead.
 QVariant db_conversions::fromHashValue(const HashValue &val)
 {
-    QByteArray hashBytes;
-    if(! val.isNull()){
-        hashBytes = qBytesFromVar(val.value());
+    if(val.isNull()){
+        return QVariant(QVariant::LongLong);
     }
-    return  { hashBytes };
+    return QVariant(static_cast<qint64>(val.value()));
 }
 
 HashValue db_conversions::toHashValue(const QVariant &var)
@@ -23,5 +42,45 @@ HashValue db_conversions::toHashValue(const QVariant &var)
     if(var.isNull()){
         return {};
     }
-    return varFromQBytes<HashValue::value_type>(var.toByteArray());
+    return HashValue(static_cast<HashValue::value_type>(var.toLongLong()));
+}
+
+/// Convert a value used in a query to the representation within the
+/// database, e.g. QDateTime to milliseconds since epoch.
+QVariant db_conversions::toDbValue(const QVariant &var)
+{
+    if(var.type() == QVariant::DateTime){
+        return fromDateTime(var.toDateTime());
+    }
+    return var;
+}
+
+/// @return the ids comma-separated, e.g. for use within 'in (...)'.
+/// Integers are safe to inline and doing so avoids sqlite's limit
+/// of bound variables.
+QString db_conversions::idsToSqlList(const QVector<qint64> &ids)
+{
+    QString list;
+    list.reserve(ids.size() * 8);
+    for(const qint64 id : ids){
+        if(! list.isEmpty()){
+            list += ',';
+        }
+        list += QString::number(id);
+    }
+    return list;
+}
+
+/// @param argv: the arguments separated by null bytes, as in /proc/pid/cmdline
+/// @return the arguments as compact JSON array of strings, so arguments
+/// containing spaces remain distinguishable.
+QVariant db_conversions::fromArgv(const std::string &argv)
+{
+    QJsonArray args;
+    if(! argv.empty()){
+        for(const QByteArray& arg : QByteArray::fromStdString(argv).split('\0')){
+            args.append(QString::fromLocal8Bit(arg));
+        }
+    }
+    return QString::fromUtf8(QJsonDocument(args).toJson(QJsonDocument::Compact));
 }
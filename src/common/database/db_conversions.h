@@ -1,18 +1,27 @@
 #pragma once
 
 #include <QVariant>
+#include <QDateTime>
+#include <QVector>
 #include <ctime>
+#include <string>
 
 #include "nullable_value.h"
 
 namespace db_conversions {
+    QVariant fromDateTime(const QDateTime& dt);
+    QDateTime toDateTime(const QVariant& var);
+
     QVariant fromMtime(time_t mtime);
     // Not toMtime, because we work with QDateTime afterwards
 
     QVariant fromHashValue(const HashValue& val);
     HashValue toHashValue(const QVariant& var);
 
+    QVariant toDbValue(const QVariant& var);
 
-}
+    QString idsToSqlList(const QVector<qint64>& ids);
 
+    QVariant fromArgv(const std::string& argv);
+}
 
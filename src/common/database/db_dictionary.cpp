@@ -0,0 +1,67 @@
+
+#include "db_dictionary.h"
+#include "util.h"
+
+namespace  {
+
+/// @return the parent directory of path or a null string, if
+/// path has no parent (root-dir or not absolute).
+QString parentDir(const QString& path){
+    const int lastSlash = path.lastIndexOf('/');
+    if(lastSlash == -1 || path == "/"){
+        return {};
+    }
+    if(lastSlash == 0){
+        return QStringLiteral("/");
+    }
+    return path.left(lastSlash);
+}
+
+} // namespace
+
+
+DbDictionary::DbDictionary() :
+    m_query(db_connection::mkQuery())
+{}
+
+/// @return the id of the given directory path, which is inserted
+/// (including its parents) if it does not exist yet.
+qint64 DbDictionary::dirId(const QString &path)
+{
+    auto it = m_dirIds.find(path);
+    if(it != m_dirIds.end()){
+        return it.value();
+    }
+    m_query->prepare("select id from directory where path=?");
+    m_query->addBindValue(path);
+    m_query->exec();
+    qint64 id;
+    if(m_query->next()){
+        id = qVariantTo_throw<qint64>(m_query->value(0));
+    } else {
+        const QString parent = parentDir(path);
+        const QVariant parentId = (parent.isNull()) ? QVariant(QVariant::LongLong)
+                                                    : QVariant(dirId(parent));
+        m_query->prepare("insert into directory (parentId, path) values (?,?)");
+        m_query->addBindValue(parentId);
+        m_query->addBindValue(path);
+        m_query->exec();
+        id = qVariantTo_throw<qint64>(m_query->lastInsertId());
+    }
+    m_dirIds.insert(path, id);
+    return id;
+}
+
+/// @return the id of the given command text, which is inserted
+/// if it does not exist yet.
+qint64 DbDictionary::cmdTextId(const QString &txt)
+{
+    auto it = m_cmdTextIds.find(txt);
+    if(it != m_cmdTextIds.end()){
+        return it.value();
+    }
+    const auto id = qVariantTo_throw<qint64>(
+                m_query->insertIfNotExist("cmdText", {{"txt", txt}}));
+    m_cmdTextIds.insert(txt, id);
+    return id;
+}
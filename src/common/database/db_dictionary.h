@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+
+#include "db_connection.h"
+
+/// Interns directory paths and command texts into their dictionary-tables
+/// ('directory' and 'cmdText'), which are referenced by integer ids
+/// from the cmd-, writtenFile- and readFile-table.
+/// Directories are linked to their parent directory, the parent
+/// is interned first, if necessary.
+/// Already seen strings are cached, so create one instance per transaction.
+class DbDictionary
+{
+public:
+    DbDictionary();
+
+    qint64 dirId(const QString& path);
+    qint64 cmdTextId(const QString& txt);
+
+public:
+    DbDictionary(const DbDictionary &) = delete ;
+    void operator=(const DbDictionary &) = delete ;
+
+private:
+    QueryPtr m_query;
+    QHash<QString, qint64> m_dirIds;
+    QHash<QString, qint64> m_cmdTextIds;
+};
+
@@ -0,0 +1,532 @@
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTemporaryFile>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "db_partitions.h"
+#include "app.h"
+#include "db_connection.h"
+#include "query_columns.h"
+#include "sqlite_database_scheme_updates.h"
+#include "qexcdatabase.h"
+#include "exccommon.h"
+#include "logger.h"
+#include "util.h"
+
+using sqlite_database_scheme_updates::cmdTables;
+
+namespace  {
+
+/// Archiving, merging and deleting partitions (exclusive) is serialized
+/// among processes and against attaching them (shared), so no process
+/// attaches a partition which another one has just merged and unlinked
+/// (attaching a missing file creates an empty one).
+/// The lock is released when closing the file.
+class PartitionsLock {
+public:
+    /// @throws QExcIo
+    PartitionsLock() {
+        const QString path = db_connection::getDatabaseDir() + "/partitions.lock";
+        m_fd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if(m_fd == -1){
+            throw QExcIo(qtr("Failed to open %1: %2").arg(path, strerror(errno)));
+        }
+    }
+
+    ~PartitionsLock(){
+        ::close(m_fd);
+    }
+
+    /// @param operation: LOCK_EX or LOCK_SH, optionally or'ed with LOCK_NB.
+    /// @return false, if LOCK_NB was given and another process holds the lock.
+    /// @throws QExcIo
+    bool lock(int operation){
+        while(::flock(m_fd, operation) == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno == EWOULDBLOCK){
+                return false;
+            }
+            throw QExcIo(qtr("Failed to lock the partitions: %1").arg(strerror(errno)));
+        }
+        return true;
+    }
+
+public:
+    PartitionsLock(const PartitionsLock &) = delete ;
+    void operator=(const PartitionsLock &) = delete ;
+
+private:
+    int m_fd;
+};
+
+/// Same layout as in the main database, but without foreign keys to the
+/// dictionaries, which are not part of the partition.
+void createTablesIfNotExist(QSqlQueryThrow& query, const QString& schema){
+    for(const auto& t : cmdTables()){
+        query.exec(t.createSql(schema, t.name, false));
+        for(const QString& sql : t.createIndexSqls(schema)){
+            query.exec(sql);
+        }
+    }
+}
+
+void dropViews(QSqlQueryThrow& query){
+    for(const auto& t : cmdTables()){
+        query.exec("drop view if exists temp." + t.name);
+    }
+}
+
+/// The views are only created, if partitions are attached, so otherwise
+/// the tables of the main database are accessed directly.
+void createViews(QSqlQueryThrow& query, const db_partitions::Partitions& partitions){
+    dropViews(query);
+    if(partitions.isEmpty()){
+        return;
+    }
+    for(const auto& t : cmdTables()){
+        const QString columns = t.columnNames();
+        QString sql = "create temp view " + t.name + " as select " +
+                columns + " from main." + t.name;
+        for(const auto& p : partitions){
+            sql += " union all select " + columns + " from " + p.schema + "." + t.name;
+        }
+        query.exec(sql);
+    }
+}
+
+/// Must not be called within a transaction. Creates the partition, if
+/// it does not exist yet.
+void attach(QSqlQueryThrow& query, const db_partitions::Partition& p){
+    logDebug << "attaching partition" << p.path;
+    query.prepare("ATTACH DATABASE ? AS " + p.schema);
+    query.addBindValue(p.path);
+    query.exec();
+    createTablesIfNotExist(query, p.schema);
+}
+
+bool containsSchema(const db_partitions::Partitions& partitions, const QString& schema){
+    return std::any_of(partitions.begin(), partitions.end(),
+                       [&schema](const db_partitions::Partition& p){ return p.schema == schema; });
+}
+
+bool containsCmd(QSqlQueryThrow& query, const QString& schema, qint64 cmdId){
+    query.prepare("select 1 from " + schema + ".cmd where id=?");
+    query.addBindValue(cmdId);
+    query.exec();
+    return query.next();
+}
+
+void sortByYear(db_partitions::Partitions& partitions){
+    std::sort(partitions.begin(), partitions.end(),
+              [](const db_partitions::Partition& p1, const db_partitions::Partition& p2){
+        return p1.firstYear < p2.firstYear ||
+               (p1.firstYear == p2.firstYear && p1.lastYear > p2.lastYear);
+    });
+}
+
+/// An interrupted merge may leave its source partitions next to the
+/// merged one, which already contains their commands.
+bool isCoveredByOther(const db_partitions::Partition& p,
+                      const db_partitions::Partitions& partitions){
+    return std::any_of(partitions.begin(), partitions.end(),
+                       [&p](const db_partitions::Partition& o){
+        return o.schema != p.schema && o.firstYear <= p.firstYear && p.lastYear <= o.lastYear;
+    });
+}
+
+/// @return all partition files within the database directory, ordered by year
+db_partitions::Partitions partitionFiles(){
+    static const QRegularExpression rx("^database-(\\d{4})(?:-(\\d{4}))?\\.db$");
+    db_partitions::Partitions partitions;
+    const QDir dir(db_connection::getDatabaseDir());
+    for(const QString& fname : dir.entryList({"database-*.db"}, QDir::Files)){
+        const auto match = rx.match(fname);
+        if(match.hasMatch()){
+            const int firstYear = match.captured(1).toInt();
+            const int lastYear = (match.captured(2).isEmpty()) ? firstYear
+                                                               : match.captured(2).toInt();
+            partitions.push_back(db_partitions::forYears(firstYear, lastYear));
+        }
+    }
+    sortByYear(partitions);
+    return partitions;
+}
+
+/// Attach exactly the given partitions (detach all others)
+/// @throws QExcDatabase
+void setAttached(const db_partitions::Partitions& wanted){
+    if(wanted.size() > db_partitions::MAX_PARTITIONS){
+        throw QExcDatabase(qtr("Cannot attach %1 partitions at once (max. %2). "
+                               "Merge the oldest ones via %3 --delete --partition.")
+                           .arg(wanted.size()).arg(db_partitions::MAX_PARTITIONS)
+                           .arg(app::SHOURNAL));
+    }
+    auto query = db_connection::mkQuery();
+    dropViews(*query);
+    const auto current = db_partitions::attached();
+    for(const auto& p : current){
+        if(! containsSchema(wanted, p.schema)){
+            query->exec("DETACH DATABASE " + p.schema);
+        }
+    }
+    for(const auto& p : wanted){
+        if(! containsSchema(current, p.schema)){
+            attach(*query, p);
+        }
+    }
+    createViews(*query, wanted);
+}
+
+void removeFileOrThrow(const QString& path){
+    QFile f(path);
+    if(! f.remove()){
+        throw QExcIo(qtr("Failed to delete the partition %1: %2")
+                     .arg(path, f.errorString()));
+    }
+}
+
+const char* MERGE_TMP_PREFIX = "partition-merge-";
+
+/// Copy the partition into a new, uniquely named file next to it.
+/// @throws QExcIo
+void copyToTmp(const db_partitions::Partition& p, QTemporaryFile& tmpFile){
+    tmpFile.setFileTemplate(db_connection::getDatabaseDir() + "/" +
+                            MERGE_TMP_PREFIX + "XXXXXX.tmp");
+    if(! tmpFile.open()){
+        throw QExcIo(qtr("Failed to create a temporary file for merging %1: %2")
+                     .arg(p.path, tmpFile.errorString()));
+    }
+    QFile src(p.path);
+    if(! src.open(QFile::ReadOnly)){
+        throw QExcIo(qtr("Failed to open %1: %2").arg(p.path, src.errorString()));
+    }
+    while(! src.atEnd()){
+        const QByteArray buf = src.read(1024*1024);
+        if(buf.isEmpty() || tmpFile.write(buf) != buf.size()){
+            throw QExcIo(qtr("Failed to copy %1 to %2: %3")
+                         .arg(p.path, tmpFile.fileName(), tmpFile.errorString()));
+        }
+    }
+    if(! tmpFile.flush()){
+        throw QExcIo(qtr("Failed to copy %1 to %2: %3")
+                     .arg(p.path, tmpFile.fileName(), tmpFile.errorString()));
+    }
+}
+
+/// Merge the two oldest partitions, until at most MAX_PARTITIONS exist.
+/// The merged file is built next to the sources and only renamed into place
+/// once complete, so an interruption loses nothing: until the sources are
+/// deleted, they are ignored as covered by the merged one (see existing).
+/// Must not be called within a transaction or with partitions attached
+/// and only while holding the PartitionsLock exclusively.
+/// @throws QExcDatabase, QExcIo
+void mergeOldest(QSqlQueryThrow& query){
+    const auto files = partitionFiles();
+    for(const auto& p : files){
+        if(isCoveredByOther(p, files)){
+            logInfo << qtr("Deleting the leftover partition %1").arg(p.path);
+            removeFileOrThrow(p.path);
+        }
+    }
+    // holding the lock, no other merge is in progress
+    const QDir dir(db_connection::getDatabaseDir());
+    for(const QString& fname : dir.entryList({QString(MERGE_TMP_PREFIX) + "*.tmp"}, QDir::Files)){
+        logInfo << qtr("Deleting the leftover temporary file %1").arg(dir.filePath(fname));
+        removeFileOrThrow(dir.filePath(fname));
+    }
+    auto partitions = db_partitions::existing();
+    while(partitions.size() > db_partitions::MAX_PARTITIONS){
+        const db_partitions::Partition older = partitions[0];
+        const db_partitions::Partition newer = partitions[1];
+        const auto merged = db_partitions::forYears(older.firstYear, newer.lastYear);
+        logInfo << qtr("Merging the partitions %1 and %2 into %3")
+                   .arg(older.path, newer.path, merged.path);
+        QTemporaryFile tmpFile;
+        copyToTmp(older, tmpFile);
+        db_partitions::Partition tmp = merged;
+        tmp.path = tmpFile.fileName();
+        tmp.schema = "pmerge";
+        attach(query, tmp);
+        attach(query, newer);
+        query.transaction();
+        for(const auto& t : cmdTables()){
+            const QString columns = t.columnNames();
+            query.exec("insert into " + tmp.schema + "." + t.name + " (" + columns +
+                       ") select " + columns + " from " + newer.schema + "." + t.name);
+        }
+        query.commit();
+        query.exec("DETACH DATABASE " + tmp.schema);
+        query.exec("DETACH DATABASE " + newer.schema);
+        tmpFile.close();
+        if(! QFile::rename(tmp.path, merged.path)){
+            throw QExcIo(qtr("Failed to rename %1 to %2").arg(tmp.path, merged.path));
+        }
+        tmpFile.setAutoRemove(false);
+        removeFileOrThrow(older.path);
+        removeFileOrThrow(newer.path);
+        partitions = db_partitions::existing();
+    }
+}
+
+} // namespace
+
+
+/// @return the partition of commands started in [firstYear, lastYear]
+db_partitions::Partition db_partitions::forYears(int firstYear, int lastYear)
+{
+    Partition p;
+    p.firstYear = firstYear;
+    p.lastYear = lastYear;
+    const QString years = (firstYear == lastYear)
+            ? QString::number(firstYear)
+            : QString::number(firstYear) + "-" + QString::number(lastYear);
+    p.path = db_connection::getDatabaseDir() + "/database-" + years + ".db";
+    p.schema = "p" + QString(years).replace('-', '_');
+    p.beginMs = QDateTime(QDate(firstYear, 1, 1)).toMSecsSinceEpoch();
+    p.endMs = QDateTime(QDate(lastYear + 1, 1, 1)).toMSecsSinceEpoch();
+    return p;
+}
+
+db_partitions::Partition db_partitions::forYear(int year)
+{
+    return forYears(year, year);
+}
+
+/// @return the partitions within the database directory, ordered by year
+db_partitions::Partitions db_partitions::existing()
+{
+    const Partitions files = partitionFiles();
+    Partitions partitions;
+    for(const auto& p : files){
+        if(isCoveredByOther(p, files)){
+            logDebug << "ignoring leftover partition" << p.path;
+            continue;
+        }
+        partitions.push_back(p);
+    }
+    return partitions;
+}
+
+/// @return the partitions attached to the database connection, ordered by year
+db_partitions::Partitions db_partitions::attached()
+{
+    static const QRegularExpression rx("^p(\\d{4})(?:_(\\d{4}))?$");
+    auto query = db_connection::mkQuery();
+    query->exec("PRAGMA database_list");
+    Partitions partitions;
+    while(query->next()){
+        const auto match = rx.match(query->value(1).toString());
+        if(match.hasMatch()){
+            const int firstYear = match.captured(1).toInt();
+            const int lastYear = (match.captured(2).isEmpty()) ? firstYear
+                                                               : match.captured(2).toInt();
+            partitions.push_back(forYears(firstYear, lastYear));
+        }
+    }
+    sortByYear(partitions);
+    return partitions;
+}
+
+/// @return 'main' and the schema names of the attached partitions, which
+/// contain the tables cmd, writtenFile, readFileCmd and process.
+QStringList db_partitions::cmdSchemas()
+{
+    QStringList schemas {"main"};
+    for(const auto& p : attached()){
+        schemas.push_back(p.schema);
+    }
+    return schemas;
+}
+
+namespace  {
+
+/// See archiveCompletedYears. Must only be called while holding the
+/// PartitionsLock exclusively.
+int archiveCompletedYearsLocked(const QDate &today)
+{
+    setAttached({});
+    auto query = db_connection::mkQuery();
+    mergeOldest(*query);
+    const QString hotBeginMs = QString::number(db_partitions::forYear(today.year()).beginMs);
+    const QString completed = " startTime<" + hotBeginMs + " and endTime<" + hotBeginMs;
+    int countOfArchived = 0;
+    while(true){
+        query->exec("select min(startTime) from main.cmd where" + completed);
+        query->next(true);
+        if(query->value(0).isNull()){
+            break;
+        }
+        const int year = QDateTime::fromMSecsSinceEpoch(
+                    query->value(0).toLongLong()).date().year();
+        db_partitions::Partition p = db_partitions::forYear(year);
+        for(const auto& e : db_partitions::existing()){
+            if(e.firstYear <= year && year <= e.lastYear){
+                p = e;
+            }
+        }
+        // attaching is not possible within a transaction
+        attach(*query, p);
+        logInfo << qtr("Moving the commands of %1 to %2").arg(year).arg(p.path);
+
+        query->transaction();
+        const QString range = " where startTime>=" + QString::number(p.beginMs) +
+                " and startTime<" + QString::number(p.endMs) + " and" + completed;
+        const QString cmdIds = "(select id from main.cmd" + range + ")";
+        // cmd is first, so the foreign keys of the others are satisfied
+        for(const auto& t : cmdTables()){
+            const QString columns = t.columnNames();
+            const QString where = (t.name == "cmd") ? range : " where cmdId in " + cmdIds;
+            query->exec("insert into " + p.schema + "." + t.name + " (" + columns +
+                        ") select " + columns + " from main." + t.name + where);
+            if(t.name == "cmd"){
+                countOfArchived += query->numRowsAffected();
+            }
+        }
+        // cascades to writtenFile, readFileCmd and process
+        query->exec("delete from main.cmd" + range);
+        query->commit();
+        query->exec("DETACH DATABASE " + p.schema);
+        mergeOldest(*query);
+    }
+    return countOfArchived;
+}
+
+} // namespace
+
+/// Move all commands which started and ended before the year of 'today'
+/// from the main database into their partition. Is also the migration
+/// from a single database file.
+/// Commands still observed (e.g. started at new year's eve) usually have a
+/// later, preliminary end time and stay in the main database. Otherwise
+/// they are found by schemaOfCmd.
+/// Detaches all partitions. Must not be called within a transaction.
+/// Waits, while another process archives or deletes partitions.
+/// @return the count of archived commands
+/// @throws QExcDatabase, QExcIo
+int db_partitions::archiveCompletedYears(const QDate &today)
+{
+    PartitionsLock lock;
+    lock.lock(LOCK_EX);
+    return archiveCompletedYearsLocked(today);
+}
+
+/// Once partitioned, keep the main database small. Called when storing
+/// a command, so it is cheap, if there is nothing to archive. Archiving
+/// is skipped, while another process archives or deletes partitions.
+/// Must not be called within a transaction.
+/// @throws QExcDatabase, QExcIo
+void db_partitions::archiveIfPartitioned(const QDate &today)
+{
+    if(existing().isEmpty()){
+        return;
+    }
+    auto query = db_connection::mkQuery();
+    const QString hotBeginMs = QString::number(forYear(today.year()).beginMs);
+    query->exec("select 1 from main.cmd where startTime<" + hotBeginMs +
+                " and endTime<" + hotBeginMs + " limit 1");
+    if(! query->next()){
+        return;
+    }
+    PartitionsLock lock;
+    if(! lock.lock(LOCK_EX | LOCK_NB)){
+        logDebug << "partitions are locked by another process, not archiving";
+        return;
+    }
+    archiveCompletedYearsLocked(today);
+}
+
+/// @return the schema which contains the command: 'main' or that of a
+/// partition, which is attached then. A command observed across the turn
+/// of the year may have been archived before it was finally stored.
+/// Must not be called within a transaction.
+/// @param startTime: the partition of the start time is tried first.
+/// @throws QExcDatabase, if the command exists nowhere
+QString db_partitions::schemaOfCmd(qint64 cmdId, const QDateTime &startTime)
+{
+    auto query = db_connection::mkQuery();
+    if(containsCmd(*query, "main", cmdId)){
+        return "main";
+    }
+    PartitionsLock lock;
+    lock.lock(LOCK_SH);
+    Partitions candidates = existing();
+    const qint64 startMs = startTime.toMSecsSinceEpoch();
+    std::stable_partition(candidates.begin(), candidates.end(), [startMs](const Partition& p){
+        return p.beginMs <= startMs && startMs < p.endMs;
+    });
+    for(const auto& p : candidates){
+        Partitions current = attached();
+        if(! containsSchema(current, p.schema)){
+            current.push_back(p);
+            setAttached(current);
+        }
+        if(containsCmd(*query, p.schema, cmdId)){
+            return p.schema;
+        }
+    }
+    throw QExcDatabase(qtr("The command with id %1 does not exist").arg(cmdId));
+}
+
+/// Attach only the partitions which may contain commands matching
+/// the query, as restricted by its start- or end time.
+void db_partitions::attachForQuery(const SqlQuery &sqlQ)
+{
+    const auto& cols = db_controller::QueryColumns::instance();
+    PartitionsLock lock;
+    lock.lock(LOCK_SH);
+    auto range = sqlQ.numericRange(cols.cmd_starttime);
+    // a command ends after it started
+    range.second = std::min(range.second, sqlQ.numericRange(cols.cmd_endtime).second);
+    Partitions wanted;
+    for(const auto& p : existing()){
+        if(p.beginMs <= range.second && p.endMs > range.first){
+            wanted.push_back(p);
+        }
+    }
+    if(wanted.isEmpty() && attached().isEmpty()){
+        return;
+    }
+    setAttached(wanted);
+}
+
+void db_partitions::attachAll()
+{
+    PartitionsLock lock;
+    lock.lock(LOCK_SH);
+    const Partitions partitions = existing();
+    if(partitions.isEmpty() && attached().isEmpty()){
+        return;
+    }
+    setAttached(partitions);
+}
+
+/// Detach the partition, so the views no longer contain its commands.
+void db_partitions::detach(const Partition &p)
+{
+    Partitions others = attached();
+    others.erase(std::remove_if(others.begin(), others.end(), [&p](const Partition& o){
+        return o.schema == p.schema; }), others.end());
+    setAttached(others);
+}
+
+/// Delete the file of the (detached) partition with all contained commands.
+/// Dictionary entries which were only referenced by those commands are
+/// not cleaned up here.
+/// @throws QExcIo
+void db_partitions::removeFile(const Partition &p)
+{
+    logInfo << qtr("Deleting the partition %1").arg(p.path);
+    PartitionsLock lock;
+    lock.lock(LOCK_EX);
+    removeFileOrThrow(p.path);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QDate>
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "sqlquery.h"
+
+/// Commands (including their file events) of completed years may be moved
+/// from the main database into one sqlite file per year (database-yyyy.db)
+/// within the database directory. The dictionaries (command texts,
+/// directories, environments, read files, etc.) remain in the main database.
+/// Attached partitions are combined with the main database by temporary
+/// UNION ALL views named like the partitioned tables (cmd, writtenFile,
+/// readFileCmd, process), which take precedence over the tables of the main
+/// database. So statements modifying those tables must qualify them with a
+/// schema (see cmdSchemas).
+/// sqlite limits the count of attached databases (10 per default, one of
+/// which is used for the store of read files), so at most MAX_PARTITIONS
+/// partitions exist: beyond that, the oldest ones are merged into a file
+/// spanning several years (database-yyyy-yyyy.db).
+/// Commands are archived when storing the first command of a process (once
+/// partitioned) or explicitly via shournal --delete --partition, but never
+/// while querying. Processes coordinate via a lock file in the database
+/// directory (partitions.lock).
+namespace db_partitions {
+
+const int MAX_PARTITIONS = 8;
+
+struct Partition {
+    int firstYear {};
+    int lastYear {};
+    QString path;
+    QString schema;
+    qint64 beginMs {}; // startTime of its commands lies within [beginMs, endMs)
+    qint64 endMs {};
+};
+typedef QVector<Partition> Partitions;
+
+Partition forYears(int firstYear, int lastYear);
+Partition forYear(int year);
+Partitions existing();
+Partitions attached();
+QStringList cmdSchemas();
+
+int archiveCompletedYears(const QDate& today=QDate::currentDate());
+void archiveIfPartitioned(const QDate& today=QDate::currentDate());
+QString schemaOfCmd(qint64 cmdId, const QDateTime& startTime);
+
+void attachForQuery(const SqlQuery& sqlQ);
+void attachAll();
+void detach(const Partition& p);
+void removeFile(const Partition& p);
+
+}
+
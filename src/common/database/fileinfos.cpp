@@ -11,6 +11,7 @@ void FileWriteInfo::write(QJsonObject &json) const
     json["size"] = size;
     json["mtime"] = QJsonValue::fromVariant(mtime);
     json["hash"] = QJsonValue::fromVariant(QVariant::fromValue(hash));
+    json["processExe"] = processExe;
 }
 
 bool
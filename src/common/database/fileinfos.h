@@ -17,6 +17,7 @@ struct FileWriteInfo
     QString   path;
     QString   name;
     HashValue  hash;
+    QString   processExe; // empty, if unknown
 
     void write(QJsonObject &json) const;
 
@@ -35,6 +36,7 @@ struct FileReadInfo
     mode_t mode {};
     HashValue hash;
     bool isStoredToDisk {false};
+    QString blobHash; // see StoredFiles
 
     void write(QJsonObject &json) const;
 
@@ -5,6 +5,9 @@
 
 namespace db_controller {
 
+/// Column names to be used in a SqlQuery passed to db_controller.
+/// Paths and command texts are stored in dictionary tables,
+/// their names refer to the aliases used in the generated queries.
 class QueryColumns {
 public:
     static QueryColumns& instance() {
@@ -13,8 +16,8 @@ public:
     }
 
     const QString cmd_id {"cmd.id"};
-    const QString cmd_txt {"cmd.txt"};
-    const QString cmd_workingDir {"cmd.workingDirectory"};
+    const QString cmd_txt {"cmdText.txt"};
+    const QString cmd_workingDir {"cmdWorkingDir.path"};
     const QString cmd_comment {"cmd.comment"};
     const QString cmd_endtime {"cmd.endTime"};
     const QString cmd_starttime {"cmd.startTime"};
@@ -22,15 +25,17 @@ public:
     const QString env_username {"env.username"};
 
     const QString rFile_name {"readFile.name"};
-    const QString rFile_path {"readFile.path"};
+    const QString rFile_path {"readFileDir.path"};
     const QString rFile_mtime {"readFile.mtime"};
     const QString rFile_size {"readFile.size"};
+    const QString rFile_processExe {"readFileProcess.exe"};
 
     const QString wFile_name {"writtenFile.name"};
     const QString wfile_mtime {"writtenFile.mtime"};
     const QString wFile_size  {"writtenFile.size"};
     const QString wFile_hash  {"writtenFile.hash"};
-    const QString wFile_path  {"writtenFile.path"};
+    const QString wFile_path  {"writtenFileDir.path"};
+    const QString wFile_processExe {"writtenFileProcess.exe"};
 
     const QString session_id {"session.id"};
     const QString session_comment {"session.comment"};
@@ -1,4 +1,246 @@
+#include <limits>
+#include <QVector>
+#include <QPair>
+#include <QVersionNumber>
+
 #include "sqlite_database_scheme_updates.h"
+#include "db_dictionary.h"
+#include "db_conversions.h"
+#include "util.h"
+#include "qexcdatabase.h"
+#include "exccommon.h"
+#include "logger.h"
+
+namespace  {
+
+/// @return sql which converts the local time ISO-text (as written by
+/// Qt for QDateTime) within column col to milliseconds since epoch.
+QString isoTimeToMsecsSql(const QString& col){
+    return "cast(round((julianday(" + col + ",'utc') - 2440587.5) * 86400000.0) as integer)";
+}
+
+/// Convert the hashes within the given table from blobs
+/// to (bit-reinterpreted) signed 64 bit integers.
+/// sqlite cannot reinterpret blobs and changing the table while
+/// selecting from it is undefined, so do it in chunks.
+void blobHashesToInt(QSqlQueryThrow& query, const QString& table){
+    const int CHUNK_SIZE = 10000;
+    QVector<QPair<qint64, QByteArray> > chunk;
+    chunk.reserve(CHUNK_SIZE);
+    qint64 lastId = std::numeric_limits<qint64>::min();
+    do {
+        chunk.clear();
+        query.prepare("select id,hash from " + table + " where id>? and "
+                      "typeof(hash)='blob' order by id limit " + QString::number(CHUNK_SIZE));
+        query.addBindValue(lastId);
+        query.exec();
+        while(query.next()){
+            chunk.push_back({ qVariantTo_throw<qint64>(query.value(0)),
+                              query.value(1).toByteArray() });
+        }
+        query.prepare("update " + table + " set hash=? where id=?");
+        for(const auto& idHash : chunk){
+            HashValue hash;
+            if(idHash.second.size() == sizeof (HashValue::value_type)){
+                hash = varFromQBytes<HashValue::value_type>(idHash.second);
+            }
+            query.addBindValue(db_conversions::fromHashValue(hash));
+            query.addBindValue(idHash.first);
+            query.exec();
+        }
+        if(! chunk.isEmpty()){
+            lastId = chunk.last().first;
+        }
+    } while(chunk.size() == CHUNK_SIZE);
+}
+
+/// The dictionary tables with a trigram index over their text column
+const QVector<QPair<QString, QString> >& fullTextIndexedCols(){
+    static const QVector<QPair<QString, QString> > cols = {
+        {"cmdText", "txt"},
+        {"directory", "path"},
+    };
+    return cols;
+}
+
+bool existsInSchema(QSqlQueryThrow& query, const QString& type, const QString& name){
+    query.prepare("select 1 from sqlite_master where type=? and name=?");
+    query.addBindValue(type);
+    query.addBindValue(name);
+    query.exec();
+    return query.next();
+}
+
+/// @return true, if the trigram index can be used with this sqlite library:
+/// an existing index is queried, otherwise a temporary one is created.
+/// The database may have been written by a host whose sqlite has fts5, so
+/// the table may exist, while the module or tokenizer is missing here.
+bool trigramIndexWorks(QSqlQueryThrow& query, bool indexExists){
+    query.exec("select sqlite_version()");
+    query.next(true);
+    if(QVersionNumber::fromString(query.value(0).toString()) < QVersionNumber{3, 34}){
+        return false;
+    }
+    try {
+        query.exec("SAVEPOINT fulltextprobe");
+        if(indexExists){
+            for(const auto& tableCol : fullTextIndexedCols()){
+                const QString fts = tableCol.first + "_fts";
+                query.exec("select rowid from `" + fts + "` where `" + fts + "` MATCH 'abc' limit 1");
+            }
+        } else {
+            query.exec("CREATE VIRTUAL TABLE temp.`fts_probe` USING fts5(`x`, tokenize='trigram')");
+            query.exec("DROP TABLE temp.`fts_probe`");
+        }
+        query.exec("RELEASE fulltextprobe");
+    } catch (const QExcDatabase& e) {
+        logDebug << "full text index not usable:" << e.descrip();
+        query.exec("ROLLBACK TO fulltextprobe");
+        query.exec("RELEASE fulltextprobe");
+        return false;
+    }
+    return true;
+}
+
+/// Create the triggers which keep the trigram index fts of the text-column col
+/// of the dictionary table up to date.
+void createTrigramTriggers(QSqlQueryThrow& query, const QString& table, const QString& col){
+    const QString fts = table + "_fts";
+    query.exec("CREATE TRIGGER `" + fts + "_ai` AFTER INSERT ON `" + table + "` BEGIN "
+               "INSERT INTO `" + fts + "`(rowid, `" + col + "`) VALUES (new.id, new.`" + col + "`); "
+               "END");
+    query.exec("CREATE TRIGGER `" + fts + "_ad` AFTER DELETE ON `" + table + "` BEGIN "
+               "INSERT INTO `" + fts + "`(`" + fts + "`, rowid, `" + col + "`) "
+               "VALUES('delete', old.id, old.`" + col + "`); "
+               "END");
+    query.exec("CREATE TRIGGER `" + fts + "_au` AFTER UPDATE ON `" + table + "` BEGIN "
+               "INSERT INTO `" + fts + "`(`" + fts + "`, rowid, `" + col + "`) "
+               "VALUES('delete', old.id, old.`" + col + "`); "
+               "INSERT INTO `" + fts + "`(rowid, `" + col + "`) VALUES (new.id, new.`" + col + "`); "
+               "END");
+}
+
+void dropTrigramTriggers(QSqlQueryThrow& query, const QString& table){
+    const QString fts = table + "_fts";
+    for(const char* suffix : {"_ai", "_ad", "_au"}){
+        query.exec("DROP TRIGGER IF EXISTS `" + fts + suffix + "`");
+    }
+}
+
+} // namespace
+
+
+
+/// The tables are ordered such that foreign keys refer to preceding ones.
+/// Ids are never reused (AUTOINCREMENT), as those of deleted or archived
+/// commands (and their events) must stay unique across all partitions.
+const QVector<sqlite_database_scheme_updates::CmdTable> &
+sqlite_database_scheme_updates::cmdTables()
+{
+    static const QString ID = "INTEGER PRIMARY KEY AUTOINCREMENT";
+    static const QString CMD_ID = "INTEGER NOT NULL references cmd(id) ON DELETE CASCADE";
+    // the process belongs to the same command (and partition), so it is
+    // no dictionary reference
+    static const QString PROCESS_ID = "INTEGER references process(id)";
+    static const QVector<CmdTable> tables = {
+        {"cmd", {
+             {"id", ID, {}},
+             {"sessionId", "BLOB", "references session(id)"},
+             {"envId", "INTEGER NOT NULL", "references env(id)"},
+             {"hashmetaId", "INTEGER", {}},
+             {"txtId", "INTEGER NOT NULL", "references cmdText(id)"},
+             {"returnVal", "INTEGER NOT NULL", {}},
+             {"startTime", "timestamp NOT NULL", {}},
+             {"endTime", "timestamp NOT NULL", {}},
+             {"workingDirId", "INTEGER NOT NULL", "references directory(id)"},
+         }, {{"envId"}, {"sessionId"}, {"hashmetaId"}, {"txtId"}, {"workingDirId"},
+             {"startTime"}, {"endTime"}}
+        },
+        // The (child-) processes of a command which caused file events.
+        {"process", {
+             {"id", ID, {}},
+             {"cmdId", CMD_ID, {}},
+             {"pid", "INTEGER NOT NULL", {}},
+             {"parentPid", "INTEGER NOT NULL", {}},
+             {"exe", "TEXT NOT NULL", {}},
+             {"argv", "TEXT NOT NULL", {}}, // JSON array of strings
+         }, {{"cmdId"}}
+        },
+        {"writtenFile", {
+             {"id", ID, {}},
+             {"cmdId", CMD_ID, {}},
+             {"dirId", "INTEGER NOT NULL", "references directory(id)"},
+             {"name", "TEXT NOT NULL", {}},
+             {"mtime", "timestamp NOT NULL", {}},
+             {"size", "INTEGER NOT NULL", {}},
+             {"hash", "BLOB", {}},
+             {"processId", PROCESS_ID, {}},
+         }, // (dirId, name) also serves lookups by dirId only
+         {{"cmdId"}, {"dirId", "name"}, {"name"}, {"mtime"}, {"size"}, {"hash"},
+          {"processId"}}
+        },
+        {"readFileCmd", {
+             {"id", ID, {}},
+             {"cmdId", CMD_ID, {}},
+             {"readFileId", "INTEGER", "references readFile(id)"},
+             {"processId", PROCESS_ID, {}},
+         }, {{"cmdId"}, {"readFileId"}, {"processId"}}
+        },
+    };
+    return tables;
+}
+
+/// @throws QExcProgramming
+const sqlite_database_scheme_updates::CmdTable &
+sqlite_database_scheme_updates::cmdTable(const QString &name)
+{
+    for(const auto& t : cmdTables()){
+        if(t.name == name){
+            return t;
+        }
+    }
+    throw QExcProgramming("no such cmd table: " + name);
+}
+
+/// @return the comma separated column names
+QString sqlite_database_scheme_updates::CmdTable::columnNames() const
+{
+    QStringList names;
+    for(const auto& c : columns){
+        names.push_back(c.name);
+    }
+    return names.join(',');
+}
+
+/// @param withDictionaryRefs: false within a partition, which does not
+///                            contain the dictionaries.
+QString sqlite_database_scheme_updates::CmdTable::createSql(
+        const QString &schema, const QString &tablename, bool withDictionaryRefs) const
+{
+    QStringList defs;
+    for(const auto& c : columns){
+        QString def = "`" + c.name + "` " + c.definition;
+        if(withDictionaryRefs && ! c.dictionaryRef.isEmpty()){
+            def += " " + c.dictionaryRef;
+        }
+        defs.push_back(def);
+    }
+    return "CREATE TABLE IF NOT EXISTS `" + schema + "`.`" + tablename + "` (" +
+            defs.join(',') + ")";
+}
+
+/// @return the statements which create the indexes of this table, named
+/// idx_<table>_<column(s)>.
+QStringList sqlite_database_scheme_updates::CmdTable::createIndexSqls(const QString &schema) const
+{
+    QStringList sqls;
+    for(const QStringList& idxCols : indexes){
+        sqls.push_back("CREATE INDEX IF NOT EXISTS `" + schema + "`.`idx_" + name + "_" +
+                       idxCols.join('_') + "` ON `" + name + "` (`" +
+                       idxCols.join("`, `") + "`)");
+    }
+    return sqls;
+}
 
 
 void sqlite_database_scheme_updates::v0_9(QSqlQueryThrow &query)
@@ -66,3 +308,163 @@ void sqlite_database_scheme_updates::v2_2(QSqlQueryThrow &query)
     query.exec("CREATE INDEX IF NOT EXISTS `idx_cmd_hashmetaId` ON `cmd` (`hashmetaId`)");
     query.exec("CREATE INDEX IF NOT EXISTS `idx_readFile_envId` ON `readFile` (`envId`)");
 }
+
+
+/// Note: must be called with foreign keys disabled, because the tables
+/// cmd, writtenFile, readFileCmd and readFile are re-created (sqlite does not support
+/// dropping columns before 3.35).
+void sqlite_database_scheme_updates::v2_4(QSqlQueryThrow &query)
+{
+    // Intern directory paths and command texts into dictionary tables
+    // which are referenced by integer ids. The same directories and
+    // commands repeat many times, so this shrinks the database
+    // considerably.
+    query.exec(
+        "CREATE TABLE IF NOT EXISTS `directory` ("
+          "`id` INTEGER,"
+          "`parentId` INTEGER references `directory`(id),"
+          "`path` TEXT NOT NULL UNIQUE,"
+          "PRIMARY KEY(`id`)"
+        ")"
+    );
+    query.exec("CREATE INDEX IF NOT EXISTS `idx_directory_parentId` ON `directory` (`parentId`)");
+
+    query.exec(
+        "CREATE TABLE IF NOT EXISTS `cmdText` ("
+          "`id` INTEGER,"
+          "`txt` TEXT NOT NULL UNIQUE,"
+          "PRIMARY KEY(`id`)"
+        ")"
+    );
+
+    query.exec("insert or ignore into cmdText (txt) select txt from cmd");
+
+    {
+        // The parent links are generated by the dictionary itself
+        DbDictionary dict;
+        query.setForwardOnly(true);
+        query.exec("select workingDirectory from cmd union "
+                   "select path from writtenFile union "
+                   "select path from readFile");
+        while(query.next()){
+            dict.dirId(query.value(0).toString());
+        }
+        query.setForwardOnly(false);
+    }
+
+    query.exec(cmdTable("cmd").createSql("main", "cmd_new", true));
+    query.exec("insert into cmd_new "
+               "select cmd.id,sessionId,envId,hashmetaId,cmdText.id,returnVal,"
+               "startTime,endTime,directory.id from cmd "
+               "join cmdText on cmdText.txt=cmd.txt "
+               "join directory on directory.path=cmd.workingDirectory");
+
+    query.exec(cmdTable("process").createSql("main", "process", true));
+
+    query.exec(cmdTable("writtenFile").createSql("main", "writtenFile_new", true));
+    query.exec("insert into writtenFile_new "
+               "select writtenFile.id,cmdId,directory.id,name,mtime,size,hash,NULL "
+               "from writtenFile "
+               "join directory on directory.path=writtenFile.path");
+
+    query.exec(cmdTable("readFileCmd").createSql("main", "readFileCmd_new", true));
+    query.exec("insert into readFileCmd_new "
+               "select id,cmdId,readFileId,NULL from readFileCmd");
+
+    query.exec(
+        "CREATE TABLE `readFile_new` ("
+          "`id` INTEGER,"
+          "`envId` INTEGER NOT NULL references `env`(id),"
+          "`dirId` INTEGER NOT NULL references directory(id),"
+          "`name` TEXT NOT NULL,"
+          "`mtime` timestamp NOT NULL,"
+          "`size` INTEGER NOT NULL,"
+          "`mode` BLOB NOT NULL,"
+          "`hash` BLOB,"
+          "`hashmetaId` INTEGER,"
+          "`isStoredToDisk` INTEGER DEFAULT 1,"
+          // sha256 of the stored content (see StoredFiles), NULL for files
+          // stored before, which are named by their id.
+          "`blobHash` TEXT,"
+          "PRIMARY KEY(`id`)"
+        ")"
+    );
+    query.exec("insert into readFile_new "
+               "select readFile.id,envId,directory.id,name,mtime,size,mode,hash,"
+               "hashmetaId,isStoredToDisk,NULL from readFile "
+               "join directory on directory.path=readFile.path");
+
+    // indexes are dropped along with their table
+    query.exec("drop table writtenFile");
+    query.exec("drop table readFileCmd");
+    query.exec("drop table readFile");
+    query.exec("drop table cmd");
+    query.exec("ALTER TABLE `cmd_new` RENAME TO `cmd`");
+    query.exec("ALTER TABLE `writtenFile_new` RENAME TO `writtenFile`");
+    query.exec("ALTER TABLE `readFileCmd_new` RENAME TO `readFileCmd`");
+    query.exec("ALTER TABLE `readFile_new` RENAME TO `readFile`");
+
+    // Store timestamps as integer milliseconds since epoch and hashes as
+    // signed 64 bit integers instead of ISO-text and blobs, so indexes
+    // become smaller and range comparisons numeric.
+    query.exec("update cmd set "
+               "startTime=" + isoTimeToMsecsSql("startTime") + ","
+               "endTime=" + isoTimeToMsecsSql("endTime") + " "
+               "where typeof(startTime)='text'");
+    query.exec("update writtenFile set mtime=" + isoTimeToMsecsSql("mtime") + " "
+               "where typeof(mtime)='text'");
+    query.exec("update readFile set mtime=" + isoTimeToMsecsSql("mtime") + " "
+               "where typeof(mtime)='text'");
+    blobHashesToInt(query, "writtenFile");
+    blobHashesToInt(query, "readFile");
+
+    // create indexes after the conversion above
+    for(const auto& t : cmdTables()){
+        for(const QString& sql : t.createIndexSqls("main")){
+            query.exec(sql);
+        }
+    }
+    query.exec("CREATE INDEX IF NOT EXISTS `idx_readFile_envId` ON `readFile` (`envId`)");
+    query.exec("CREATE INDEX IF NOT EXISTS `idx_readFile_dirId_name` ON `readFile` (`dirId`, `name`)");
+    query.exec("CREATE INDEX IF NOT EXISTS `idx_readFile_blobHash` ON `readFile` (`blobHash`)");
+}
+
+
+/// Optional full text (substring) index over command texts and directory paths,
+/// so LIKE-queries with wildcards on both sides need not scan the whole table.
+/// Requires sqlite >= 3.34 built with fts5 (trigram tokenizer).
+/// The index lives in the database file, but the sqlite library may differ
+/// between hosts (e.g. a shared home directory), so it is checked on each
+/// open: without a usable fts5 the triggers which maintain the index are
+/// dropped (otherwise inserting into the dictionaries would fail). Once
+/// fts5 is usable again, the index is rebuilt and the triggers are recreated.
+/// @return true, if the index is usable and up to date.
+bool sqlite_database_scheme_updates::setupFullTextIndex(QSqlQueryThrow &query)
+{
+    const bool indexExists = existsInSchema(query, "table", "cmdText_fts");
+    const bool triggersExist = existsInSchema(query, "trigger", "cmdText_fts_ai");
+    if(! trigramIndexWorks(query, indexExists)){
+        if(triggersExist){
+            logInfo << qtr("The sqlite library lacks fts5 with trigram tokenizer - "
+                           "disabling the full text index of the database");
+            for(const auto& tableCol : fullTextIndexedCols()){
+                dropTrigramTriggers(query, tableCol.first);
+            }
+        }
+        return false;
+    }
+    if(indexExists && triggersExist){
+        return true;
+    }
+    for(const auto& tableCol : fullTextIndexedCols()){
+        const QString fts = tableCol.first + "_fts";
+        if(! indexExists){
+            query.exec("CREATE VIRTUAL TABLE `" + fts + "` USING fts5(`" + tableCol.second + "`, "
+                       "content='" + tableCol.first + "', content_rowid='id', tokenize='trigram')");
+        }
+        // the dictionary might have changed while there were no triggers
+        query.exec("INSERT INTO `" + fts + "`(`" + fts + "`) VALUES('rebuild')");
+        createTrigramTriggers(query, tableCol.first, tableCol.second);
+    }
+    return true;
+}
@@ -1,11 +1,40 @@
 #pragma once
 
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
 #include "qsqlquerythrow.h"
 
 namespace sqlite_database_scheme_updates {
+
+    /// Current layout of a table holding commands or their events. These
+    /// tables are also created within each partition (see db_partitions),
+    /// so their layout is defined only once, here.
+    struct CmdTable {
+        struct Column {
+            QString name;
+            QString definition;
+            QString dictionaryRef; // foreign key into the main database, if any
+        };
+        QString name;
+        QVector<Column> columns;
+        QVector<QStringList> indexes; // the indexed columns per index
+
+        QString columnNames() const;
+        QString createSql(const QString& schema, const QString& tablename,
+                          bool withDictionaryRefs) const;
+        QStringList createIndexSqls(const QString& schema) const;
+    };
+    const QVector<CmdTable>& cmdTables();
+    const CmdTable& cmdTable(const QString& name);
+
     void v0_9(QSqlQueryThrow& query); // 0.8 -> 0.9
     void v2_1(QSqlQueryThrow& query); // 2.0 -> 2.1
     void v2_2(QSqlQueryThrow& query); // 2.1 -> 2.2
+    void v2_4(QSqlQueryThrow& query); // 2.3 -> 2.4
+
+    bool setupFullTextIndex(QSqlQueryThrow& query);
 
 }
 
@@ -1,10 +1,37 @@
 
 #include <QDebug>
+#include <algorithm>
 #include "sqlquery.h"
+#include "db_conversions.h"
 #include "exccommon.h"
 #include "util.h"
 
 
+namespace  {
+
+/// Set range to the values of an integer column for which 'column op dbValue'
+/// may be true, unrestricted for other types or operators.
+/// @return true, if the range is exactly the set of those values.
+bool numericRangeOf(const QVariant& dbValue, const CompareOperator& op,
+                    SqlQuery::NumericRange& range){
+    range = {std::numeric_limits<qint64>::min(), std::numeric_limits<qint64>::max()};
+    if(dbValue.isNull() ||
+            (dbValue.type() != QVariant::LongLong && dbValue.type() != QVariant::Int)){
+        return false;
+    }
+    const qint64 val = dbValue.toLongLong();
+    switch (op.asEnum()) {
+    case E_CompareOperator::EQ: range = {val, val}; return true;
+    case E_CompareOperator::GT: range.first = val + 1; return true;
+    case E_CompareOperator::GE: range.first = val; return true;
+    case E_CompareOperator::LT: range.second = val - 1; return true;
+    case E_CompareOperator::LE: range.second = val; return true;
+    default: return false;
+    }
+}
+
+} // namespace
+
 
 const QString &SqlQuery::query() const
 {
@@ -21,10 +48,43 @@ const QVariantList &SqlQuery::values() const
     return m_values;
 }
 
+/// @return the conditions added via addWithAnd in that order. Their
+/// conjunction is equivalent to query() and values(), unless the query
+/// was set via setQuery.
+const QVector<SqlQuery::Term> &SqlQuery::terms() const
+{
+    return m_terms;
+}
+
+/// @return the (inclusive) range of values of an integer column (e.g. a
+/// timestamp) which can satisfy this query, e.g. (min, 9) for 'col < 10'.
+/// For an unrestricted column (or a query set via setQuery) the range
+/// is (min, max) of qint64.
+/// @param isExact: if given, set to true, if all conditions on that column
+///                 are equivalent to the range (other columns are not considered).
+SqlQuery::NumericRange SqlQuery::numericRange(const QString &columnName, bool *isExact) const
+{
+    NumericRange range {std::numeric_limits<qint64>::min(),
+                        std::numeric_limits<qint64>::max()};
+    bool exact = true;
+    for(const Term& t : m_terms){
+        if(t.column == columnName){
+            range.first = std::max(range.first, t.range.first);
+            range.second = std::min(range.second, t.range.second);
+            exact = exact && t.rangeIsExact;
+        }
+    }
+    if(isExact != nullptr){
+        *isExact = exact && ! m_terms.isEmpty();
+    }
+    return range;
+}
+
 void SqlQuery::clear()
 {
     m_query.clear();
     m_values.clear();
+    m_terms.clear();
     m_columnSet.clear();
     m_tablenames.clear();
     m_ascending = true;
@@ -73,10 +133,9 @@ void SqlQuery::addWithAnd(const QString &columnName, const QVariantList &values,
 
     auto actualOps = expandOperatorsIfNeeded(operators, values.size());
 
-    if(! m_query.isEmpty()){
-        m_query += " and ";
-    }
-    m_query += " ( ";
+    Term term;
+    term.column = columnName;
+    term.sql = " ( ";
 
     auto valueIt = values.begin();
     auto operatorIt = actualOps.begin();
@@ -88,47 +147,129 @@ void SqlQuery::addWithAnd(const QString &columnName, const QVariantList &values,
         innerJunction = " and ";
     } else {
         innerJunction = " or ";
+        // the hull of the ranges of all values is grown below
+        std::swap(term.range.first, term.range.second);
     }
+    // a disjunction of ranges is only exact for a single value
+    term.rangeIsExact = innerJunction == " and " || values.size() == 1;
+    term.junction = innerJunction;
     while(valueIt != values.end()){
         if(valueIt != values.begin()){
-            m_query += innerJunction;
+            term.sql += innerJunction;
         }
         const QVariant & var = *valueIt;
+        if(! var.isNull() && operatorIt->asEnum() == E_CompareOperator::BETWEEN){
+            throw QExcIllegalArgument("BETWEEN passed within list with len > 1");
+        }
+        const Comparison cmp{*operatorIt, db_conversions::toDbValue(var)};
+        term.sql += mkComparisonSql(columnName, cmp, term.values);
+        term.comparisons.push_back(cmp);
 
-        if(var.isNull()){
-            // null values are only allowed for certain operators:
-            QString operatorNow;
-            switch (operatorIt->asEnum()) {
-            case E_CompareOperator::EQ:
-            case E_CompareOperator::LIKE:
-                operatorNow = " is null "; break;
-            case E_CompareOperator::NE:
-                operatorNow = " is not null "; break;
-            default:
-                throw QExcIllegalArgument("null is illegal for operator " +
-                                          operatorIt->asSql() + " in column " +
-                                          columnName
-                                          );
-            }
-             m_query += columnName + operatorNow ;
+        NumericRange valRange;
+        if(! numericRangeOf(db_conversions::toDbValue(var), *operatorIt, valRange)){
+            term.rangeIsExact = false;
+        }
+        if(innerJunction == " and "){
+            term.range.first = std::max(term.range.first, valRange.first);
+            term.range.second = std::min(term.range.second, valRange.second);
         } else {
-            if(operatorIt->asEnum() == E_CompareOperator::BETWEEN){
-                throw QExcIllegalArgument("BETWEEN passed within list with len > 1");
-            }
-
-            m_query += columnName + operatorIt->asSql() + "? ";
-            m_values.push_back(var);
+            term.range.first = std::min(term.range.first, valRange.first);
+            term.range.second = std::max(term.range.second, valRange.second);
         }
 
         ++valueIt;
         ++operatorIt;
     }
 
-    m_query += " ) ";
+    term.sql += " ) ";
+    appendTerm(term, columnName);
+}
+
+/// Keyset pagination: add the condition, that the tuple (column1, column2)
+/// is greater (or less) than (value1, value2) in lexicographical order.
+/// Written as range on column1 and a tie-breaker, so an index on column1
+/// can be used (row values are also not supported by older sqlite versions).
+void SqlQuery::addKeysetBound(const QString &column1, const QVariant &value1,
+                              const QString &column2, const QVariant &value2,
+                              bool greater)
+{
+    const char* op = (greater) ? ">" : "<";
+    Term term;
+    term.column = column1;
+    term.sql = " ( " + column1 + op + "=? and (" + column1 + op + "? or " +
+               column2 + op + "?) ) ";
+    term.values << db_conversions::toDbValue(value1) << db_conversions::toDbValue(value1)
+                << db_conversions::toDbValue(value2);
+    // the tie-breaker on column2 makes it inexact
+    numericRangeOf(db_conversions::toDbValue(value1),
+                   (greater) ? E_CompareOperator::GE : E_CompareOperator::LE, term.range);
+    appendTerm(term, column1);
+    addToTableCols(column2);
+}
+
+
+
+void SqlQuery::appendTerm(Term &term, const QString &columnName)
+{
+    if(! m_query.isEmpty()){
+        m_query += " and ";
+    }
+    m_query += term.sql;
+    m_values += term.values;
+    const int dotIdx = columnName.indexOf('.');
+    if(dotIdx != -1){
+        term.tablename = columnName.left(dotIdx);
+    }
+    m_terms.push_back(term);
     addToTableCols(columnName);
 }
 
+/// @return the sql for 'columnName op value' and append the values to bind
+/// to values. If a value isNull, insert "is null" instead of a placeholder.
+/// Also used to apply the comparisons of a Term to another column
+/// (see db_controller).
+/// @throws QExcIllegalArgument
+QString SqlQuery::mkComparisonSql(const QString &columnName, const Comparison &cmp,
+                                  QVariantList &values)
+{
+    if(cmp.value.isNull()){
+        // null values are only allowed for certain operators:
+        switch (cmp.op.asEnum()) {
+        case E_CompareOperator::EQ:
+        case E_CompareOperator::LIKE:
+            return columnName + " is null ";
+        case E_CompareOperator::NE:
+            return columnName + " is not null ";
+        default:
+            throw QExcIllegalArgument("null is illegal for operator " +
+                                      cmp.op.asTerminal() + " in column " +
+                                      columnName
+                                      );
+        }
+    }
+    if(cmp.op.asEnum() == E_CompareOperator::SUBTREE){
+        return mkSubtreeRangeSql(columnName, cmp.value.toString(), values);
+    }
+    values.push_back(cmp.value);
+    return columnName + cmp.op.asSql() + "? ";
+}
 
+/// The directory 'dir' and all directories below it: all paths starting
+/// with 'dir/' lie within ['dir/', 'dir0'), as '0' follows '/' in ASCII.
+/// Unlike LIKE (case insensitive) such a range can be served by an index.
+QString SqlQuery::mkSubtreeRangeSql(const QString &columnName, QString dir,
+                                    QVariantList &values)
+{
+    while(dir.size() > 1 && dir.endsWith('/')){
+        dir.chop(1);
+    }
+    const QString lower = (dir == "/") ? dir : dir + '/';
+    QString upper = lower;
+    upper[upper.size() - 1] = QChar('/' + 1);
+    values << dir << lower << upper;
+    return "( " + columnName + "=? or (" + columnName + ">=? and " +
+            columnName + "<?) ) ";
+}
 
 /// If the number of operators does not match the number of values, duplicate them, so they
 /// do (in that case len(operators) *must* be 1).
@@ -185,6 +326,7 @@ void SqlQuery::setQuery(const QString &query)
         throw QExcProgramming("setting query while values not empty");
     }
     m_query = query;
+    m_terms.clear();
 }
 
 /// @return true, if the *exact* columnname was added via 'addWithAnd'
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <type_traits>
+#include <limits>
 #include <QVector>
 #include <QVariant>
+#include <QPair>
 #include <unordered_set>
 
 #include "compareoperator.h"
@@ -17,6 +19,30 @@ class SqlQuery
 public:
     static const int NO_LIMIT {-1};
 
+    typedef QPair<qint64, qint64> NumericRange;
+
+    /// A single comparison 'column operator value'
+    struct Comparison {
+        CompareOperator op;
+        QVariant value;
+    };
+
+    /// A single (parenthesized) condition as added by addWithAnd.
+    struct Term {
+        QString tablename; // empty, if the column was passed without table
+        QString column;
+        QString sql;
+        QVariantList values;
+        // the comparisons sql consists of, connected by junction. Empty
+        // for a keyset bound.
+        QVector<Comparison> comparisons;
+        QString junction;
+        // inclusive bounds on integer columns implied by this term
+        NumericRange range {std::numeric_limits<qint64>::min(),
+                            std::numeric_limits<qint64>::max()};
+        bool rangeIsExact {false}; // term is equivalent to the range
+    };
+
     void addWithAnd(const QString& columnName, const QVariant& value,
                     const CompareOperator& operator_=CompareOperator());
 
@@ -26,11 +52,20 @@ public:
     void addWithAnd(const QString& columnName, const QVariantList& values,
                     const QVector<CompareOperator>& operators, bool innerAND=false);
 
+    static QString mkComparisonSql(const QString& columnName, const Comparison& cmp,
+                                   QVariantList& values);
+
+    void addKeysetBound(const QString& column1, const QVariant& value1,
+                        const QString& column2, const QVariant& value2,
+                        bool greater);
+
     const QString& query() const;
     QString& query();
 
 
     const QVariantList& values() const;
+    const QVector<Term>& terms() const;
+    NumericRange numericRange(const QString& columnName, bool* isExact=nullptr) const;
 
     void clear();
 
@@ -55,9 +90,13 @@ private:
     QVector<CompareOperator> expandOperatorsIfNeeded(
             const QVector<CompareOperator> &operators, int nValues) const;
     void addToTableCols(const QString& tableCol);
+    static QString mkSubtreeRangeSql(const QString& columnName, QString dir,
+                                     QVariantList& values);
+    void appendTerm(Term& term, const QString& columnName);
 
     QString m_query;
     QVariantList m_values;
+    QVector<Term> m_terms;
     std::unordered_set<QString> m_columnSet;
     std::unordered_set<QString> m_tablenames;
     bool m_ascending {true};
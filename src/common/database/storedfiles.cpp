@@ -1,4 +1,5 @@
 #include <cassert>
+#include <QCryptographicHash>
 
 #include "storedfiles.h"
 #include "db_connection.h"
@@ -6,73 +7,100 @@
 #include "qfilethrow.h"
 #include "os.h"
 
+
 const QString& StoredFiles::getReadFilesDir()
 {
     static const QString path = db_connection::getDatabaseDir() + "/readFiles";
     return path ;
 }
 
-/// creates path of stored files if not exist
-/// @return the created path
-/// @throws QExcIo
-const QString& StoredFiles::mkpath()
-{
-    const auto & p = getReadFilesDir();
-    if( ! QDir(p).mkpath(p)){
-        throw QExcIo(qtr("Failed to the create directory for the stored read files at %1")
-                             .arg(p));
-    }
-    return p;
-}
-
+/// The read files dir is only read and cleaned up (it is removed
+/// once migrated, see db_connection), so it is not created.
 StoredFiles::StoredFiles()
 {
-    const auto & path = getReadFilesDir();
-    m_readFilesDir.setPath(path);
-    this->mkpath();
+    m_readFilesDir.setPath(getReadFilesDir());
 }
 
-QString StoredFiles::mkPathStringToStoredReadFile(const FileReadInfo &info)
+/// @return the content address of data as used in readFile.blobHash
+QString StoredFiles::mkBlobHash(const QByteArray &data)
 {
-    return mkPathStringToStoredReadFile(info.idInDb);
+    return QString::fromLatin1(
+                QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
 }
 
-QString StoredFiles::mkPathStringToStoredReadFile(qint64 idInDb)
+/// @return the (uncompressed) content of the stored read file
+/// @throws QExcIo, QExcDatabase
+QByteArray StoredFiles::readContent(const FileReadInfo &info)
 {
-    return StoredFiles::getReadFilesDir() + QDir::separator() + QString::number(idInDb);
+    if(info.blobHash.isEmpty()){
+        QFileThrow f(m_readFilesDir.absoluteFilePath(QString::number(info.idInDb)));
+        f.open(QFile::OpenModeFlag::ReadOnly);
+        return f.readAll();
+    }
+    auto& q = query();
+    q->prepare("select compressed,data from blobs.blob where hash=?");
+    q->addBindValue(info.blobHash);
+    q->exec();
+    if(! q->next()){
+        throw QExcIo(qtr("The stored content of read file %1 (id %2) is missing")
+                     .arg(info.name).arg(info.idInDb));
+    }
+    const bool compressed = q->value(0).toBool();
+    const QByteArray data = q->value(1).toByteArray();
+    // do not keep the read lock on the store
+    q->finish();
+    if(! compressed){
+        return data;
+    }
+    const QByteArray content = qUncompress(data);
+    if(content.isEmpty() && info.size != 0){
+        throw QExcIo(qtr("The stored content of read file %1 (id %2) is corrupt")
+                     .arg(info.name).arg(info.idInDb));
+    }
+    return content;
 }
 
+/// Delete a read file stored by older versions
 bool StoredFiles::deleteReadFile(const QString &fname)
 {
     return m_readFilesDir.remove(fname);
 }
 
-/// @throws QExcIo
-void StoredFiles::addReadFile(const QString &fname, const QByteArray &data)
+/// Store data under blobHash, unless a blob with that hash exists.
+/// Blobs without readFile referencing them are deleted in
+/// db_controller::deleteCommand.
+/// @throws QExcDatabase
+void StoredFiles::addBlob(const QString &blobHash, const QByteArray &data)
 {
-    const QString fPath = m_readFilesDir.absoluteFilePath(fname);
-    QFileThrow f(fPath);
-    try {
-        f.open(QFile::OpenModeFlag::WriteOnly | QFile::OpenModeFlag::Truncate);
-        f.write(data);
-    } catch (const QExcIo&) {
-        f.remove();
-        throw ;
+    auto& q = query();
+    q->prepare("select 1 from blobs.blob where hash=?");
+    q->addBindValue(blobHash);
+    q->exec();
+    const bool exists = q->next();
+    q->finish();
+    if(exists){
+        return;
     }
+    const QByteArray compressed = qCompress(data);
+    const bool useCompressed = compressed.size() < data.size();
+    q->prepare("insert into blobs.blob (hash,compressed,data) values (?,?,?)");
+    q->addBindValue(blobHash);
+    q->addBindValue(useCompressed);
+    q->addBindValue((useCompressed) ? compressed : data);
+    q->exec();
 }
 
 
 /// @param info: the read file already loaded from the database
 /// @param dir: the directory where to restore it (warning: override without confirmation)
-/// @param openReadFileInDb: the for reading opened file corresponding to the info-database-entry.
+/// @param content: the content of the stored read file (see readContent)
 void StoredFiles::restoreReadFileAtDIr(const FileReadInfo &info, const QDir& dir,
-                                             const QFile &openReadFileInDb)
+                                       const QByteArray &content)
 {
-    assert(openReadFileInDb.isOpen());
     const QString filePath = dir.absoluteFilePath(info.name);
     QFileThrow dstFile(filePath);
     dstFile.open(QFile::OpenModeFlag::WriteOnly);
-    os::sendfile(dstFile.handle(), openReadFileInDb.handle(), static_cast<size_t>(info.size));
+    dstFile.write(content);
     os::fchmod(dstFile.handle(), info.mode);
 }
 
@@ -80,7 +108,15 @@ void StoredFiles::restoreReadFileAtDIr(const FileReadInfo &info, const QDir& dir
 /// @overload
 void StoredFiles::restoreReadFileAtDIr(const FileReadInfo &info, const QDir &dir)
 {
-    QFileThrow f(m_readFilesDir.absoluteFilePath(QString::number(info.idInDb)));
-    f.open(QFile::OpenModeFlag::ReadOnly);
-    restoreReadFileAtDIr(info, dir, f);
+    restoreReadFileAtDIr(info, dir, readContent(info));
+}
+
+/// Blobs are accessed lazily, e.g. printers only need them, if a
+/// read file is actually printed.
+QueryPtr &StoredFiles::query()
+{
+    if(m_query == nullptr){
+        m_query = db_connection::mkQuery();
+    }
+    return m_query;
 }
@@ -3,31 +3,39 @@
 #include <QDir>
 
 #include "fileinfos.h"
-
+#include "db_connection.h"
+
+/// Read files (scripts) stored to disk. Their content is addressed by its
+/// sha256 (readFile.blobHash), so identical content (e.g. after a touch or
+/// when read on another host) is only stored once, compressed, if that
+/// saves space. The blobs live in the database file readFiles.db (attached
+/// as 'blobs', see db_connection), which is read via mmap. Files stored by
+/// older versions reside in the read files dir, named by their readFile id.
 class StoredFiles
 {
 public:
 
     static const QString &getReadFilesDir();
 
-    static const QString &mkpath();
+    static QString mkBlobHash(const QByteArray& data);
 
     StoredFiles();
 
-    QString mkPathStringToStoredReadFile(const FileReadInfo& info);
-    QString mkPathStringToStoredReadFile(qint64 idInDb);
+    QByteArray readContent(const FileReadInfo& info);
 
     bool deleteReadFile(const QString& fname);
 
-    void addReadFile(const QString& fname, const QByteArray& data);
+    void addBlob(const QString& blobHash, const QByteArray& data);
 
     void restoreReadFileAtDIr(const FileReadInfo &info, const QDir& dir,
-                                const QFile &openReadFileInDb);
+                                const QByteArray &content);
 
     void restoreReadFileAtDIr(const FileReadInfo &info, const QDir& dir);
 
 private:
+    QueryPtr& query();
+
     QDir m_readFilesDir;
+    QueryPtr m_query;
 
 };
-
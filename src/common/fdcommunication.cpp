@@ -148,7 +148,8 @@ void SocketCommunication::sendMessages(const SocketCommunication::Messages &mess
         int *fdptr = reinterpret_cast<int*>(CMSG_DATA(cmsg) );
         memcpy(fdptr, fds.data(), fds.size() * sizeof(int));
     }
-    os::sendmsg(m_sockFd, &messageHeader);
+    // a closed endpoint shall not kill us (e.g. the observed shell) by SIGPIPE
+    os::sendmsg(m_sockFd, &messageHeader, MSG_NOSIGNAL);
 }
 
 int SocketCommunication::sockFd() const
@@ -17,6 +17,7 @@
 #include "os.h"
 #include "qfddummydevice.h"
 #include "qoutstream.h"
+#include "database/db_connection.h"
 
 
 
@@ -24,7 +25,7 @@
 FileEventHandler::FileEventHandler() :
     m_uid(os::getuid()),
     m_ourProcFdDirDescriptor(os::open("/proc/self/fd", O_DIRECTORY)),
-    m_sizeOfCachedReadFiles(0)
+    m_scriptStaging(db_connection::getDatabaseDir())
 {
     this->fillAllowedGroups();
     m_writeEvents.reserve(1000);
@@ -116,9 +117,9 @@ bool FileEventHandler::mimeTypeMatches(int fd, const Settings::MimeSet &validMim
 
 
 
-int FileEventHandler::sizeOfCachedReadFiles() const
+off64_t FileEventHandler::sizeOfCachedReadFiles() const
 {
-    return m_sizeOfCachedReadFiles;
+    return m_scriptStaging.size();
 }
 
 const FileReadEventHash &FileEventHandler::readEvents() const
@@ -126,6 +127,26 @@ const FileReadEventHash &FileEventHandler::readEvents() const
     return m_readEvents;
 }
 
+/// The collected read files (scripts) referenced by the read events
+const ScriptStaging &FileEventHandler::scriptStaging() const
+{
+    return m_scriptStaging;
+}
+
+/// The processes which caused the collected events, see the pid of
+/// FileWriteEvent and FileReadEvent.
+const ProcessInfos &FileEventHandler::processes() const
+{
+    return m_processCache.processes();
+}
+
+/// If true, the events should be flushed, so the memory of the
+/// process cache stays bounded.
+bool FileEventHandler::processCacheIsFull() const
+{
+    return m_processCache.isFull();
+}
+
 int FileEventHandler::countOfCollectedReadFiles() const
 {
     return m_readEvents.size();
@@ -143,7 +164,8 @@ void FileEventHandler::clearEvents()
 {
     m_writeEvents.clear();
     m_readEvents.clear();
-    m_sizeOfCachedReadFiles = 0;
+    m_scriptStaging.clear();
+    m_processCache.clear();
 }
 
 
@@ -152,9 +174,10 @@ const FileWriteEventHash &FileEventHandler::writeEvents() const
     return m_writeEvents;
 }
 
-/// @param enableReadActions: if false, do not read from fd, regardless of settings
+/// @param pid: of the process which closed fd (see fanotify_event_metadata),
+/// 0 if unknown. The process is looked up in /proc, if not cached yet.
 /// @throws ExcOs, CXXHashError
-void FileEventHandler::handleCloseWrite(int fd)
+void FileEventHandler::handleCloseWrite(int fd, pid_t pid)
 {
     // first lookup the path, then stat, so no filename contains a trailing '(deleted)'
     const auto filepath = readLinkOfFd(fd);
@@ -196,6 +219,10 @@ void FileEventHandler::handleCloseWrite(int fd)
     writeEvent.fullPath = filepath;
     writeEvent.mtime = st.st_mtime;
     writeEvent.size = st.st_size;
+    writeEvent.pid = pid;
+    if(pid != 0){
+        writeEvent.pidStartTime = m_processCache.lookup(pid).startTime;
+    }
 
     if(sets.hashSettings().hashEnable){
         writeEvent.hash =  m_hashControl.genPartlyHash(fd, st.st_size,
@@ -204,11 +231,6 @@ void FileEventHandler::handleCloseWrite(int fd)
 
     logDebug << "closedwrite-event recorded: "
              << writeEvent.fullPath;
-
-    // maybe_todo: reimplement that, if desired (?).
-    // if(m_pArgparse->getCommandline()){
-    //     info.cmdline = pidcontrol::findCmdlineOfPID(pid); // PID from fanotify event data...
-    // }
 }
 
 bool FileEventHandler::generalReadSettingsSayLogIt(const bool userHasWritePerm,
@@ -305,8 +327,8 @@ bool FileEventHandler::pathIsHidden(const std::string &fullPath)
 }
 
 
-/// @param enableReadActions: if false, do not read from fd, regardless of settings
-void FileEventHandler::handleCloseRead(int fd)
+/// @param pid: see handleCloseWrite
+void FileEventHandler::handleCloseRead(int fd, pid_t pid)
 {
     // first lookup the path, then stat, so no filename contains a trailing '(deleted)'
     const auto fpath = readLinkOfFd(fd);
@@ -339,23 +361,39 @@ void FileEventHandler::handleCloseRead(int fd)
     readEvent.mtime = st.st_mtime;
     readEvent.size = st.st_size;
     readEvent.mode = st.st_mode;
+    readEvent.pid = pid;
+    if(pid != 0){
+        readEvent.pidStartTime = m_processCache.lookup(pid).startTime;
+    }
 
     assert(os::ltell(fd) == 0);
     auto & sets = Settings::instance();
-    if(sets.hashSettings().hashEnable){
-        readEvent.hash =  m_hashControl.genPartlyHash(fd, st.st_size,
-                                                       sets.hashSettings().hashMeta);
+    if(! logScriptEvent){
+        // should happen seldom: inode was reused, so override the script just in case
+        readEvent.stagedOffset = -1;
+        readEvent.stagedSize = 0;
+        if(sets.hashSettings().hashEnable){
+            readEvent.hash =  m_hashControl.genPartlyHash(fd, st.st_size,
+                                                           sets.hashSettings().hashMeta);
+        }
+        return;
     }
-    if(logScriptEvent){
-        assert(os::ltell(fd) == 0);
-        readEvent.bytes = osutil::readWholeFile(fd, static_cast<int>(st.st_size) + 1024);
-        // maybe_todo: To be really correct one would also need to check again,
-        // if bytes.size > readCfg.maxFileSize. In practice this should not be too relevant...
-        os::lseek(fd, 0, SEEK_SET);
-        m_sizeOfCachedReadFiles += readEvent.bytes.size();
-    } else {
-        // should happen seldom: inode was reused, so override bytes just in case
-        readEvent.bytes = {};
+    // Copy the script within the kernel (at most the size checked against
+    // maxFileSize) and hash the staged copy, so the hash matches the stored
+    // bytes, even if the file is modified meanwhile. The staged copy is
+    // the last one, so its EOF is that of the script. A script read again
+    // unmodified since the last flush is not copied another time - its
+    // read event (same device and inode) then already holds the hash.
+    const auto staged = m_scriptStaging.stage(fd, st, st.st_size);
+    readEvent.stagedOffset = staged.offset;
+    readEvent.stagedSize = staged.size;
+    readEvent.size = readEvent.stagedSize;
+    if(sets.hashSettings().hashEnable && ! staged.reused){
+        const int stagingFd = m_scriptStaging.fd();
+        os::lseek(stagingFd, readEvent.stagedOffset, SEEK_SET);
+        readEvent.hash =  m_hashControl.genPartlyHash(stagingFd, readEvent.stagedSize,
+                                                       sets.hashSettings().hashMeta,
+                                                       false, readEvent.stagedOffset);
     }
 }
 
@@ -11,6 +11,8 @@
 #include "nullable_value.h"
 #include "fileeventtypes.h"
 #include "settings.h"
+#include "scriptstaging.h"
+#include "processcache.h"
 #include "os.h"
 
 /// Collect all desired file-event (read/write) information based on a file-descriptor.
@@ -27,11 +29,14 @@ public:
     FileEventHandler();
     ~FileEventHandler();
 
-    void handleCloseWrite(int fd);
-    void handleCloseRead(int fd);
+    void handleCloseWrite(int fd, pid_t pid=0);
+    void handleCloseRead(int fd, pid_t pid=0);
 
     const FileWriteEventHash &writeEvents() const;
     const FileReadEventHash& readEvents() const;
+    const ScriptStaging& scriptStaging() const;
+    const ProcessInfos& processes() const;
+    bool processCacheIsFull() const;
 
     std::string readLinkOfFd(int fd);
 
@@ -39,7 +44,7 @@ public:
 
     int countOfCollectedReadFiles() const;
 
-    int sizeOfCachedReadFiles() const;
+    off64_t sizeOfCachedReadFiles() const;
 
 public:
     Q_DISABLE_COPY(FileEventHandler)
@@ -70,7 +75,8 @@ private:
     std::unordered_set<gid_t> m_groups;
     uid_t m_uid; // cached real uid
     int m_ourProcFdDirDescriptor; // holds open fd nb for /proc/self/fd
-    int m_sizeOfCachedReadFiles;
+    ScriptStaging m_scriptStaging;
+    ProcessCache m_processCache;
     QMimeDatabase m_mimedb;
 };
 
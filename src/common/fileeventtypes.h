@@ -9,6 +9,8 @@ struct FileWriteEvent{
     off_t  size;
     std::string fullPath;
     HashValue hash;
+    pid_t pid {0}; // of the process which closed the file, 0 if unknown
+    quint64 pidStartTime {0}; // see ProcessInfo::startTime
 };
 
 struct FileReadEvent{
@@ -16,8 +18,13 @@ struct FileReadEvent{
     off_t size;
     std::string fullPath;
     mode_t mode;
-    QByteArray bytes; // the script file itself
+    // the script file itself is at [stagedOffset, stagedOffset + stagedSize) of
+    // the ScriptStaging. stagedOffset is -1, if it was not collected.
+    off64_t stagedOffset {-1};
+    off64_t stagedSize {0};
     HashValue hash;
+    pid_t pid {0};
+    quint64 pidStartTime {0};
 };
 
 
@@ -6,21 +6,23 @@
 
 /// xxhash parts of a file (or the whole file in case of a small one) according to the
 /// specified hashmeta-parameters.
+/// @param startOffset: the offset of the data within fd, where the seed must be.
 /// @return hash-value of null, if 0 bytes were read.
 /// @throws ExcOs, CXXHashError
 HashValue HashControl::genPartlyHash(int fd, qint64 filesize, const HashMeta &hashMeta,
-                                     bool resetOffset)
+                                     bool resetOffset, off64_t startOffset)
 {
     const off64_t seektstep = filesize / hashMeta.maxCountOfReads;
     CXXHash::DigestResult hashRes = m_hash.digestFile(
                         fd,
                         hashMeta.chunkSize,
                         seektstep ,
-                        hashMeta.maxCountOfReads);
+                        hashMeta.maxCountOfReads,
+                        startOffset);
     HashValue hashVal;
     if(hashRes.countOfbytes > 0){
         if(resetOffset){
-            os::lseek(fd, 0, SEEK_SET);
+            os::lseek(fd, startOffset, SEEK_SET);
         }
         hashVal = hashRes.hash;
     }
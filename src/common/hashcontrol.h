@@ -9,7 +9,7 @@ class HashControl
 public:
 
     HashValue genPartlyHash(int fd, qint64 filesize, const HashMeta& hashMeta,
-                            bool resetOffset=true);
+                            bool resetOffset=true, off64_t startOffset=0);
 
 private:
     CXXHash m_hash;
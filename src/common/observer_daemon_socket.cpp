@@ -0,0 +1,133 @@
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <QCoreApplication>
+
+#include "observer_daemon_socket.h"
+#include "excos.h"
+#include "os.h"
+#include "logger.h"
+
+namespace  {
+
+/// @return false (with errno set), if the directory does not exist or
+/// others might have write access to it.
+bool dirIsTrusted(const QByteArray& dir){
+    struct stat st;
+    if(lstat(dir.constData(), &st) == -1){
+        return false;
+    }
+    if(! S_ISDIR(st.st_mode) || st.st_uid != getuid() ||
+            (st.st_mode & (S_IRWXG | S_IRWXO)) != 0){
+        errno = EPERM;
+        return false;
+    }
+    return true;
+}
+
+/// @return false, if the path does not fit into sockaddr_un
+bool fillAddress(const QByteArray& path, struct sockaddr_un& addr){
+    memset(&addr, 0, sizeof (addr));
+    addr.sun_family = AF_UNIX;
+    if(size_t(path.size()) >= sizeof (addr.sun_path)){
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memcpy(addr.sun_path, path.constData(), size_t(path.size()));
+    return true;
+}
+
+} // namespace
+
+
+QString observer_daemon_socket::dirPath()
+{
+    QString base = QString::fromLocal8Bit(qgetenv("XDG_RUNTIME_DIR"));
+    if(base.isEmpty()){
+        base = "/tmp";
+    }
+    // the application name differs in integration test mode
+    return base + "/" + QCoreApplication::applicationName() + "-" +
+            QString::number(getuid());
+}
+
+QString observer_daemon_socket::path()
+{
+    return dirPath() + "/observer-daemon.sock";
+}
+
+/// Connect to a running daemon.
+/// @return the connected socket or -1 (with errno set), e.g. if no daemon
+/// is running.
+int observer_daemon_socket::connect()
+{
+    const QByteArray sockPath = path().toLocal8Bit();
+    struct sockaddr_un addr;
+    if(! dirIsTrusted(dirPath().toLocal8Bit()) || ! fillAddress(sockPath, addr)){
+        return -1;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1){
+        return -1;
+    }
+    if(::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof (addr)) == -1){
+        const int err = errno;
+        ::close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+/// Create the listening socket of the daemon, meant to be called as real user.
+/// Only one daemon may listen at a time, which is ensured by a lock file.
+/// @param lockFd: the locked file, which must be kept open while listening.
+/// @return the listening socket or -1, if another daemon holds the lock.
+/// @throws ExcOs
+int observer_daemon_socket::listen(int* lockFd)
+{
+    const QByteArray dir = dirPath().toLocal8Bit();
+    if(mkdir(dir.constData(), 0700) == -1 && errno != EEXIST){
+        throw os::ExcOs("Failed to create " + dir.toStdString());
+    }
+    if(! dirIsTrusted(dir)){
+        throw os::ExcOs("Refusing to use " + dir.toStdString() +
+                        ": it must be a directory only accessible by its owner");
+    }
+    *lockFd = os::open(dir + "/observer-daemon.lock", O_RDWR | O_CREAT, true, 0600);
+    if(flock(*lockFd, LOCK_EX | LOCK_NB) == -1){
+        const int err = errno;
+        os::close(*lockFd);
+        *lockFd = -1;
+        if(err == EWOULDBLOCK){
+            return -1;
+        }
+        throw os::ExcOs("flock failed", err);
+    }
+    // holding the lock, a remaining socket file is stale
+    const QByteArray sockPath = path().toLocal8Bit();
+    unlink(sockPath.constData());
+    struct sockaddr_un addr;
+    if(! fillAddress(sockPath, addr)){
+        throw os::ExcOs("Invalid socket path " + sockPath.toStdString());
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if(fd == -1){
+        throw os::ExcOs("socket failed");
+    }
+    if(::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof (addr)) == -1 ||
+            ::listen(fd, SOMAXCONN) == -1){
+        const os::ExcOs exc("Failed to listen at " + sockPath.toStdString());
+        ::close(fd);
+        throw exc;
+    }
+    logDebug << "observer daemon listening at" << sockPath;
+    return fd;
+}
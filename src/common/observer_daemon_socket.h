@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QString>
+
+/// Address of the observer daemon (see shournal-run --daemon), which
+/// observes the shell sessions of a user within a single process.
+/// The unix socket is located within a directory only accessible by the
+/// user, below $XDG_RUNTIME_DIR or /tmp. Both sides refuse to use that
+/// directory, if it is owned by someone else.
+namespace observer_daemon_socket {
+
+QString dirPath();
+QString path();
+
+int connect();
+int listen(int* lockFd);
+
+}
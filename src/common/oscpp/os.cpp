@@ -167,6 +167,22 @@ ssize_t os::read(int fd, void *buf, size_t nbytes, bool retryOnInterrupt)
     }
 }
 
+/// Read at offset without changing the file offset. Is restarted on EINTR.
+/// @throws ExcOs
+ssize_t os::pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+    while (true) {
+        auto read = ::pread(fd, buf, nbytes, offset);
+        if(read == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            throw ExcOs("pread failed");
+        }
+        return read;
+    }
+}
+
 
 
 /// @param throwIfLessBytesWritten: if true, throw if the number of written bytes
@@ -665,6 +681,14 @@ void os::fchmod(int fd, mode_t mode)
     }
 }
 
+/// @throws ExcOs
+void os::ftruncate(int fd, off_t length)
+{
+    if(::ftruncate(fd, length) == -1){
+        throw ExcOs("ftruncate failed for fd " + std::to_string(fd));
+    }
+}
+
 void os::sigaction(int signum, const struct sigaction *act,
                    struct sigaction *oldact)
 {
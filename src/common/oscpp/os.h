@@ -64,6 +64,7 @@ bool exists(const std::string& name);
 
 void fchdir(int fd);
 void fchmod(int fd, mode_t mode);
+void ftruncate(int fd, off_t length);
 
 int getFdStatusFlags(int fd);
 int getFdDescriptorFlags(int fd);
@@ -141,6 +142,7 @@ Str_t readlinkat (int dirfd, const Str_t & filename);
 
 
 ssize_t read (int fd, void *buf, size_t nbytes, bool retryOnInterrupt=false);
+ssize_t pread (int fd, void *buf, size_t nbytes, off_t offset);
 
 template <class Str_t>
 Str_t readStr(int fd, size_t nbytes, bool retryOnInterrupt=false);
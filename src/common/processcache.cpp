@@ -0,0 +1,140 @@
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "processcache.h"
+#include "logger.h"
+
+namespace  {
+
+/// @return the count of read bytes or -1 on error
+ssize_t readAt(int dirFd, const char* filename, char* buf, size_t bufSize){
+    const int fd = ::openat(dirFd, filename, O_RDONLY | O_CLOEXEC);
+    if(fd == -1){
+        return -1;
+    }
+    size_t total = 0;
+    while(total < bufSize){
+        const ssize_t ret = ::read(fd, buf + total, bufSize - total);
+        if(ret == -1 && errno == EINTR){
+            continue;
+        }
+        if(ret <= 0){
+            break;
+        }
+        total += size_t(ret);
+    }
+    ::close(fd);
+    return ssize_t(total);
+}
+
+} // namespace
+
+
+ProcessCache::ProcessCache(int maxCount) :
+    m_maxCount(maxCount)
+{}
+
+/// @return the cached process or, if not cached yet (or its pid was
+/// reused meanwhile), the one read from /proc.
+/// If the process does not exist anymore, only its pid is known.
+const ProcessInfo &ProcessCache::lookup(pid_t pid)
+{
+    ProcessInfo p;
+    p.pid = pid;
+    std::string comm;
+    const std::string procPath = "/proc/" + std::to_string(pid);
+    const int dirFd = ::open(procPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(dirFd == -1){
+        logDebug << "process" << pid << "not found in /proc:" << strerror(errno);
+    } else if(! readStat(dirFd, p, comm)){
+        logDebug << "failed to read the stat of process" << pid;
+    }
+    const ProcessKey key(pid, p.startTime);
+    auto it = m_processes.find(key);
+    if(it == m_processes.end()){
+        if(dirFd != -1){
+            readProc(dirFd, p, comm);
+        }
+        it = m_processes.insert(key, p);
+    }
+    if(dirFd != -1){
+        ::close(dirFd);
+    }
+    return it.value();
+}
+
+const ProcessInfos &ProcessCache::processes() const
+{
+    return m_processes;
+}
+
+bool ProcessCache::isFull() const
+{
+    return m_processes.size() >= m_maxCount;
+}
+
+void ProcessCache::clear()
+{
+    m_processes.clear();
+}
+
+/// Read name, parent and start time from /proc/$pid/stat.
+/// @return false, if the process has exited already.
+bool ProcessCache::readStat(int dirFd, ProcessInfo &p, std::string &comm)
+{
+    // stat: pid (comm) state ppid ... -- comm may contain ')' and spaces.
+    // The start time is field 22, the 20th after comm.
+    char statBuf[1024];
+    const ssize_t statLen = readAt(dirFd, "stat", statBuf, sizeof (statBuf) - 1);
+    if(statLen <= 0){
+        return false;
+    }
+    statBuf[statLen] = '\0';
+    const char* commBegin = strchr(statBuf, '(');
+    const char* commEnd = strrchr(statBuf, ')');
+    if(commBegin == nullptr || commEnd == nullptr || commEnd < commBegin){
+        return false;
+    }
+    comm.assign(commBegin + 1, commEnd);
+    char state;
+    int ppid;
+    unsigned long long startTime;
+    if(sscanf(commEnd + 1, " %c %d %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s %*s "
+                           "%*s %*s %*s %*s %*s %*s %llu",
+              &state, &ppid, &startTime) != 3){
+        return false;
+    }
+    p.parentPid = ppid;
+    p.startTime = startTime;
+    return true;
+}
+
+/// Read executable and arguments from /proc/$pid. Errors are
+/// not reported, the process may have exited already.
+/// @param comm: the name from its stat, used if the executable is gone.
+void ProcessCache::readProc(int dirFd, ProcessInfo &p, const std::string& comm)
+{
+    char exeBuf[PATH_MAX];
+    const ssize_t exeLen = ::readlinkat(dirFd, "exe", exeBuf, sizeof (exeBuf));
+    if(exeLen > 0){
+        p.exe.assign(exeBuf, size_t(exeLen));
+    } else {
+        // e.g. the process is exiting, which is when many files are closed
+        p.exe = comm;
+    }
+
+    // the arguments are separated (and terminated) by null bytes. Keep the
+    // separators, spaces may occur within arguments. Only drop the
+    // terminating one, the last argument might be empty.
+    p.argv.resize(MAX_ARGV_SIZE);
+    const ssize_t argvLen = readAt(dirFd, "cmdline", &p.argv[0], MAX_ARGV_SIZE);
+    p.argv.resize((argvLen > 0) ? size_t(argvLen) : 0);
+    if(! p.argv.empty() && p.argv.back() == '\0'){
+        p.argv.pop_back();
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <sys/types.h>
+#include <string>
+#include <QHash>
+#include <QPair>
+
+struct ProcessInfo {
+    pid_t pid {0};
+    // in clock ticks after system boot, tells a reused pid apart. 0, if
+    // the process did not exist anymore when looked up.
+    quint64 startTime {0};
+    pid_t parentPid {0};
+    // path of the executable or, if not available anymore (e.g. the
+    // process is exiting), its name (comm)
+    std::string exe;
+    // the arguments separated by null bytes (stored as JSON array)
+    std::string argv;
+};
+
+/// pid and start time of a process
+typedef QPair<pid_t, quint64> ProcessKey;
+typedef QHash<ProcessKey, ProcessInfo> ProcessInfos;
+
+/// Cache of the processes which caused file events, so the same process
+/// is looked up within /proc only once (besides reading its start time,
+/// which tells a reused pid apart). The cache is filled lazily and
+/// holds at most maxCount processes, so the caller should flush the
+/// collected events and clear it, once it isFull().
+/// Note that a process is cached as it was when first looked up, a later
+/// exec is not noticed.
+class ProcessCache
+{
+public:
+    explicit ProcessCache(int maxCount=4096);
+
+    const ProcessInfo& lookup(pid_t pid);
+
+    const ProcessInfos& processes() const;
+    bool isFull() const;
+    void clear();
+
+    static const size_t MAX_ARGV_SIZE = 4096;
+
+private:
+    bool readStat(int dirFd, ProcessInfo& p, std::string& comm);
+    void readProc(int dirFd, ProcessInfo& p, const std::string& comm);
+
+    ProcessInfos m_processes;
+    int m_maxCount;
+};
+
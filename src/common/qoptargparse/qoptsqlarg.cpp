@@ -42,7 +42,8 @@ const QOptSqlArg::CompareOperators &QOptSqlArg::cmpOpsAll()
         E_CompareOperator::EQ,
         E_CompareOperator::NE,
         E_CompareOperator::LIKE,
-        E_CompareOperator::BETWEEN
+        E_CompareOperator::BETWEEN,
+        E_CompareOperator::SUBTREE
     };
     return ops;
 }
@@ -71,6 +72,18 @@ const QOptSqlArg::CompareOperators &QOptSqlArg::cmpOpsText()
     return ops;
 }
 
+/// -subtree: the given directory and all directories below it
+const QOptSqlArg::CompareOperators &QOptSqlArg::cmpOpsPath()
+{
+    static const QOptSqlArg::CompareOperators ops = {
+        E_CompareOperator::EQ,
+        E_CompareOperator::NE,
+        E_CompareOperator::LIKE,
+        E_CompareOperator::SUBTREE
+    };
+    return ops;
+}
+
 const QOptSqlArg::CompareOperators &QOptSqlArg::cmpOpsEqNe()
 {
     static const QOptSqlArg::CompareOperators ops = {
@@ -14,6 +14,7 @@ public:
     static const CompareOperators& cmpOpsAll();
     static const CompareOperators& cmpOpsAllButLike();
     static const CompareOperators& cmpOpsText();
+    static const CompareOperators& cmpOpsPath();
     static const CompareOperators& cmpOpsEqNe();
 
     QOptSqlArg(const QString& shortName, const QString & name,
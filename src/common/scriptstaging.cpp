@@ -0,0 +1,201 @@
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/memfd.h>
+#include <QDir>
+
+#include "scriptstaging.h"
+#include "os.h"
+#include "excos.h"
+#include "logger.h"
+#include "util.h"
+
+namespace  {
+
+/// Use the syscalls directly, glibc provides wrappers only since 2.27
+ssize_t copyFileRange(int fdIn, off64_t* offIn, int fdOut, off64_t* offOut, size_t len){
+#ifdef __NR_copy_file_range
+    return syscall(__NR_copy_file_range, fdIn, offIn, fdOut, offOut, len, 0U);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int memfdCreate(const char* name){
+#ifdef __NR_memfd_create
+    const auto fd = static_cast<int>(syscall(__NR_memfd_create, name, MFD_CLOEXEC));
+    if(fd == -1){
+        throw os::ExcOs("memfd_create failed");
+    }
+    return fd;
+#else
+    throw os::ExcOs("memfd_create is not supported", ENOSYS);
+#endif
+}
+
+} // namespace
+
+
+ScriptStaging::ScriptStaging(QString dir) :
+    m_dir(std::move(dir)),
+    m_fd(-1),
+    m_size(0),
+    m_copyFileRangeSupported(true)
+{}
+
+ScriptStaging::~ScriptStaging()
+{
+    if(m_fd != -1){
+        try {
+            os::close(m_fd);
+        } catch (const os::ExcOs& e) {
+            logCritical << __func__ << e.what();
+        }
+    }
+}
+
+/// Stage the content of fd (at most maxSize bytes) unless the same file
+/// (device, inode and mtime of st) was already staged since the last clear().
+/// @return the range of the staged content
+/// @throws ExcOs
+ScriptStaging::Range ScriptStaging::stage(int fd, const struct stat &st, off64_t maxSize)
+{
+    const FileKey key(qMakePair(st.st_dev, st.st_ino),
+                      qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+    auto it = m_stagedFiles.find(key);
+    if(it != m_stagedFiles.end()){
+        Range range = it.value();
+        range.reused = true;
+        return range;
+    }
+    Range range;
+    range.offset = m_size;
+    range.size = append(fd, maxSize);
+    m_stagedFiles.insert(key, range);
+    return range;
+}
+
+/// Append the content of fd (at most maxSize bytes, starting at offset 0).
+/// The file offset of fd is not changed.
+/// @return the count of appended bytes, which start at the size() before the call.
+/// @throws ExcOs
+off64_t ScriptStaging::append(int fd, off64_t maxSize)
+{
+    const int stagingFd = this->fd();
+    off64_t inOffset = 0;
+    off64_t outOffset = m_size;
+    while(inOffset < maxSize){
+        const auto len = static_cast<size_t>(maxSize - inOffset);
+        ssize_t copied = -1;
+        if(m_copyFileRangeSupported){
+            copied = copyFileRange(fd, &inOffset, stagingFd, &outOffset, len);
+            if(copied == -1 && errno == ENOSYS){
+                m_copyFileRangeSupported = false;
+            }
+        }
+        if(copied == -1 && (! m_copyFileRangeSupported || errno == EXDEV ||
+                            errno == EINVAL || errno == EOPNOTSUPP)){
+            // e.g. cross-filesystem copy before Linux 5.3
+            os::lseek(stagingFd, outOffset, SEEK_SET);
+            copied = ::sendfile(stagingFd, fd, &inOffset, len);
+            if(copied > 0){
+                outOffset += copied;
+            }
+        }
+        if(copied == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            const os::ExcOs exc("Failed to copy to the script staging file");
+            // do not keep a partial copy
+            os::ftruncate(stagingFd, m_size);
+            throw exc;
+        }
+        if(copied == 0){
+            // EOF, the file was truncated in the meantime
+            break;
+        }
+    }
+    const off64_t appended = outOffset - m_size;
+    m_size = outOffset;
+    return appended;
+}
+
+/// @overload
+/// @throws ExcOs
+off64_t ScriptStaging::append(const QByteArray &data)
+{
+    const int stagingFd = this->fd();
+    os::lseek(stagingFd, m_size, SEEK_SET);
+    os::write(stagingFd, data);
+    m_size += data.size();
+    return data.size();
+}
+
+/// @return the staged bytes at [offset, offset + size), which are
+/// not null, even if empty.
+/// @throws ExcOs
+QByteArray ScriptStaging::read(off64_t offset, off64_t size) const
+{
+    assert(offset + size <= m_size);
+    QByteArray buf(static_cast<int>(size), Qt::Uninitialized);
+    off64_t readTotal = 0;
+    while(readTotal < size){
+        const auto readCount = os::pread(m_fd, buf.data() + readTotal,
+                                         static_cast<size_t>(size - readTotal),
+                                         offset + readTotal);
+        if(readCount == 0){
+            break;
+        }
+        readTotal += readCount;
+    }
+    buf.resize(static_cast<int>(readTotal));
+    return buf;
+}
+
+/// Drop all staged content, the staging file is reused.
+/// @throws ExcOs
+void ScriptStaging::clear()
+{
+    if(m_fd != -1 && m_size > 0){
+        os::ftruncate(m_fd, 0);
+    }
+    m_size = 0;
+    m_stagedFiles.clear();
+}
+
+/// @return the file descriptor of the staging file, which is created
+/// if necessary.
+/// @throws ExcOs
+int ScriptStaging::fd()
+{
+    if(m_fd != -1){
+        return m_fd;
+    }
+    if(! m_dir.isEmpty() && QDir().mkpath(m_dir)){
+        m_fd = ::open(m_dir.toLocal8Bit().constData(), O_TMPFILE | O_RDWR | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR);
+        if(m_fd == -1){
+            logInfo << qtr("Failed to create a staging file for scripts in %1 (%2) - "
+                           "staging them in memory until the next flush instead.")
+                       .arg(m_dir, strerror(errno));
+        }
+    }
+    if(m_fd == -1){
+        // the staged content occupies RAM (or swap) then
+        m_fd = memfdCreate("shournal-scripts");
+    }
+    return m_fd;
+}
+
+/// @return the total size of the staged content
+off64_t ScriptStaging::size() const
+{
+    return m_size;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QString>
+
+/// Collected read files (scripts) are appended to a single, unlinked staging file
+/// until they are flushed to the database, so the memory of an observer does not
+/// grow with the count or size of the collected scripts.
+/// Content is copied within the kernel (copy_file_range, which may reflink,
+/// otherwise sendfile). The staging file is created lazily as O_TMPFILE within
+/// the given directory or as memfd, if that is not possible. Note that a memfd
+/// lives in RAM (or swap), so in that case the staged scripts do occupy memory
+/// until the next flush.
+/// A file, which is read several times before a flush, is staged only once, as
+/// long as device, inode and mtime are unchanged (see stage()).
+class ScriptStaging
+{
+public:
+    struct Range {
+        off64_t offset {-1};
+        off64_t size {0};
+        bool reused {false}; // staged before, so not at the end of the staging file
+    };
+
+    explicit ScriptStaging(QString dir=QString());
+    ~ScriptStaging();
+
+    Range stage(int fd, const struct stat& st, off64_t maxSize);
+    off64_t append(int fd, off64_t maxSize);
+    off64_t append(const QByteArray& data);
+
+    QByteArray read(off64_t offset, off64_t size) const;
+
+    void clear();
+
+    int fd();
+    off64_t size() const;
+
+public:
+    ScriptStaging(const ScriptStaging &) = delete ;
+    void operator=(const ScriptStaging &) = delete ;
+
+private:
+    // device, inode, mtime in nanoseconds
+    typedef QPair<QPair<dev_t, ino_t>, qint64> FileKey;
+
+    QString m_dir;
+    QHash<FileKey, Range> m_stagedFiles;
+    int m_fd;
+    off64_t m_size;
+    bool m_copyFileRangeSupported;
+};
+
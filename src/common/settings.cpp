@@ -1,5 +1,7 @@
 
 #include <cassert>
+#include <QDataStream>
+#include <QSaveFile>
 #include <QStandardPaths>
 #include <QVariant>
 #include <QDebug>
@@ -35,6 +37,11 @@ const char* Settings::SECT_SCRIPTS_ENABLE {"enable"};
 const char* Settings::SECT_SCRIPTS_INCLUDE_PATHS {"include_paths"};
 const char* Settings::SECT_SCRIPTS_INCLUDE_FILE_EXTENSIONS {"include_file_extensions"};
 
+const char* Settings::SECT_SHELL_NAME {"shell-integration"};
+const char* Settings::SECT_SHELL_SESSION_OBSERVER {"session_observer"};
+const char* Settings::SECT_SHELL_STANDBY_OBSERVER {"standby_observer"};
+const char* Settings::SECT_SHELL_OBSERVER_DAEMON {"observer_daemon"};
+
 
 Settings &Settings::instance()
 {
@@ -123,6 +130,8 @@ void Settings::addIgnoreCmd(QString cmd, bool warnIfNotFound, const QString & ig
         if(fullPath.isEmpty()){
             if(warnIfNotFound){
                 logWarning << ignoreCmdsErrPreamble << lineCopy << "> - not found:"  << cmd;
+                // it might be installed later
+                m_snapshotable = false;
             }
         } else {
             m_ignoreCmdsRegardlessOfArgs.insert(fullPath.toStdString());
@@ -132,6 +141,7 @@ void Settings::addIgnoreCmd(QString cmd, bool warnIfNotFound, const QString & ig
         if(cmd.isEmpty()){
             if(warnIfNotFound){
                 logWarning << ignoreCmdsErrPreamble << lineCopy << "> - not found." ;
+                m_snapshotable = false;
             }
         } else {
 
@@ -143,6 +153,71 @@ void Settings::addIgnoreCmd(QString cmd, bool warnIfNotFound, const QString & ig
 
 
 
+static const quint32 SNAPSHOT_MAGIC = 0x73686e53; // "shnS"
+// increase on any change of the serialized fields
+static const quint32 SNAPSHOT_FORMAT_VERSION = 2;
+static const QDataStream::Version SNAPSHOT_STREAM_VERSION = QDataStream::Qt_5_0;
+
+static void writeStringSet(QDataStream& s, const StringSet& strings){
+    s << quint32(strings.size());
+    for(const auto& str : strings){
+        s << QByteArray::fromRawData(str.data(), static_cast<int>(str.size()));
+    }
+}
+
+static void readStringSet(QDataStream& s, StringSet& strings){
+    quint32 count = 0;
+    s >> count;
+    strings.clear();
+    QByteArray str;
+    for(quint32 i=0; i < count && s.status() == QDataStream::Ok; i++){
+        s >> str;
+        strings.insert(str.toStdString());
+    }
+}
+
+static void writeMimeSet(QDataStream& s, const Settings::MimeSet& mimes){
+    s << quint32(mimes.size());
+    for(const auto& mime : mimes){
+        s << mime;
+    }
+}
+
+static void readMimeSet(QDataStream& s, Settings::MimeSet& mimes){
+    quint32 count = 0;
+    s >> count;
+    mimes.clear();
+    QString mime;
+    for(quint32 i=0; i < count && s.status() == QDataStream::Ok; i++){
+        s >> mime;
+        mimes.insert(mime);
+    }
+}
+
+static void writePathTree(QDataStream& s, const PathTree& tree){
+    quint32 count = 0;
+    for(auto it=tree.begin(); it != tree.end(); ++it){
+        ++count;
+    }
+    s << count;
+    for(auto it=tree.begin(); it != tree.end(); ++it){
+        const std::string& path = *it;
+        s << QByteArray::fromRawData(path.data(), static_cast<int>(path.size()));
+    }
+}
+
+static void readPathTree(QDataStream& s, PathTree& tree){
+    quint32 count = 0;
+    s >> count;
+    tree.clear();
+    QByteArray path;
+    for(quint32 i=0; i < count && s.status() == QDataStream::Ok; i++){
+        s >> path;
+        tree.insert(path.toStdString());
+    }
+}
+
+
 /// @param hiddenPaths: if not null, store hidden paths in the passed tree, instead
 /// of the returned one.
 PathTree
@@ -158,11 +233,13 @@ Settings::loadPaths(Section_Ptr& section,
     for(const auto& p : rawPaths){
         QString canonicalPath = p;
         if(canonicalPath.startsWith("$CWD")){
+            m_usesWorkingDir = true;
             if(m_workingDir.isEmpty()){
                 logWarning << qtr("section %1: %2: $CWD is set but the working-"
                                   "directory could not be determined. Maybe it does "
                                   "not exist?")
                               .arg(section->sectionName(), keyName);
+                m_snapshotable = false;
                 continue;
             }
             canonicalPath.replace("$CWD", m_workingDir);
@@ -177,6 +254,8 @@ Settings::loadPaths(Section_Ptr& section,
         if(canonicalPath.isEmpty()){
             logWarning << qtr("section %1: %2: path does not exist: %3")
                           .arg(section->sectionName(), keyName, p);
+            // it might be created later
+            m_snapshotable = false;
             continue;
         }
 
@@ -271,6 +350,8 @@ static void cleanExcludePaths(const PathTree& includePaths,
 }
 
 void Settings::loadSections(){
+    m_snapshotable = true;
+    m_usesWorkingDir = false;
     m_cfg.setInitialComments(qtr(
                                  "Configuration file for %1. Uncomment lines "
                                  "to change defaults. Multi-line-values (e.g. paths) "
@@ -295,6 +376,7 @@ void Settings::loadSections(){
     loadSectIgnoreCmd();
     loadSectMount();
     loadSectHash();
+    loadSectShellIntegration();
 }
 
 void Settings::loadSectWrite()
@@ -490,6 +572,37 @@ void Settings::loadSectHash()
                 sectHash->getValue<uint>(sect_hash_maxCountReads, 20, true));
 }
 
+void Settings::loadSectShellIntegration()
+{
+    auto sectShell = m_cfg[SECT_SHELL_NAME];
+
+    sectShell->setComments(qtr(
+                           "If %1 is true, a single observer process (%2) is kept "
+                           "for the whole shell session, instead of launching one per "
+                           "command, which considerably reduces the overhead per command. "
+                           "However, file events of processes which outlive their "
+                           "command (e.g. background jobs) are attributed to the "
+                           "command being executed at that time, if any. Further, file "
+                           "systems mounted after the start of the session are not "
+                           "observed. Changes of this config-file apply to new shell "
+                           "sessions or after "
+                           "SHOURNAL_DISABLE and SHOURNAL_ENABLE.\n"
+                           "Otherwise, if %3 is true, the observer for the next command "
+                           "is launched right after a command finished, so its setup "
+                           "happens while you are typing. This costs an idle process "
+                           "per shell session.\n"
+                           "If %4 is true as well, the session observers of all shell "
+                           "sessions of a user are hosted by a single daemon process "
+                           "(%2 --daemon), which is started on demand and saves memory "
+                           "if many shell sessions run concurrently. Changes of this "
+                           "config-file apply to the daemon only after it was restarted.")
+                           .arg(SECT_SHELL_SESSION_OBSERVER, app::SHOURNAL_RUN,
+                                SECT_SHELL_STANDBY_OBSERVER, SECT_SHELL_OBSERVER_DAEMON));
+    m_sessionObserver = sectShell->getValue<bool>(SECT_SHELL_SESSION_OBSERVER, false);
+    m_standbyObserver = sectShell->getValue<bool>(SECT_SHELL_STANDBY_OBSERVER, false);
+    m_observerDaemon = sectShell->getValue<bool>(SECT_SHELL_OBSERVER_DAEMON, false);
+}
+
 /// @return true if the config file existed and was successfully parsed
 bool Settings::parseCfgIfExists(const QString& cfgPath)
 {
@@ -587,6 +700,199 @@ void Settings::storeCfg(QFileThrow &cfgVersionFile)
     }
 }
 
+bool Settings::SnapshotKey::operator==(const Settings::SnapshotKey &rhs) const
+{
+    return cfgMtimeNs == rhs.cfgMtimeNs &&
+           cfgSize == rhs.cfgSize &&
+           cfgInode == rhs.cfgInode &&
+           appVersion == rhs.appVersion &&
+           uid == rhs.uid &&
+           envPath == rhs.envPath &&
+           userHome == rhs.userHome;
+}
+
+QString Settings::snapshotFilepath()
+{
+    // don't make path static -> mutliple test cases...
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + "/settings-snapshot";
+}
+
+/// @return false, if the config file does not exist
+bool Settings::snapshotKey(const QString &cfgPath, Settings::SnapshotKey &key)
+{
+    os::stat_t st;
+    try {
+        st = os::stat(cfgPath.toStdString());
+    } catch (const os::ExcOs&) {
+        return false;
+    }
+    key.cfgMtimeNs = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    key.cfgSize = st.st_size;
+    key.cfgInode = st.st_ino;
+    key.appVersion = app::version().toString();
+    key.uid = os::getuid();
+    key.envPath = qgetenv("PATH");
+    key.userHome = m_userHome;
+    return true;
+}
+
+/// Load the settings from the snapshot stored by a previous full load, if its
+/// key matches. Much faster than parsing the config file, e.g. for the
+/// shell-integration, which loads the settings before each command.
+/// @return false, if the snapshot is missing, stale or invalid. Our
+/// settings are unchanged in that case.
+bool Settings::loadSnapshot(const Settings::SnapshotKey &key)
+{
+    QFile f(snapshotFilepath());
+    if(! f.open(QFile::OpenModeFlag::ReadOnly)){
+        return false;
+    }
+    QByteArray data;
+    uchar* mapped = f.map(0, f.size());
+    if(mapped != nullptr){
+        data = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped),
+                                       static_cast<int>(f.size()));
+    } else {
+        data = f.readAll();
+    }
+    QDataStream s(data);
+    s.setVersion(SNAPSHOT_STREAM_VERSION);
+
+    quint32 magic = 0;
+    quint32 formatVersion = 0;
+    s >> magic >> formatVersion;
+    if(magic != SNAPSHOT_MAGIC || formatVersion != SNAPSHOT_FORMAT_VERSION){
+        return false;
+    }
+    SnapshotKey storedKey;
+    bool usesWorkingDir = false;
+    QString workingDir;
+    s >> storedKey.cfgMtimeNs >> storedKey.cfgSize >> storedKey.cfgInode
+      >> storedKey.appVersion >> storedKey.uid >> storedKey.envPath >> storedKey.userHome
+      >> usesWorkingDir >> workingDir;
+    if(s.status() != QDataStream::Ok || ! (storedKey == key) ||
+            (usesWorkingDir && workingDir != m_workingDir)){
+        return false;
+    }
+
+    HashSettings hashSettings;
+    WriteFileSettings wSettings;
+    ReadFileSettings rSettings;
+    ScriptFileSettings scriptSettings;
+    StringSet mountIgnorePaths;
+    bool mountIgnoreNoPerm;
+    bool sessionObserver;
+    bool standbyObserver;
+    bool observerDaemon;
+    StringSet ignoreCmds;
+    StringSet ignoreCmdsRegardlessOfArgs;
+
+    s >> hashSettings.hashMeta.chunkSize >> hashSettings.hashMeta.maxCountOfReads
+      >> hashSettings.hashEnable;
+
+    readPathTree(s, wSettings.includePaths);
+    readPathTree(s, wSettings.includePathsHidden);
+    readPathTree(s, wSettings.excludePaths);
+    s >> wSettings.onlyClosedWrite >> wSettings.excludeHidden
+      >> wSettings.flushToDiskEventCount;
+
+    s >> rSettings.enable;
+    readPathTree(s, rSettings.includePaths);
+    readPathTree(s, rSettings.includePathsHidden);
+    readPathTree(s, rSettings.excludePaths);
+    s >> rSettings.onlyWritable >> rSettings.excludeHidden
+      >> rSettings.flushToDiskEventCount;
+
+    s >> scriptSettings.enable >> scriptSettings.onlyWritable >> scriptSettings.excludeHidden;
+    readPathTree(s, scriptSettings.includePaths);
+    readPathTree(s, scriptSettings.includePathsHidden);
+    readPathTree(s, scriptSettings.excludePaths);
+    readStringSet(s, scriptSettings.includeExtensions);
+    readMimeSet(s, scriptSettings.includeMimetypes);
+    s >> scriptSettings.maxFileSize >> scriptSettings.maxCountOfFiles
+      >> scriptSettings.flushToDiskTotalSize;
+
+    readStringSet(s, mountIgnorePaths);
+    s >> mountIgnoreNoPerm >> sessionObserver >> standbyObserver >> observerDaemon;
+    readStringSet(s, ignoreCmds);
+    readStringSet(s, ignoreCmdsRegardlessOfArgs);
+
+    if(s.status() != QDataStream::Ok || ! s.atEnd()){
+        logDebug << "ignoring invalid settings snapshot" << f.fileName();
+        return false;
+    }
+    m_hashSettings = hashSettings;
+    m_wSettings = wSettings;
+    m_rSettings = rSettings;
+    m_scriptSettings = scriptSettings;
+    m_mountIgnorePaths = mountIgnorePaths;
+    m_mountIgnoreNoPerm = mountIgnoreNoPerm;
+    m_sessionObserver = sessionObserver;
+    m_standbyObserver = standbyObserver;
+    m_observerDaemon = observerDaemon;
+    m_ignoreCmds = ignoreCmds;
+    m_ignoreCmdsRegardlessOfArgs = ignoreCmdsRegardlessOfArgs;
+    return true;
+}
+
+/// Atomically replace the snapshot by the currently loaded settings.
+/// Failure is not critical, we only parse the config file next time again.
+void Settings::storeSnapshot(const Settings::SnapshotKey &key)
+{
+    const QString path = snapshotFilepath();
+    if(! QDir().mkpath(splitAbsPath(path).first)){
+        logDebug << "failed to create the directory for" << path;
+        return;
+    }
+    QSaveFile f(path);
+    if(! f.open(QFile::OpenModeFlag::WriteOnly)){
+        logDebug << "failed to open" << path << f.errorString();
+        return;
+    }
+    QDataStream s(&f);
+    s.setVersion(SNAPSHOT_STREAM_VERSION);
+    s << SNAPSHOT_MAGIC << SNAPSHOT_FORMAT_VERSION;
+    s << key.cfgMtimeNs << key.cfgSize << key.cfgInode << key.appVersion
+      << key.uid << key.envPath << key.userHome
+      << m_usesWorkingDir << (m_usesWorkingDir ? m_workingDir : QString());
+
+    s << m_hashSettings.hashMeta.chunkSize << m_hashSettings.hashMeta.maxCountOfReads
+      << m_hashSettings.hashEnable;
+
+    writePathTree(s, m_wSettings.includePaths);
+    writePathTree(s, m_wSettings.includePathsHidden);
+    writePathTree(s, m_wSettings.excludePaths);
+    s << m_wSettings.onlyClosedWrite << m_wSettings.excludeHidden
+      << m_wSettings.flushToDiskEventCount;
+
+    s << m_rSettings.enable;
+    writePathTree(s, m_rSettings.includePaths);
+    writePathTree(s, m_rSettings.includePathsHidden);
+    writePathTree(s, m_rSettings.excludePaths);
+    s << m_rSettings.onlyWritable << m_rSettings.excludeHidden
+      << m_rSettings.flushToDiskEventCount;
+
+    s << m_scriptSettings.enable << m_scriptSettings.onlyWritable
+      << m_scriptSettings.excludeHidden;
+    writePathTree(s, m_scriptSettings.includePaths);
+    writePathTree(s, m_scriptSettings.includePathsHidden);
+    writePathTree(s, m_scriptSettings.excludePaths);
+    writeStringSet(s, m_scriptSettings.includeExtensions);
+    writeMimeSet(s, m_scriptSettings.includeMimetypes);
+    s << m_scriptSettings.maxFileSize << m_scriptSettings.maxCountOfFiles
+      << m_scriptSettings.flushToDiskTotalSize;
+
+    writeStringSet(s, m_mountIgnorePaths);
+    s << m_mountIgnoreNoPerm << m_sessionObserver << m_standbyObserver << m_observerDaemon;
+    writeStringSet(s, m_ignoreCmds);
+    writeStringSet(s, m_ignoreCmdsRegardlessOfArgs);
+
+    if(s.status() != QDataStream::Ok || ! f.commit()){
+        logDebug << "failed to store the settings snapshot" << path << f.errorString();
+    }
+}
+
 /// Parse or create the configuration file at the system's config path
 /// (please perform QCoreApplication::setApplicationName() before).
 /// Another file at config dir provides the version. If the config file version is greater
@@ -598,11 +904,22 @@ void Settings::storeCfg(QFileThrow &cfgVersionFile)
 /// scheme versions the same section is renamed multiple times. Intermediate
 /// sections are created as necessary and potentially dropped/renamed again
 /// by subsequent scheme updates.
+/// If the config file is unchanged since the last load, the settings are
+/// loaded from a snapshot instead, see loadSnapshot.
 /// @throws ExcCfg
 void Settings::load()
 {
     const auto cfgPath = cfgFilepath();
 
+    SnapshotKey key;
+    bool cfgFileExists = snapshotKey(cfgPath, key);
+    if(cfgFileExists && loadSnapshot(key)){
+        m_loadedFromSnapshot = true;
+        m_settingsLoaded = true;
+        return;
+    }
+    m_loadedFromSnapshot = false;
+
     const QString cfgDir(splitAbsPath(cfgPath).first);
     QDir dir;
     if(! dir.mkpath(cfgDir) ){
@@ -639,11 +956,17 @@ void Settings::load()
         if(! cfgFileExisted || cfgVersionNeedsUpdate){
             cfgVersionLock.lockExclusive();
             storeCfg(cfgVersionFile);
+            cfgFileExists = snapshotKey(cfgPath, key);
         }
     } catch(ExcCfg & ex) {
         ex.setDescrip(ex.descrip() + qtr(". The config file resides at %1").arg(cfgPath));
         throw;
     }
+    // The key was determined before parsing, so a concurrent modification
+    // of the config file causes a reparse next time.
+    if(cfgFileExists && m_snapshotable){
+        storeSnapshot(key);
+    }
 
     m_settingsLoaded = true;
 }
@@ -662,6 +985,22 @@ bool Settings::getMountIgnoreNoPerm() const
     return m_mountIgnoreNoPerm;
 }
 
+bool Settings::sessionObserver() const
+{
+    return m_sessionObserver;
+}
+
+bool Settings::standbyObserver() const
+{
+    return m_standbyObserver;
+}
+
+/// Only applies to session observers, see sessionObserver()
+bool Settings::observerDaemon() const
+{
+    return m_observerDaemon;
+}
+
 
 
 const Settings::StringSet &Settings::ignoreCmds()
@@ -58,7 +58,7 @@ public:
         qint64 maxFileSize {500*1024}; // .. it's not bigger than this size
         int maxCountOfFiles {3}; // .. we have not already collected that many read files
 
-        int flushToDiskTotalSize {1024*1024*10}; // read files (scripts) are cached in memory. If their total size is
+        int flushToDiskTotalSize {1024*1024*10}; // read files (scripts) are staged in a temporary file. If their total size is
                                   // greater than that, flush to disk (database)
     };
 
@@ -82,6 +82,10 @@ public:
     const StringSet& getMountIgnorePaths();
     bool getMountIgnoreNoPerm() const;
 
+    bool sessionObserver() const;
+    bool standbyObserver() const;
+    bool observerDaemon() const;
+
 public:
     ~Settings() = default;
     Q_DISABLE_COPY(Settings)
@@ -97,6 +101,11 @@ public:
     static const char* SECT_SCRIPTS_INCLUDE_PATHS;
     static const char* SECT_SCRIPTS_INCLUDE_FILE_EXTENSIONS;
 
+    static const char* SECT_SHELL_NAME;
+    static const char* SECT_SHELL_SESSION_OBSERVER;
+    static const char* SECT_SHELL_STANDBY_OBSERVER;
+    static const char* SECT_SHELL_OBSERVER_DAEMON;
+
 private:
     struct ReadVersionReturn {
         QVersionNumber ver;
@@ -104,6 +113,20 @@ private:
         QString verFilePath;
     };
 
+    /// The loaded settings only depend on the config file and these
+    /// parts of the environment (and possibly the working directory).
+    struct SnapshotKey {
+        qint64 cfgMtimeNs {};
+        qint64 cfgSize {};
+        quint64 cfgInode {};
+        QString appVersion;
+        quint32 uid {};
+        QByteArray envPath;
+        QString userHome;
+
+        bool operator==(const SnapshotKey& rhs) const;
+    };
+
     Settings() = default;
     void addIgnoreCmd(QString cmd, bool warnIfNotFound, const QString & ignoreCmdsSectName);
     void loadSections();
@@ -113,6 +136,7 @@ private:
     void loadSectIgnoreCmd();
     void loadSectMount();
     void loadSectHash();
+    void loadSectShellIntegration();
 
     bool parseCfgIfExists(const QString &cfgPath);
     ReadVersionReturn readVersion(QFileThrow &cfgVersionFile);
@@ -123,6 +147,11 @@ private:
               const std::unordered_set<QString> & defaultValues,
               PathTree* hiddenPaths=nullptr);
 
+    QString snapshotFilepath();
+    bool snapshotKey(const QString& cfgPath, SnapshotKey& key);
+    bool loadSnapshot(const SnapshotKey& key);
+    void storeSnapshot(const SnapshotKey& key);
+
     qsimplecfg::Cfg m_cfg;
     HashSettings m_hashSettings;
     WriteFileSettings m_wSettings;
@@ -130,7 +159,13 @@ private:
     ScriptFileSettings m_scriptSettings;
     StringSet m_mountIgnorePaths;
     bool m_mountIgnoreNoPerm {false};
+    bool m_sessionObserver {false};
+    bool m_standbyObserver {false};
+    bool m_observerDaemon {false};
     bool m_settingsLoaded {false};
+    bool m_snapshotable {true}; // false, if the result depends on more than the SnapshotKey
+    bool m_usesWorkingDir {false};
+    bool m_loadedFromSnapshot {false};
     StringSet m_ignoreCmds;
     StringSet m_ignoreCmdsRegardlessOfArgs;
     const QString m_userHome { QDir::homePath() };
@@ -140,6 +175,7 @@ private:
     // unit testing...
     friend class FileEventHandlerTest;
     friend class IntegrationTestShell;
+    friend class SettingsTest;
 };
 
 
@@ -14,6 +14,9 @@ const char* socket_message::socketMsgToStr(E_SocketMsg msg){
     case E_SocketMsg::EMPTY: return "EMPTY";
     case E_SocketMsg::LOG_MESSAGE: return "LOG_MESSAGE";
     case E_SocketMsg::CMD_START_DATETIME: return "CMD_START_DATETIME";
+    case E_SocketMsg::BEGIN_COMMAND: return "BEGIN_COMMAND";
+    case E_SocketMsg::END_COMMAND: return "END_COMMAND";
+    case E_SocketMsg::REGISTER_SESSION: return "REGISTER_SESSION";
     case E_SocketMsg::ENUM_END: return "ENUM_END";
     }
     return "UNHANDLED ENUM CASE";
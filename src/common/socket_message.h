@@ -3,10 +3,16 @@
 
 namespace socket_message {
 
-/// Messages send from shell observation to shournal process or vice versa
+/// Messages send from shell observation to shournal process or vice versa.
+/// BEGIN_COMMAND and END_COMMAND delimit the commands observed by a
+/// session observer (see FileWatcher::setSessionMode).
+/// REGISTER_SESSION is sent to the observer daemon (see ObserverDaemon),
+/// passing the socket of a new session.
 enum class E_SocketMsg { SETUP_DONE, SETUP_FAIL, CLEAR_EVENTS,
                          COMMAND, RETURN_VALUE, EMPTY,
-                         LOG_MESSAGE, CMD_START_DATETIME, ENUM_END };
+                         LOG_MESSAGE, CMD_START_DATETIME,
+                         BEGIN_COMMAND, END_COMMAND, REGISTER_SESSION,
+                         ENUM_END };
 
 const char* socketMsgToStr(E_SocketMsg msg);
 
@@ -5,8 +5,13 @@
 #include <iostream>
 #include <cstring>
 #include <cassert>
+#include <csignal>
 #include <string>
+#include <algorithm>
 #include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <linux/limits.h>
 
 #include "subprocess.h"
@@ -65,6 +70,138 @@ void throwFailedToLaunchEx(char *const argv[],
 }
 
 
+/// Arguments of the child created by clone(CLONE_VM|CLONE_VFORK) in
+/// Subprocess::spawn. The child shares the memory of the (suspended) parent,
+/// so it must neither allocate nor throw and only use plain syscalls.
+/// Especially glibc's setuid is not safe there, as it signals all threads.
+struct SpawnArgs {
+    const char* filename;
+    char* const* argv;
+    char* const* envp;
+    int startPipeWrite;
+    const int* keepFds; // sorted, all > 2
+    size_t keepFdsSize;
+    bool closeFds;
+    bool closeStdin;
+    bool closeStdout;
+    bool closeStderr;
+    bool asRealUser;
+    uid_t uid;
+    gid_t gid;
+    bool inNewSid;
+    bool writePid;
+    char* grandchildStackTop; // only for detached launches
+    sigset_t origSigmask;
+};
+
+const size_t SPAWN_STACK_SIZE = 256 * 1024;
+
+#ifdef SYS_setuid32
+// SYS_setuid/SYS_setgid only take 16-bit ids on those architectures
+const long SETUID_NR = SYS_setuid32;
+const long SETGID_NR = SYS_setgid32;
+#else
+const long SETUID_NR = SYS_setuid;
+const long SETGID_NR = SYS_setgid;
+#endif
+
+int closeRange(unsigned first, unsigned last){
+#ifdef __NR_close_range
+    return static_cast<int>(syscall(__NR_close_range, first, last, 0U));
+#else
+    (void)first; (void)last;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+bool closeRangeSupported(){
+    // closing a (most probably) unused fd succeeds, if the syscall exists
+    static const bool supported = closeRange(~0U, ~0U) == 0;
+    return supported;
+}
+
+void writeSpawnMsg(int fd, LaunchMsgType msgType, int errorNumber){
+    LaunchMsg msg{};
+    msg.msgType = msgType;
+    msg.errorNumber = errorNumber;
+    msg.pid = static_cast<pid_t>(syscall(SYS_getpid));
+    // nothing we can do on error
+    (void)::write(fd, &msg, sizeof (LaunchMsg));
+}
+
+[[noreturn]]
+void spawnChildFailed(const SpawnArgs& args){
+    writeSpawnMsg(args.startPipeWrite, LaunchMsgType::EXCEPTION, errno);
+    _exit(1);
+}
+
+int spawnChild(void* rawArgs){
+    const auto& args = *static_cast<const SpawnArgs*>(rawArgs);
+    // Handlers of the parent must not run in our shared memory
+    // (see also posix_spawn).
+    for(int sig=1; sig < NSIG; sig++){
+        struct sigaction sa;
+        if(sigaction(sig, nullptr, &sa) == 0 &&
+                sa.sa_handler != SIG_IGN && sa.sa_handler != SIG_DFL){
+            sa.sa_handler = SIG_DFL;
+            sigaction(sig, &sa, nullptr);
+        }
+    }
+    if(args.asRealUser){
+        // The libc wrappers would synchronize the ids of all threads, while we
+        // share the memory of the parent, so make the plain syscalls. Use the
+        // 32-bit id variants where they exist (e.g. i386, arm).
+        if(syscall(SETGID_NR, args.gid) == -1 ||
+                syscall(SETUID_NR, args.uid) == -1){
+            spawnChildFailed(args);
+        }
+    }
+    if(args.writePid){
+        writeSpawnMsg(args.startPipeWrite, LaunchMsgType::PID, 0);
+    }
+    if(args.closeFds){
+        if(args.closeStdin) close(STDIN_FILENO);
+        if(args.closeStdout) close(STDOUT_FILENO);
+        if(args.closeStderr) close(STDERR_FILENO);
+        unsigned first = 3;
+        for(size_t i=0; i < args.keepFdsSize; i++){
+            const auto keepFd = static_cast<unsigned>(args.keepFds[i]);
+            if(keepFd > first){
+                closeRange(first, keepFd - 1);
+            }
+            first = keepFd + 1;
+        }
+        closeRange(first, ~0U);
+    }
+    sigprocmask(SIG_SETMASK, &args.origSigmask, nullptr);
+    execvpe(args.filename, args.argv, args.envp);
+    spawnChildFailed(args);
+}
+
+/// The intermediate child of a detached launch: create the grandchild
+/// (which is suspended until exec) and exit, so the grandchild is reparented.
+int spawnIntermediateChild(void* rawArgs){
+    auto& args = *static_cast<SpawnArgs*>(rawArgs);
+    if(args.inNewSid){
+        setsid();
+    }
+    args.writePid = true;
+    if(clone(spawnChild, args.grandchildStackTop, CLONE_VM | CLONE_VFORK | SIGCHLD,
+             rawArgs) == -1){
+        spawnChildFailed(args);
+    }
+    _exit(0);
+}
+
+int spawnNonDetachedChild(void* rawArgs){
+    const auto& args = *static_cast<const SpawnArgs*>(rawArgs);
+    if(args.inNewSid){
+        setsid();
+    }
+    return spawnChild(rawArgs);
+}
+
 /// convert to null-terminated vector which will be passed as argv.
 std::vector<char*> toPointerVect(const subprocess::Args_t& args){
     std::vector<char*> pointerVec(args.size() + 1 ); // + 1 because of terminating NULL
@@ -83,7 +220,8 @@ subprocess::Subprocess::Subprocess() :
     m_forwardAllFds(false),
     m_lastCallWasDetached(false),
     m_environ(nullptr),
-    m_inNewSid(false)
+    m_inNewSid(false),
+    m_useFork(false)
 {}
 
 void subprocess::Subprocess::call(char *const argv[],
@@ -115,7 +253,12 @@ void subprocess::Subprocess::call(const char *filename, char * const argv[], boo
         closeVerbose(startPipe[1]);
     });
 
-    m_lastPid  = os::fork();
+    if(spawnPossible()){
+        m_lastPid = spawn(filename, argv, startPipe, false,
+                          forwardStdin, forwardStdout, forwardStderr);
+    } else {
+        m_lastPid = os::fork();
+    }
     if (m_lastPid == 0) {
         if(m_inNewSid) os::setsid();
         // child
@@ -147,7 +290,15 @@ void subprocess::Subprocess::callDetached(const char *filename, char * const arg
     auto closeStartWrite = finally([&startPipe] {       
         closeVerbose(startPipe[1]);
     });
-    pid_t pid1 = os::fork();
+    pid_t pid1 = -1;
+    if(spawnPossible()){
+        pid1 = spawn(filename, argv, startPipe, true,
+                     forwardStdin, forwardStdout, forwardStderr);
+        // the intermediate child has already exited
+        while(::waitpid(pid1, nullptr, 0) == -1 && errno == EINTR);
+    } else {
+        pid1 = os::fork();
+    }
     if(pid1 == 0){
         if(m_inNewSid) os::setsid();
         // child: fork again and exit
@@ -257,6 +408,81 @@ void subprocess::Subprocess::setInNewSid(bool val)
     m_inNewSid = val;
 }
 
+/// Always fork, even if the cheaper clone(CLONE_VM|CLONE_VFORK) is
+/// possible (e.g. for comparison in benchmarks).
+void subprocess::Subprocess::setUseFork(bool val)
+{
+    m_useFork = val;
+}
+
+bool subprocess::Subprocess::spawnPossible() const
+{
+    return ! m_useFork && (m_forwardAllFds || closeRangeSupported());
+}
+
+/// Create the child via clone(CLONE_VM|CLONE_VFORK), which returns after the
+/// child called exec or exited. Errors are reported via startPipe like
+/// in handleChild.
+/// @param detach: launch the program as grandchild, the returned pid
+///                is the one of the (already exited) intermediate child.
+/// @throws ExcOs
+pid_t subprocess::Subprocess::spawn(const char *filename, char * const argv[],
+                                    os::Pipes_t &startPipe, bool detach,
+                                    bool forwardStdin, bool forwardStdout, bool forwardStderr)
+{
+    std::vector<int> keepFds;
+    keepFds.reserve(m_forwardFds.size() + 1);
+    for(const int fd : m_forwardFds){
+        if(fd > 2) keepFds.push_back(fd);
+    }
+    keepFds.push_back(startPipe[1]);
+    std::sort(keepFds.begin(), keepFds.end());
+    keepFds.erase(std::unique(keepFds.begin(), keepFds.end()), keepFds.end());
+
+    const size_t stackCount = (detach) ? 2 : 1;
+    void* stack = mmap(nullptr, SPAWN_STACK_SIZE * stackCount, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK | MAP_NORESERVE, -1, 0);
+    if(stack == MAP_FAILED){
+        throw os::ExcOs("mmap of the child's stack failed");
+    }
+    auto unmapStack = finally([stack, stackCount] {
+        munmap(stack, SPAWN_STACK_SIZE * stackCount);
+    });
+    // the stack grows downwards
+    char* childStackTop = static_cast<char*>(stack) + SPAWN_STACK_SIZE;
+
+    SpawnArgs args{};
+    args.filename = filename;
+    args.argv = argv;
+    args.envp = (m_environ == nullptr) ? environ : m_environ;
+    args.startPipeWrite = startPipe[1];
+    args.keepFds = keepFds.data();
+    args.keepFdsSize = keepFds.size();
+    args.closeFds = ! m_forwardAllFds;
+    args.closeStdin = ! forwardStdin;
+    args.closeStdout = ! forwardStdout;
+    args.closeStderr = ! forwardStderr;
+    args.asRealUser = m_asRealUser;
+    args.uid = os::getuid();
+    args.gid = os::getgid();
+    args.inNewSid = m_inNewSid;
+    args.writePid = false;
+    args.grandchildStackTop = (detach) ? childStackTop + SPAWN_STACK_SIZE : nullptr;
+
+    // No signal handler may run in the child before it reset them.
+    sigset_t allSigs;
+    sigfillset(&allSigs);
+    pthread_sigmask(SIG_SETMASK, &allSigs, &args.origSigmask);
+    const pid_t pid = clone((detach) ? spawnIntermediateChild : spawnNonDetachedChild,
+                            childStackTop, CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+    const int cloneErr = errno;
+    pthread_sigmask(SIG_SETMASK, &args.origSigmask, nullptr);
+    if(pid == -1){
+        throw os::ExcOs("clone failed", cloneErr);
+    }
+    return pid;
+}
+
 void subprocess::Subprocess::closeAllButForwardFds(os::Pipes_t &startPipe)
 {
     // startpipe fds have O_CLOEXEC set, if exec fails, the respond is sent via
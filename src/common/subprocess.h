@@ -11,7 +11,10 @@ namespace subprocess {
 typedef std::vector<std::string> Args_t;
 
 /// Call external programs via fork and exec
-/// and wait for it to finish later
+/// and wait for it to finish later.
+/// If possible, the child is created via clone(CLONE_VM|CLONE_VFORK) which,
+/// unlike fork, does not copy the page tables of the (maybe large) parent,
+/// and the file descriptors are closed via close_range.
 class Subprocess {
 public:
 
@@ -49,6 +52,7 @@ public:
     void setForwardFdsOnExec(const std::unordered_set<int>& forwardFds);
     void setForwardAllFds(bool val);
     void setInNewSid(bool val);
+    void setUseFork(bool val);
 
     pid_t lastPid() const;
     void setEnviron(char **env);
@@ -58,6 +62,9 @@ private:
     [[noreturn]]
     void handleChild(const char *filename, char * const argv[], os::Pipes_t & startPipe, bool writePidToStartPipe,
                      bool forwardStdin, bool forwardStdout, bool forwardStderr);
+    bool spawnPossible() const;
+    pid_t spawn(const char *filename, char * const argv[], os::Pipes_t & startPipe, bool detach,
+                bool forwardStdin, bool forwardStdout, bool forwardStderr);
 
     pid_t m_lastPid;
     bool m_asRealUser;
@@ -66,6 +73,7 @@ private:
     bool m_lastCallWasDetached;
     char** m_environ;
     bool m_inNewSid;
+    bool m_useFork;
 };
 
 
@@ -16,12 +16,11 @@
 #include "translation.h"
 #include "shell_request_handler.h"
 
-/// @return absolute version of the passed path or an empty string in case
-/// of an error.
-static std::string mkAbsPath(const char* path){
-    if(path[0] == '/'){
-        return path;
-    }
+/// Fill the cached working directory (with trailing slash), which is only
+/// invalidated on chdir/fchdir and at the start of each command (in case
+/// the directory was renamed in the meantime).
+/// @return false on error
+static bool cacheCwd(const char* path, std::string& cwd){
     std::string buf(PATH_MAX, '\0');
 
     char* rawBuf = strDataAccess(buf);
@@ -30,7 +29,7 @@ static std::string mkAbsPath(const char* path){
                        "The working-directory could not be determined (%2). "
                        "File events will not be registered.")
                    .arg(path, translation::strerror_l());
-        return {};
+        return false;
     }
     if(rawBuf[0] != '/'){
         // see also man 3 getcwd
@@ -38,14 +37,33 @@ static std::string mkAbsPath(const char* path){
                        "The working-directory does not begin with '/' but %2. "
                        "File events will not be registered.")
                    .arg(path, rawBuf);
-        return {};
+        return false;
     }
 
     // resize to actual length
     buf.resize(strlen(rawBuf));
-    buf += '/';
-    buf += path;
-    return buf;
+    if(buf.back() != '/'){
+        buf += '/';
+    }
+    cwd = std::move(buf);
+    return true;
+}
+
+/// @return absolute version of the passed path or nullptr in case
+/// of an error. Relative paths are resolved against the cached working
+/// directory into a reused buffer, so usually no syscall or allocation
+/// is necessary.
+static const char* mkAbsPath(const char* path, ShellGlobals& g_shell){
+    if(path[0] == '/'){
+        return path;
+    }
+    if(g_shell.cachedCwd.empty() && ! cacheCwd(path, g_shell.cachedCwd)){
+        return nullptr;
+    }
+    std::string& buf = g_shell.absPathBuf;
+    buf.assign(g_shell.cachedCwd);
+    buf.append(path);
+    return buf.c_str();
 }
 
 int event_open::handleOpen(const char *pathname, int flags, mode_t mode, bool largeFile)
@@ -60,7 +78,7 @@ int event_open::handleOpen(const char *pathname, int flags, mode_t mode, bool la
     }
     auto clearIgnEvents = finally([&g_shell] { g_shell.ignoreEvents.clear(); });
 
-    if(! g_shell.inSubshell){
+    if(! g_shell.inSubshell && shell_request_handler::mayBeTrigger(pathname)){
         if(shell_request_handler::checkForTriggerAndHandle()){
             return g_shell.orig_open(pathname, flags, mode);
         }
@@ -70,17 +88,37 @@ int event_open::handleOpen(const char *pathname, int flags, mode_t mode, bool la
         return g_shell.orig_open(pathname, flags, mode);
     }
 
-    const auto absPath = mkAbsPath(pathname);
-    if(absPath.size() < 2){
+    const char* absPath = mkAbsPath(pathname, g_shell);
+    if(absPath == nullptr || absPath[0] == '\0' || absPath[1] == '\0'){
         // Get here on mkAbsPath-error or because user attempted to open "/" or ""
         // The shortest possible absolute FILEpath under linux is two chars long.
         // We may get here, if bash-user calls e.g.
         // while read line; do echo $line ; done < "/"
-        logDebug << "no valid path" << absPath;
+        logDebug << "no valid path" << pathname;
         return g_shell.orig_open(pathname, flags, mode);
     }
     // pass the resolved abs. path relative to shournal's root directory fd,
     // by omitting the initial '/'.
-    return openat(g_shell.shournalRootDirFd, absPath.c_str() + 1, flags, mode);
+    return openat(g_shell.shournalRootDirFd, absPath + 1, flags, mode);
+}
+
+int event_open::handleChdir(const char *path)
+{
+    auto& g_shell = ShellGlobals::instance();
+    const int ret = g_shell.orig_chdir(path);
+    if(ret == 0){
+        g_shell.cachedCwd.clear();
+    }
+    return ret;
+}
+
+int event_open::handleFchdir(int fd)
+{
+    auto& g_shell = ShellGlobals::instance();
+    const int ret = g_shell.orig_fchdir(fd);
+    if(ret == 0){
+        g_shell.cachedCwd.clear();
+    }
+    return ret;
 }
 
@@ -7,5 +7,8 @@ namespace event_open {
 
 int handleOpen(const char *pathname, int flags, mode_t mode, bool largeFile );
 
+int handleChdir(const char *path);
+int handleFchdir(int fd);
+
 }
 
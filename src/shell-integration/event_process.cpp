@@ -1,5 +1,6 @@
 
 #include <cassert>
+#include <cstring>
 #include <QStandardPaths>
 #include <QCoreApplication>
 #include <sys/socket.h>
@@ -73,36 +74,69 @@ pid_t event_process::handleFork()
 
 
 
-int event_process::handleExecve(const char *filename, char * const argv[], char * const envp[])
-{
-    auto& g_shell = ShellGlobals::instance();
-    if(g_shell.ignoreEvents.test_and_set()){
-        return g_shell.orig_execve(filename, argv, envp);
+/// The dynamic loader removes these variables from the environment of
+/// setuid-programs (see UNSECURE_ENVVARS in glibc).
+static bool isUnsecureEnvVar(const char* e){
+    static const char* const unsecurePrefixes[] = {
+        "LD_", "MALLOC_", "GLIBC_TUNABLES=", "GCONV_PATH=", "GETCONF_DIR=",
+        "HOSTALIASES=", "LOCALDOMAIN=", "LOCPATH=", "NIS_PATH=", "NLSPATH=",
+        "RESOLV_HOST_CONF=", "RES_OPTIONS=", "TMPDIR=", "TZDIR="
+    };
+    for(const char* prefix : unsecurePrefixes){
+        if(strncmp(e, prefix, strlen(prefix)) == 0){
+            return true;
+        }
     }
-    auto clearIgnEvents = finally([&g_shell] {g_shell.ignoreEvents.clear(); });
+    return false;
+}
 
-    if(! g_shell.inSubshell ||
-         g_shell.watchState != E_WatchState::WITHIN_CMD){
-        return g_shell.orig_execve(filename, argv, envp);
-    }
 
-    // No point in observing an unstattable executable.
-    // Further, do not monitor suid-applications. Note: this is, of course, *not*
-    // a security-feature, however, events by other users are in
-    // relevant cases not recorded by shournal anyway.
-    struct stat st;
-    if(stat(filename, &st) == -1 || IsBitSet(st.st_mode, mode_t(S_ISUID) ) ){
-        return execveUnobserved(filename, argv, envp);
+/// Exec the lightweight shournal-msenter, which joins the mount-namespace
+/// and execs the command. The environment is passed as is, except for the
+/// variables removed for setuid-programs, which are passed as arguments.
+/// Only returns on error.
+/// @throws ExcOs
+static void execMsenter(const char *filename, char * const argv[], char * const envp[],
+                        const char* socketNbEnv){
+    auto& g_shell = ShellGlobals::instance();
+    const std::string pid = std::to_string(g_shell.lastMountNamespacePid);
+
+    QVarLengthArray<const char*, 64> args;
+    args.push_back(app::SHOURNAL_MSENTER);
+    args.push_back(pid.c_str());
+
+    // set shournal socket only for observed processes (do not add to
+    // shell env).
+    QVarLengthArray<const char*, 512> env;
+    env.push_back(socketNbEnv);
+    for(char* const *e = envp; *e != nullptr; e++) {
+        env.push_back(*e);
+        if(isUnsecureEnvVar(*e)){
+            args.push_back(*e);
+        }
     }
+    env.push_back(nullptr);
 
-    std::string filenameStr(filename);
-    auto& sets = Settings::instance();
-    if(sets.ignoreCmdsRegardslessOfArgs().find(filenameStr) !=
-            sets.ignoreCmdsRegardslessOfArgs().end()){
-        return execveUnobserved(filename, argv, envp);
+    args.push_back("--");
+    args.push_back(filename);
+    for(int i=0; ; i++) {
+        // include final nullptr here
+        args.push_back(argv[i]);
+        if(argv[i] == nullptr){
+            break;
+        }
     }
-    std::string fullCmd;
+    os::exec(args, const_cast<char**>(env.data()));
+}
+
 
+/// Previous (and fallback) way to exec the command: shournal-run --msenter
+/// with the environment passed as arguments.
+/// Only returns on error.
+/// @throws ExcOs
+static void execShournalRunMsenter(const char *filename, char * const argv[],
+                                   char * const envp[], const char* socketNbEnv){
+    auto& g_shell = ShellGlobals::instance();
     QVarLengthArray<const char*, 8192> args;
     args.push_back(app::SHOURNAL_RUN);
     args.push_back("--msenter");
@@ -117,11 +151,7 @@ int event_process::handleExecve(const char *filename, char * const argv[], char
     args.push_back("DUMMY");
     int envSizeIdx = args.size() -1;
 
-    // set shournal socket only for observed processes (do not add to
-    // shell env).
-    const std::string shournalSocketNbStr = std::string(app::ENV_VAR_SOCKET_NB) + '=' +
-                                      std::to_string(g_shell.shournalSocketNb);
-    args.push_back(shournalSocketNbStr.c_str());
+    args.push_back(socketNbEnv);
 
     for(char* const *e = envp; *e != nullptr; e++) {
         args.push_back(*e);
@@ -135,23 +165,53 @@ int event_process::handleExecve(const char *filename, char * const argv[], char
     args.push_back(filename);
 
     args.push_back("--exec");
-    fullCmd += filenameStr + ' ';
-
     for(int i=0; ; i++) {
         // include final nullptr here
         args.push_back(argv[i]);
         if(argv[i] == nullptr){
             break;
         }
-        if(i > 0){
-            // for the ignore-list skip argv0 which should be the same
-            // as filename in most cases anyway.
-            fullCmd.append(argv[i]);
-            fullCmd += ' ';
-        }
     }
-    // strip final whitespace
-    fullCmd.pop_back();
+    os::exec(args, envp);
+}
+
+
+int event_process::handleExecve(const char *filename, char * const argv[], char * const envp[])
+{
+    auto& g_shell = ShellGlobals::instance();
+    if(g_shell.ignoreEvents.test_and_set()){
+        return g_shell.orig_execve(filename, argv, envp);
+    }
+    auto clearIgnEvents = finally([&g_shell] {g_shell.ignoreEvents.clear(); });
+
+    if(! g_shell.inSubshell ||
+         g_shell.watchState != E_WatchState::WITHIN_CMD){
+        return g_shell.orig_execve(filename, argv, envp);
+    }
+
+    // No point in observing an unstattable executable.
+    // Further, do not monitor suid-applications. Note: this is, of course, *not*
+    // a security-feature, however, events by other users are in
+    // relevant cases not recorded by shournal anyway.
+    struct stat st;
+    if(stat(filename, &st) == -1 || IsBitSet(st.st_mode, mode_t(S_ISUID) ) ){
+        return execveUnobserved(filename, argv, envp);
+    }
+
+    std::string filenameStr(filename);
+    auto& sets = Settings::instance();
+    if(sets.ignoreCmdsRegardslessOfArgs().find(filenameStr) !=
+            sets.ignoreCmdsRegardslessOfArgs().end()){
+        return execveUnobserved(filename, argv, envp);
+    }
+
+    // for the ignore-list skip argv0 which should be the same
+    // as filename in most cases anyway.
+    std::string fullCmd = filenameStr;
+    for(int i=1; argv[0] != nullptr && argv[i] != nullptr; i++) {
+        fullCmd += ' ';
+        fullCmd.append(argv[i]);
+    }
     if(sets.ignoreCmds().find(fullCmd) !=
             sets.ignoreCmds().end()){
         logDebug << "exec UNobserved:" << fullCmd.c_str();
@@ -159,16 +219,21 @@ int event_process::handleExecve(const char *filename, char * const argv[], char
     }
 
     logDebug << "execvpe observed:" << fullCmd.c_str();
+    const std::string socketNbEnv = std::string(app::ENV_VAR_SOCKET_NB) + '=' +
+                                      std::to_string(g_shell.shournalSocketNb);
+    try {
+        execMsenter(filename, argv, envp, socketNbEnv.c_str());
+    } catch (const os::ExcOs& e) {
+        logDebug << app::SHOURNAL_MSENTER << "failed:" << e.what()
+                 << "- trying" << app::SHOURNAL_RUN;
+    }
     try {
-        os::exec(args, envp);
+        execShournalRunMsenter(filename, argv, envp, socketNbEnv.c_str());
     } catch (const os::ExcOs& e) {
         logCritical << qtr("Failed to launch %1 with external program. "
                            "Please make sure %2 is in your PATH: %3. "
                            "Running it unobserved instead...")
-                       .arg(filename, app::SHOURNAL_RUN, e.what());
+                       .arg(filename, app::SHOURNAL_MSENTER, e.what());
     }
     return execveUnobserved(filename, argv, envp);
 }
-
-
-
@@ -4,6 +4,7 @@
 #define _GNU_SOURCE
 #endif
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <exception>
 #include <cstdio>
 #include <iostream>
@@ -13,6 +14,7 @@
 #include "event_process.h"
 #include "staticinitializer.h"
 #include "shell_globals.h"
+#include "shell_request_handler.h"
 #include "logger.h"
 #include "qoutstream.h"
 #include "shell_logger.h"
@@ -37,6 +39,8 @@ void initSymIfNeeded(){
             globals.orig_open = reinterpret_cast<open_func_t>(os::dlsym(RTLD_NEXT, "open"));
             // globals.orig_fopen = reinterpret_cast<fopen_func_t>(os::dlsym(RTLD_NEXT, "fopen"));
             globals.orig_strcpy = reinterpret_cast<strcpy_func_t>(os::dlsym(RTLD_NEXT, "strcpy"));
+            globals.orig_chdir = reinterpret_cast<chdir_func_t>(os::dlsym(RTLD_NEXT, "chdir"));
+            globals.orig_fchdir = reinterpret_cast<fchdir_func_t>(os::dlsym(RTLD_NEXT, "fchdir"));
 
             return;
         } catch(const os::ExcOs& ex){
@@ -47,6 +51,36 @@ void initSymIfNeeded(){
 }
 
 
+/// Fast paths of the interposed functions: in the common case, nothing is to
+/// be done and we directly call the original function. That requires
+/// the symbols to be initialized, so the first calls take the slow path.
+/// See also event_open::handleOpen, event_process and event_other.
+
+inline bool nothingToDoForOpen(const char *pathname){
+    const ShellFastState& s = g_shellFastState;
+    return s.orig_open != nullptr &&
+            s.watchState != E_WatchState::WITHIN_CMD &&
+            ! shell_request_handler::mayBeTrigger(pathname);
+}
+
+inline bool nothingToDoForFork(){
+    const ShellFastState& s = g_shellFastState;
+    return s.orig_fork != nullptr && s.watchState != E_WatchState::WITHIN_CMD;
+}
+
+inline bool nothingToDoForExecve(){
+    const ShellFastState& s = g_shellFastState;
+    return s.orig_execve != nullptr &&
+            (! s.inSubshell || s.watchState != E_WatchState::WITHIN_CMD);
+}
+
+inline bool nothingToDoForStrcpy(){
+    const ShellFastState& s = g_shellFastState;
+    return s.orig_strcpy != nullptr &&
+            (s.inSubshell || s.watchState != E_WatchState::WITHIN_CMD);
+}
+
+
 } // namespace
 
 #ifdef __cplusplus
@@ -57,6 +91,9 @@ extern "C" {
 LIBSHOURNAL_SHELLWATCH_EXPORT
 int open(const char *pathname, int flags, mode_t mode) {
     // std::cerr << __func__ << "\n";
+    if(nothingToDoForOpen(pathname)){
+        return g_shellFastState.orig_open(pathname, flags, mode);
+    }
     initSymIfNeeded();
     try{
         return event_open::handleOpen(pathname, flags, mode, false);
@@ -70,6 +107,9 @@ int open(const char *pathname, int flags, mode_t mode) {
 LIBSHOURNAL_SHELLWATCH_EXPORT
 int open64(const char *pathname, int flags, mode_t mode) {
     // std::cerr << __func__ << "\n";
+    if(nothingToDoForOpen(pathname)){
+        return g_shellFastState.orig_open(pathname, flags | O_LARGEFILE, mode);
+    }
     initSymIfNeeded();
     try{
         // probably O_LARGEFILE should only be set, if we are running in 32
@@ -117,6 +157,9 @@ int open64(const char *pathname, int flags, mode_t mode) {
 
 LIBSHOURNAL_SHELLWATCH_EXPORT
 pid_t fork(){
+    if(nothingToDoForFork()){
+        return g_shellFastState.orig_fork();
+    }
     initSymIfNeeded();
     try {
         return event_process::handleFork();
@@ -130,6 +173,9 @@ pid_t fork(){
 LIBSHOURNAL_SHELLWATCH_EXPORT
 int execve(const char *filename, char *const argv[],
            char *const envp[]){
+    if(nothingToDoForExecve()){
+        return g_shellFastState.orig_execve(filename, argv, envp);
+    }
     initSymIfNeeded();
     try {
         return event_process::handleExecve(filename, argv, envp);
@@ -142,6 +188,9 @@ int execve(const char *filename, char *const argv[],
 
 LIBSHOURNAL_SHELLWATCH_EXPORT
 char *strcpy(char *dest, const char *src){
+    if(nothingToDoForStrcpy()){
+        return g_shellFastState.orig_strcpy(dest, src);
+    }
     initSymIfNeeded();
     try {
         return event_other::handleStrcpy(dest, src);
@@ -151,6 +200,21 @@ char *strcpy(char *dest, const char *src){
     return ShellGlobals::instance().orig_strcpy(dest, src);
 }
 
+
+LIBSHOURNAL_SHELLWATCH_EXPORT
+int chdir(const char *path){
+    initSymIfNeeded();
+    return event_open::handleChdir(path);
+}
+
+
+LIBSHOURNAL_SHELLWATCH_EXPORT
+int fchdir(int fd){
+    initSymIfNeeded();
+    return event_open::handleFchdir(fd);
+}
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,12 +1,20 @@
 #include "shell_globals.h"
 
+ShellFastState g_shellFastState {};
+
 ShellGlobals &ShellGlobals::instance()
 {
     static ShellGlobals s;
     return s;
 }
 
-ShellGlobals::ShellGlobals()
+ShellGlobals::ShellGlobals() :
+    orig_fork(g_shellFastState.orig_fork),
+    orig_execve(g_shellFastState.orig_execve),
+    orig_open(g_shellFastState.orig_open),
+    orig_strcpy(g_shellFastState.orig_strcpy),
+    watchState(g_shellFastState.watchState),
+    inSubshell(g_shellFastState.inSubshell)
 {
      ignoreEvents.clear();
      ignoreSigation.clear();
@@ -3,6 +3,7 @@
 #include <csignal>
 #include <sched.h>
 #include <atomic>
+#include <string>
 #include <QByteArray>
 #include <QDateTime>
 #include <mutex>
@@ -20,11 +21,30 @@ typedef int (*execve_func_t)(const char *filename, char *const argv[],
 
 typedef int (*open_func_t)(const char *pathname, int flags, mode_t mode);
 typedef char * (*strcpy_func_t)(char *, const char*);
+typedef int (*chdir_func_t)(const char *path);
+typedef int (*fchdir_func_t)(int fd);
 
 
 enum class E_WatchState {DISABLED, WITHIN_CMD, INTERMEDIATE, ENUM_END};
 
 
+/// State needed by the interposed functions to decide, whether there is
+/// anything to do at all. It is a plain, constant-initialized global, so it
+/// is valid even before any static constructor ran and accessing it does not
+/// need a guarded function-local static (see ShellGlobals::instance()).
+/// Note that E_WatchState::DISABLED is zero.
+struct ShellFastState {
+    fork_func_t orig_fork;
+    execve_func_t orig_execve;
+    open_func_t orig_open;
+    strcpy_func_t orig_strcpy;
+    E_WatchState watchState;
+    bool inSubshell;
+};
+
+extern ShellFastState g_shellFastState;
+
+
 class ShellGlobals
 {
 
@@ -32,15 +52,18 @@ public:
     static ShellGlobals& instance();
 
     int shournalSocketNb {-1};
-    fork_func_t orig_fork {};
-    execve_func_t orig_execve {};
-    open_func_t orig_open {};
-    strcpy_func_t orig_strcpy {};
+    // stored in g_shellFastState
+    fork_func_t& orig_fork;
+    execve_func_t& orig_execve;
+    open_func_t& orig_open;
+    strcpy_func_t& orig_strcpy;
+    chdir_func_t orig_chdir {};
+    fchdir_func_t orig_fchdir {};
 
     std::atomic_flag ignoreEvents{};
 
-    E_WatchState watchState {E_WatchState::DISABLED};
-    bool inSubshell {false};
+    E_WatchState& watchState;
+    bool& inSubshell;
     fdcommunication::SocketCommunication shournalSocket;
     pid_t lastMountNamespacePid {-1};
 
@@ -53,6 +76,11 @@ public:
 
     SessionInfo sessionInfo;
     int shournalRootDirFd {-1};
+    bool sessionObserver {false}; // shournalSocket belongs to a session observer
+    int standbyObserverSockFd {-1}; // already launched observer for the next command
+    QByteArray standbyObserverCwd; // working directory at launch of the standby observer
+    std::string cachedCwd; // with trailing '/', empty if unknown (see event_open)
+    std::string absPathBuf; // reused for relative paths (see event_open)
 
     QDateTime lastCmdStartTime {};
 
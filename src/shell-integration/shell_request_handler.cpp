@@ -30,6 +30,7 @@
 #include "socket_message.h"
 #include "interrupt_handler.h"
 #include "conversions.h"
+#include "observer_daemon_socket.h"
 
 using socket_message::E_SocketMsg;
 using socket_message::socketMsgToStr;
@@ -153,8 +154,60 @@ int verbose_findHighestFreeFd(int startFd=-1){
 }
 
 
-/// Launch external shournal (detached) and wait for it to finish unsharing
-/// the mount-NS and fanotify-marking the mounts. Since it is called in a new session
+void verboseCloseShournalSocket(){
+    auto& g_shell = ShellGlobals::instance();
+    if(g_shell.shournalSocket.sockFd() >= 0 &&
+            close(g_shell.shournalSocket.sockFd()) == -1){
+        logWarning << "close of shournal-socket failed:"
+                   << translation::strerror_l();
+
+    }
+    g_shell.shournalSocket.setSockFd(-1);
+}
+
+void verboseCloseRootDirFd(){
+    auto& g_shell = ShellGlobals::instance();
+    if(g_shell.shournalRootDirFd >= 0 &&
+            close(g_shell.shournalRootDirFd) == -1){
+        logWarning << "close of shournal-root dir-fd failed:"
+                   << translation::strerror_l();
+
+    }
+    g_shell.shournalRootDirFd = -1;
+}
+
+
+void closeSessionObserver(){
+    auto& g_shell = ShellGlobals::instance();
+    verboseCloseShournalSocket();
+    verboseCloseRootDirFd();
+    g_shell.sessionObserver = false;
+}
+
+/// Announce the next command to the already running session observer and
+/// wait for its reply, so no file event of the command is discarded.
+/// @return false, if the session observer is not usable (anymore).
+bool beginCommandInSessionObserver(){
+    auto& g_shell = ShellGlobals::instance();
+    try {
+        const auto workingDir = os::readlink<QByteArray>("/proc/self/cwd");
+        g_shell.shournalSocket.sendMsg({int(E_SocketMsg::BEGIN_COMMAND), workingDir});
+        const auto messages = g_shell.shournalSocket.receiveMessages();
+        if(messages.size() == 1 &&
+                messages.first().msgId == int(E_SocketMsg::BEGIN_COMMAND)){
+            return true;
+        }
+        logWarning << qtr("The session observer (%1) did not acknowledge the command, "
+                          "launching a new one.").arg(app::SHOURNAL_RUN);
+    } catch (const std::exception& e) {
+        logWarning << qtr("Failed to reach the session observer (%1): %2. "
+                          "Launching a new one.").arg(app::SHOURNAL_RUN, e.what());
+    }
+    return false;
+}
+
+
+/// Launch external shournal (detached). Since it is called in a new session
 /// (setsid), it survives the parent shell (*this process), furhter it receives no sigint, destinated
 /// for our shell, which could have caused it to terminate even before installing a SIGIGN-handler.
 /// Pass a socket to shournal, which is used for communication *and* to stop it
@@ -162,137 +215,336 @@ int verbose_findHighestFreeFd(int startFd=-1){
 /// all of them finished *and* we cleaned up (or died), external shournal stops.
 /// Note that for processes, which close passed file-descriptors
 /// before exit, shournal might quit too early, in which case file modfication events
-/// are lost
-void handlePrepareCmd(){
-    updateVerbosityFromEnv();
+/// are lost.
+/// @return our end of the socket
+/// @throws ExcOs
+int launchObserver(bool sessionObserver){
     auto& g_shell = ShellGlobals::instance();
-    if(g_shell.watchState == E_WatchState::WITHIN_CMD){
-        // Happens e.g. if a previous cleanup request was ignored due to
-        // an invalid command.
-        logDebug << "Received setup-request while shell observation "
-                                   "was already enabled (might be ok).";
-        return;
+    auto sockets = os::socketpair(PF_UNIX, SOCK_STREAM);
+
+    auto autocloseSocket0 = finally([&sockets] { close(sockets[0]); });
+    auto autocloseSocket1 = finally([&sockets] { close(sockets[1]); });
+
+    subprocess::Args_t args = {
+        app::SHOURNAL_RUN,
+        "--socket-fd", std::to_string(sockets[0]),
+        "--verbosity", logger::msgTypeToStr(g_shell.verbosityLevel),
+        "--shell-session-uuid", g_shell.sessionInfo.uuid.toBase64().data()
+    };
+    if(sessionObserver){
+        args.push_back("--session");
     }
 
-    if(! loadSettings()){
-        return;
+    subprocess::Subprocess subproc;
+    subproc.setInNewSid(true); // Survive parent shell exit
+    // Pass the socket to the external shournal process for communication purposes.
+    std::unordered_set<int> forwardFs {sockets[0]};
+    if(app::inIntegrationTestMode()){
+        // forward a pipe to async shournal so integration-test knows when it finished
+        const char* pipeFdStr = getenv("_SHOURNAL_INTEGRATION_TEST_PIPE_FD");
+        if(pipeFdStr == nullptr){
+            QIErr() << "app is set to integration test mode, but pipe-fd is not set...";
+        } else {
+            int pipeFd = qVariantTo_throw<int>(QByteArray(pipeFdStr));
+            if(! osutil::fdIsOpen(pipeFd)){
+                QIErr() << "_SHOURNAL_INTEGRATION_TEST_PIPE_FD set in env "
+                           "but fd" << pipeFd <<  "is not open";
+            } else {
+                forwardFs.insert(pipeFd);
+            }
+        }
     }
 
-    g_shell.shournalSocket.setSockFd(-1);
+    subproc.setForwardFdsOnExec(forwardFs);
+    subproc.call(args);
 
-    try {
-        g_shell.shournalSocketNb = verbose_findHighestFreeFd();
-        if( g_shell.shournalSocketNb == -1){
-            return;
-        }
-        g_shell.shournalRootDirFd = verbose_findHighestFreeFd(g_shell.shournalSocketNb - 1);
-        if( g_shell.shournalRootDirFd == -1){
-            return;
-        }
+    os::close(sockets[0]);
+    autocloseSocket0.setEnabled(false);
+    autocloseSocket1.setEnabled(false);
+    return sockets[1];
+}
 
-        auto sockets = os::socketpair(PF_UNIX, SOCK_STREAM);
 
-        auto autocloseSocket0 = finally([&sockets] { close(sockets[0]); });
-        auto autocloseSocket1 = finally([&sockets] { close(sockets[1]); });
+/// Wait for the external shournal behind sockFd to finish unsharing
+/// the mount-NS and fanotify-marking the mounts and make it the observer
+/// of the next command. sockFd is closed or taken over in any case.
+/// @return true on success
+/// @throws ExcOs
+bool adoptObserver(int sockFd, bool sessionObserver){
+    auto& g_shell = ShellGlobals::instance();
+    auto autocloseSocket = finally([&sockFd] { close(sockFd); });
 
+    const int socketNb = verbose_findHighestFreeFd();
+    if(socketNb == -1){
+        return false;
+    }
+    const int rootDirFd = verbose_findHighestFreeFd(socketNb - 1);
+    if(rootDirFd == -1){
+        return false;
+    }
 
-        subprocess::Args_t args = {
-            app::SHOURNAL_RUN,
-            "--socket-fd", std::to_string(sockets[0]),
-            "--verbosity", logger::msgTypeToStr(g_shell.verbosityLevel),
-            "--shell-session-uuid", g_shell.sessionInfo.uuid.toBase64().data()
-        };
+    g_shell.lastMountNamespacePid = -1;
+    // wait for reply from shournal
+    g_shell.shournalSocket.setReceiveBufferSize(100);
+    g_shell.shournalSocket.setSockFd(sockFd);
+    auto messages=g_shell.shournalSocket.receiveMessages();
+    g_shell.shournalSocket.setSockFd(-1);
+    if(messages.size() != 1 ){
+        logCritical << qtr("Setup of external %1-process failed: "
+                           "expected one message but received %2")
+                            .arg(app::SHOURNAL_RUN)
+                            .arg(messages.size());
+        return false;
+    }
+    auto& socketMsg = messages.first();
+
+    if( E_SocketMsg(socketMsg.msgId) != E_SocketMsg::SETUP_DONE){
+        QString msg = (socketMsg.msgId < 0 || socketMsg.msgId >= int(E_SocketMsg::ENUM_END))
+                                   ? qtr("Bad response")
+                                   : socketMsgToStr(E_SocketMsg(socketMsg.msgId));
+
+        logCritical << qtr("Setup of external %1-process failed, "
+                           "received message: %2 (%3)")
+                       .arg(app::SHOURNAL_RUN)
+                       .arg(msg)
+                       .arg(int(socketMsg.msgId));
+        return false;
+    }
 
+    g_shell.lastMountNamespacePid = varFromQBytes(socketMsg.bytes,
+                                                  static_cast<pid_t>(-1));
+    assert(socketMsg.fd != -1);
 
-        g_shell.lastMountNamespacePid = -1;
-        subprocess::Subprocess subproc;
-        subproc.setInNewSid(true); // Survive parent shell exit
-        // Pass the socket to the external shournal process for communication purposes.
-        std::unordered_set<int> forwardFs {sockets[0]};
-        if(app::inIntegrationTestMode()){
-            // forward a pipe to async shournal so integration-test knows when it finished
-            const char* pipeFdStr = getenv("_SHOURNAL_INTEGRATION_TEST_PIPE_FD");
-            if(pipeFdStr == nullptr){
-                QIErr() << "app is set to integration test mode, but pipe-fd is not set...";
-            } else {
-                int pipeFd = qVariantTo_throw<int>(QByteArray(pipeFdStr));
-                if(! osutil::fdIsOpen(pipeFd)){
-                    QIErr() << "_SHOURNAL_INTEGRATION_TEST_PIPE_FD set in env "
-                               "but fd" << pipeFd <<  "is not open";
-                } else {
-                    forwardFs.insert(pipeFd);
-                }
-            }
+    if(socketMsg.fd != rootDirFd){
+        os::dup2(socketMsg.fd, rootDirFd);
+        os::close(socketMsg.fd);
+    }
+    g_shell.shournalRootDirFd = rootDirFd;
+    auto RootDirFlags = os::getFdDescriptorFlags(g_shell.shournalRootDirFd);
+    setBitIn(RootDirFlags, FD_CLOEXEC);
+    os::setFdDescriptorFlags(g_shell.shournalRootDirFd, RootDirFlags);
+
+    autocloseSocket.setEnabled(false);
+    if(sockFd != socketNb ){
+        // dup2 and close orig. Note that dup2 also clears FD_CLOEXEC
+        // of a standby socket, so the commands inherit it.
+        try {
+            os::dup2(sockFd, socketNb);
+            close(sockFd);
+        } catch (const os::ExcOs& ex) {
+            logCritical << "duplicating to shournal-wait-fd failed: "
+                        << ex.what();
+            close(sockFd);
+            verboseCloseRootDirFd();
+            return false;
         }
+    }
+    g_shell.shournalSocketNb = socketNb;
+    g_shell.shournalSocket.setSockFd(g_shell.shournalSocketNb);
+    g_shell.shournalSockFdDescripFlags = os::getFdDescriptorFlags(g_shell.shournalSocketNb);
+
+    g_shell.sessionObserver = sessionObserver;
+    g_shell.cachedCwd.clear();
+    g_shell.watchState = E_WatchState::WITHIN_CMD;
+    shell_logger::flushBufferdMessages();
+    return true;
+}
 
-        subproc.setForwardFdsOnExec(forwardFs);
-        subproc.call(args);
-
-        os::close(sockets[0]);
-        autocloseSocket0.setEnabled(false);
 
-        // avoid deadlock: close our write end
-        // wait for reply from shournal
-        g_shell.shournalSocket.setReceiveBufferSize(100);
-        g_shell.shournalSocket.setSockFd(sockets[1]);
+void closeStandbyObserver(){
+    auto& g_shell = ShellGlobals::instance();
+    if(g_shell.standbyObserverSockFd >= 0 &&
+            close(g_shell.standbyObserverSockFd) == -1){
+        logWarning << "close of the standby observer socket failed:"
+                   << translation::strerror_l();
+    }
+    g_shell.standbyObserverSockFd = -1;
+    g_shell.standbyObserverCwd.clear();
+}
 
 
-        auto messages=g_shell.shournalSocket.receiveMessages();
-        if(messages.size() != 1 ){
-            logCritical << qtr("Setup of external %1-process failed: "
-                               "expected one message but received %2")
-                                .arg(app::SHOURNAL_RUN)
-                                .arg(messages.size());
+/// Launch the observer of the next command right after the previous one
+/// finished, so its setup happens while the user types. Since it is not
+/// told about the command, it must be adopted from the same working directory.
+void launchStandbyObserverIfConfigured(){
+    auto& g_shell = ShellGlobals::instance();
+    if(g_shell.watchState != E_WatchState::INTERMEDIATE ||
+            g_shell.sessionObserver ||
+            g_shell.standbyObserverSockFd != -1 ||
+            ! Settings::instance().standbyObserver()){
+        return;
+    }
+    try {
+        const int sockFd = launchObserver(false);
+        auto autocloseSocket = finally([&sockFd] { close(sockFd); });
+        // keep it away from the low fd numbers used by the shell and scripts
+        const int standbyFd = verbose_findHighestFreeFd();
+        if(standbyFd == -1){
             return;
         }
-        auto& socketMsg = messages.first();
+        os::dup2(sockFd, standbyFd);
+        g_shell.standbyObserverSockFd = standbyFd;
+        // not inherited by the commands until adopted
+        auto flags = os::getFdDescriptorFlags(standbyFd);
+        setBitIn(flags, FD_CLOEXEC);
+        os::setFdDescriptorFlags(standbyFd, flags);
+        g_shell.standbyObserverCwd = os::readlink<QByteArray>("/proc/self/cwd");
+    } catch (const std::exception& e) {
+        logWarning << qtr("Failed to launch a standby observer (%1): %2")
+                      .arg(app::SHOURNAL_RUN, e.what());
+        closeStandbyObserver();
+    }
+}
 
 
-        if( E_SocketMsg(socketMsg.msgId) != E_SocketMsg::SETUP_DONE){
-            QString msg = (socketMsg.msgId < 0 || socketMsg.msgId >= int(E_SocketMsg::ENUM_END))
-                                       ? qtr("Bad response")
-                                       : socketMsgToStr(E_SocketMsg(socketMsg.msgId));
+/// @return true, if the standby observer was adopted. Otherwise
+/// it is discarded.
+bool adoptStandbyObserver(){
+    auto& g_shell = ShellGlobals::instance();
+    QByteArray workingDir;
+    try {
+        workingDir = os::readlink<QByteArray>("/proc/self/cwd");
+    } catch (const os::ExcOs& e) {
+        logWarning << e.what();
+    }
+    if(workingDir.isEmpty() || workingDir != g_shell.standbyObserverCwd){
+        // the observer reports its own working directory as the one of the command
+        logDebug << "working directory changed, discarding the standby observer";
+        closeStandbyObserver();
+        return false;
+    }
+    const int sockFd = g_shell.standbyObserverSockFd;
+    g_shell.standbyObserverSockFd = -1;
+    g_shell.standbyObserverCwd.clear();
+    try {
+        return adoptObserver(sockFd, false);
+    } catch (const std::exception& e) {
+        logWarning << qtr("Failed to adopt the standby observer (%1): %2. "
+                          "Launching a new one.").arg(app::SHOURNAL_RUN, e.what());
+    }
+    return false;
+}
 
-            logCritical << qtr("Setup of external %1-process failed, "
-                               "received message: %2 (%3)")
-                           .arg(app::SHOURNAL_RUN)
-                           .arg(msg)
-                           .arg(int(socketMsg.msgId));
-            return;
-        }
 
-        g_shell.lastMountNamespacePid = varFromQBytes(socketMsg.bytes,
-                                                      static_cast<pid_t>(-1));
-        assert(socketMsg.fd != -1);
+/// Register a new session at the observer daemon (see shournal-run --daemon)
+/// by passing one end of a socketpair, which the daemon then serves like the
+/// socket of a session observer launched by launchObserver.
+/// @return our end of the socket or -1, if no daemon is running
+/// @throws ExcOs
+int registerAtObserverDaemon(){
+    auto& g_shell = ShellGlobals::instance();
+    const int daemonFd = observer_daemon_socket::connect();
+    if(daemonFd == -1){
+        logDebug << "observer daemon not reachable:" << translation::strerror_l();
+        return -1;
+    }
+    auto autocloseDaemonFd = finally([&daemonFd] { close(daemonFd); });
+
+    auto sockets = os::socketpair(PF_UNIX, SOCK_STREAM);
+    auto autocloseSocket0 = finally([&sockets] { close(sockets[0]); });
+    auto autocloseSocket1 = finally([&sockets] { close(sockets[1]); });
+    SocketCommunication daemonCom;
+    daemonCom.setSockFd(daemonFd);
+    daemonCom.sendMsg({int(E_SocketMsg::REGISTER_SESSION),
+                       g_shell.sessionInfo.uuid, sockets[0]});
+    autocloseSocket1.setEnabled(false);
+    return sockets[1];
+}
+
+
+/// Launch the observer daemon (detached) which serves the following
+/// shell sessions. It exits by itself, if another one is running already.
+/// @throws ExcOs
+void launchObserverDaemon(){
+    auto& g_shell = ShellGlobals::instance();
+    subprocess::Args_t args = {
+        app::SHOURNAL_RUN,
+        "--daemon",
+        "--verbosity", logger::msgTypeToStr(g_shell.verbosityLevel)
+    };
+    subprocess::Subprocess subproc;
+    subproc.setInNewSid(true); // Survive parent shell exit
+    // do not leave a zombie, the daemon outlives its launching command
+    subproc.callDetached(args);
+}
+
 
-        if(socketMsg.fd != g_shell.shournalRootDirFd){
-            os::dup2(socketMsg.fd, g_shell.shournalRootDirFd);
-            os::close(socketMsg.fd);
+/// Let the observer daemon observe this session like a session observer.
+/// If no daemon is running, launch it for the following sessions, while this
+/// one is observed by a session observer of its own.
+/// @return true, if the daemon observes the session
+bool adoptDaemonSession(){
+    auto& g_shell = ShellGlobals::instance();
+    try {
+        const int sockFd = registerAtObserverDaemon();
+        if(sockFd == -1){
+            launchObserverDaemon();
+            return false;
+        }
+        if(! adoptObserver(sockFd, true)){
+            return false;
         }
-        auto RootDirFlags = os::getFdDescriptorFlags(g_shell.shournalRootDirFd);
-        setBitIn(RootDirFlags, FD_CLOEXEC);
-        os::setFdDescriptorFlags(g_shell.shournalRootDirFd, RootDirFlags);
+        // The daemon does not know our working directory yet, so begin
+        // the first command explicitly.
+        if(beginCommandInSessionObserver()){
+            g_shell.cachedCwd.clear();
+            return true;
+        }
+    } catch (const std::exception& e) {
+        logWarning << qtr("Failed to use the observer daemon (%1 --daemon): %2")
+                      .arg(app::SHOURNAL_RUN, e.what());
+    }
+    closeSessionObserver();
+    g_shell.watchState = E_WatchState::INTERMEDIATE;
+    return false;
+}
 
-        autocloseSocket1.setEnabled(false);
-        if(sockets[1] != g_shell.shournalSocketNb ){
-            // dup2 and close orig
-            try {
-                os::dup2(sockets[1], g_shell.shournalSocketNb);
-                close(sockets[1]);
-            } catch (const os::ExcOs& ex) {
-                logCritical << "duplicating to shournal-wait-fd failed: "
-                            << ex.what();
-                close(sockets[1]);
-                return;
-            }
+
+/// Launch external shournal or adopt the standby observer and wait for
+/// it to finish its setup, see launchObserver and adoptObserver.
+/// If configured, the external shournal is kept as session observer for the
+/// following commands, so only a single round trip is needed per command.
+/// The session observer may also be hosted by the observer daemon.
+void handlePrepareCmd(){
+    updateVerbosityFromEnv();
+    auto& g_shell = ShellGlobals::instance();
+    if(g_shell.watchState == E_WatchState::WITHIN_CMD){
+        // Happens e.g. if a previous cleanup request was ignored due to
+        // an invalid command.
+        logDebug << "Received setup-request while shell observation "
+                                   "was already enabled (might be ok).";
+        return;
+    }
+
+    if(! loadSettings()){
+        return;
+    }
+
+    if(g_shell.sessionObserver){
+        if(beginCommandInSessionObserver()){
+            g_shell.cachedCwd.clear();
+            g_shell.watchState = E_WatchState::WITHIN_CMD;
+            shell_logger::flushBufferdMessages();
+            return;
         }
-        g_shell.shournalSocket.setSockFd(g_shell.shournalSocketNb);
-        g_shell.shournalSockFdDescripFlags = os::getFdDescriptorFlags(g_shell.shournalSocketNb);
+        closeSessionObserver();
+    }
 
-        g_shell.watchState = E_WatchState::WITHIN_CMD;
-        shell_logger::flushBufferdMessages();
+    g_shell.shournalSocket.setSockFd(-1);
 
+    if(g_shell.standbyObserverSockFd != -1 && adoptStandbyObserver()){
         return;
+    }
+
+    try {
+        const bool sessionObserver = Settings::instance().sessionObserver();
+        if(sessionObserver && Settings::instance().observerDaemon() &&
+                adoptDaemonSession()){
+            return;
+        }
+        if(adoptObserver(launchObserver(sessionObserver), sessionObserver)){
+            return;
+        }
     } catch(const os::ExcOs& ex){
         logCritical << ex.what();
     } catch (const std::exception& e) {
@@ -350,29 +602,6 @@ ShellRequest readCheckShellUpdateRequest(){
     return shellRequest;
 }
 
-void verboseCloseShournalSocket(){
-    auto& g_shell = ShellGlobals::instance();
-    if(g_shell.shournalSocket.sockFd() >= 0 &&
-            close(g_shell.shournalSocket.sockFd()) == -1){
-        logWarning << "close of shournal-socket failed:"
-                   << translation::strerror_l();
-
-    }
-    g_shell.shournalSocket.setSockFd(-1);
-}
-
-void verboseCloseRootDirFd(){
-    auto& g_shell = ShellGlobals::instance();
-    if(g_shell.shournalRootDirFd >= 0 &&
-            close(g_shell.shournalRootDirFd) == -1){
-        logWarning << "close of shournal-root dir-fd failed:"
-                   << translation::strerror_l();
-
-    }
-    g_shell.shournalRootDirFd = -1;
-}
-
-
 void handleDisableRequest(){
     auto& g_shell = ShellGlobals::instance();
     if(g_shell.watchState == E_WatchState::DISABLED){
@@ -382,8 +611,8 @@ void handleDisableRequest(){
     }
     g_shell.watchState = E_WatchState::DISABLED;
 
-    verboseCloseShournalSocket();
-    verboseCloseRootDirFd();
+    closeSessionObserver();
+    closeStandbyObserver();
 }
 
 
@@ -401,7 +630,11 @@ void handleCleanupCmd(){
         // Clear possible events mich might have had occurred meanwhile, e.g. because
         // of autocompletion.
         if(g_shell.watchState == E_WatchState::WITHIN_CMD){
-            g_shell.shournalSocket.sendMsg(int(E_SocketMsg::CLEAR_EVENTS));
+            try {
+                g_shell.shournalSocket.sendMsg(int(E_SocketMsg::CLEAR_EVENTS));
+            } catch (const os::ExcOs& e) {
+                logWarning << e.what();
+            }
         }
         return;
     }
@@ -416,10 +649,13 @@ void handleCleanupCmd(){
         return;
     }
 
+    // A session observer is kept for the next command
     auto finalActions = finally([&g_shell] {
         g_shell.watchState = E_WatchState::INTERMEDIATE;
-        verboseCloseShournalSocket();
-        verboseCloseRootDirFd();
+        if(! g_shell.sessionObserver){
+            verboseCloseShournalSocket();
+            verboseCloseRootDirFd();
+        }
     });
 
     QByteArray lastCommand = getenv("_SHOURNAL_LAST_COMMAND");
@@ -445,7 +681,16 @@ void handleCleanupCmd(){
                 Conversions::dateIsoFormatWithMilliseconds()).toUtf8();
     messages.push_back({int(E_SocketMsg::CMD_START_DATETIME), cmdStartDateTime});
     messages.push_back({int(E_SocketMsg::RETURN_VALUE), qBytesFromVar(returnVal)});
-    g_shell.shournalSocket.sendMessages(messages);
+    if(g_shell.sessionObserver){
+        messages.push_back({int(E_SocketMsg::END_COMMAND)});
+    }
+    try {
+        g_shell.shournalSocket.sendMessages(messages);
+    } catch (const os::ExcOs& e) {
+        logWarning << qtr("Failed to send the command to %1: %2")
+                      .arg(app::SHOURNAL_RUN, e.what());
+        closeSessionObserver();
+    }
 }
 
 
@@ -562,6 +807,7 @@ bool shell_request_handler::checkForTriggerAndHandle(){
         break;
     case ShellRequest::CLEANUP_CMD:
         handleCleanupCmd();
+        launchStandbyObserverIfConfigured();
         break;
     case ShellRequest::PRINT_VERSION:
         QErr() << "libshournal-shellwatch.so version " << app::version().toString() << "\n";
@@ -1,7 +1,16 @@
 #pragma once
 
 
+#include <cstring>
+
 namespace shell_request_handler  {
     bool checkForTriggerAndHandle();
+
+    /// The shell-integration sets the trigger-variable and then opens
+    /// /dev/null (see _shournal_trigger_update), so the environment
+    /// only needs to be checked for the trigger on such opens.
+    inline bool mayBeTrigger(const char* pathname){
+        return pathname[0] == '/' && strcmp(pathname, "/dev/null") == 0;
+    }
 }
 
@@ -0,0 +1,331 @@
+
+/* Lightweight variant of 'shournal-run --msenter', which the shell-integration
+ * runs before *every* observed exec, so it must start fast: no Qt, no
+ * argument parser, no config and usually no NSS-lookup.
+ * Usage:
+ * shournal-msenter <target-pid> [NAME=VALUE ...] -- <filename> <argv0> [args...]
+ * The environment is passed through unchanged. Only the variables which
+ * the dynamic loader removes for setuid-programs (LD_PRELOAD, TMPDIR, ...)
+ * are passed as NAME=VALUE before '--' and restored before the exec.
+ * The permission checks are the same as in shournal-run (see msenter.cpp):
+ * the target process must belong to the real user and to the group
+ * SHOURNAL_MSENTERGROUP, whose gid is cached in a root-owned file. The cache
+ * is only valid as long as /etc/group is unchanged.
+ * */
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <grp.h>
+#include <sched.h>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+namespace {
+
+const char* MSENTER_ONLY_GROUP = SHOURNAL_MSENTERGROUP; // defined in cmake
+const char* GID_CACHE_DIR = "/run/shournal";
+const char* GID_CACHE_PATH = "/run/shournal/msenter-gid";
+const char* GROUP_FILE_PATH = "/etc/group";
+
+void printErr(const char* msg, int err=0){
+    if(err == 0){
+        fprintf(stderr, "shournal-msenter: %s\n", msg);
+    } else {
+        fprintf(stderr, "shournal-msenter: %s: %s\n", msg, strerror(err));
+    }
+}
+
+[[noreturn]]
+void die(const char* msg, int err=0){
+    printErr(msg, err);
+    exit(1);
+}
+
+int pidfdOpen(pid_t pid){
+#ifdef __NR_pidfd_open
+    return static_cast<int>(syscall(__NR_pidfd_open, pid, 0U));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+bool pidfdIsAlive(int pidfd){
+#ifdef __NR_pidfd_send_signal
+    return syscall(__NR_pidfd_send_signal, pidfd, 0, nullptr, 0U) == 0;
+#else
+    (void)pidfd;
+    return false;
+#endif
+}
+
+/// The cache is keyed on inode and mtime of the group file, so it becomes
+/// stale once a group is added, renamed or its gid changed. A failed stat
+/// yields a key which never matches.
+std::string groupFileKey(){
+    struct stat st;
+    if(stat(GROUP_FILE_PATH, &st) != 0){
+        return std::string();
+    }
+    return std::to_string(st.st_ino) + ' ' + std::to_string(st.st_mtim.tv_sec) + ' ' +
+           std::to_string(st.st_mtim.tv_nsec);
+}
+
+/// Only trust a cache which only root may have written and which was
+/// written for the current group file (see groupFileKey).
+bool readCachedGid(gid_t* gid){
+    const int fd = open(GID_CACHE_PATH, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if(fd == -1){
+        return false;
+    }
+    struct stat st;
+    char buf[128];
+    ssize_t len = -1;
+    if(fstat(fd, &st) == 0 && st.st_uid == 0 &&
+            (st.st_mode & (S_IWGRP | S_IWOTH)) == 0){
+        len = read(fd, buf, sizeof (buf) - 1);
+    }
+    close(fd);
+    if(len <= 0){
+        return false;
+    }
+    buf[len] = '\0';
+    char* end;
+    errno = 0;
+    const unsigned long val = strtoul(buf, &end, 10);
+    if(errno != 0 || end == buf || *end != ' '){
+        return false;
+    }
+    const std::string key = groupFileKey();
+    char* keyEnd = strchr(end + 1, '\n');
+    if(key.empty() || keyEnd == nullptr || key != std::string(end + 1, keyEnd)){
+        return false;
+    }
+    *gid = static_cast<gid_t>(val);
+    return true;
+}
+
+/// Atomically replace the cache. Fails silently, e.g. if we are not setuid.
+/// @param groupKey: the key of the group file before the lookup of gid
+void writeCachedGid(gid_t gid, const std::string& groupKey){
+    if(geteuid() != 0 || groupKey.empty()){
+        return;
+    }
+    mkdir(GID_CACHE_DIR, 0755);
+    struct stat st;
+    if(lstat(GID_CACHE_DIR, &st) != 0 || ! S_ISDIR(st.st_mode) || st.st_uid != 0){
+        return;
+    }
+    const std::string tmpPath = std::string(GID_CACHE_PATH) + '.' + std::to_string(getpid());
+    const int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                        0644);
+    if(fd == -1){
+        return;
+    }
+    const std::string content = std::to_string(gid) + ' ' + groupKey + '\n';
+    const bool ok = write(fd, content.c_str(), content.size()) == ssize_t(content.size());
+    close(fd);
+    if(! ok || rename(tmpPath.c_str(), GID_CACHE_PATH) != 0){
+        unlink(tmpPath.c_str());
+    }
+}
+
+/// @return true, if targetGid is the gid of MSENTER_ONLY_GROUP. The
+/// NSS-lookup is only performed, if the cache is missing or differs.
+bool isMsenterGid(gid_t targetGid){
+    gid_t cachedGid;
+    if(readCachedGid(&cachedGid) && cachedGid == targetGid){
+        return true;
+    }
+    // if the group file changes during the lookup, the next call sees a new key
+    const std::string groupKey = groupFileKey();
+    const struct group* groupInfo = getgrnam(MSENTER_ONLY_GROUP);
+    if(groupInfo == nullptr){
+        fprintf(stderr, "shournal-msenter: group %s does not exist on your "
+                        "system but is required. Please add it.\n", MSENTER_ONLY_GROUP);
+        exit(1);
+    }
+    writeCachedGid(groupInfo->gr_gid, groupKey);
+    return groupInfo->gr_gid == targetGid;
+}
+
+/// setns changes the working directory. Reenter it by path, which is checked
+/// to refer to the same directory (see also osutil::reopenFdByPath).
+void reenterWorkingDir(int oldWdFd){
+    const std::string fdPath = "/proc/self/fd/" + std::to_string(oldWdFd);
+    char path[PATH_MAX];
+    const ssize_t len = readlink(fdPath.c_str(), path, sizeof (path) - 1);
+    int newWdFd = -1;
+    if(len > 0){
+        path[len] = '\0';
+        newWdFd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    struct stat oldSt;
+    struct stat newSt;
+    if(newWdFd != -1 && fstat(oldWdFd, &oldSt) == 0 && fstat(newWdFd, &newSt) == 0 &&
+            oldSt.st_dev == newSt.st_dev && oldSt.st_ino == newSt.st_ino &&
+            fchdir(newWdFd) == 0){
+        close(newWdFd);
+        return;
+    }
+    // Should almost never happen. File-events, referring to relative
+    // paths might be lost.
+    printErr("Failed to enter the working directory within the new mount-namespace. "
+             "Entering the original one instead. Some file-events might be lost.");
+    if(newWdFd != -1){
+        close(newWdFd);
+    }
+    if(fchdir(oldWdFd) == -1){
+        printErr("fchdir failed", errno);
+    }
+}
+
+/// Join the mount namespace of the target. Prefer the pidfd (Linux 5.8),
+/// which also rules out that the pid was reused after the permission check.
+/// @return false on error (errno is set)
+bool joinMountNs(int pidfd, int targetprocDirFd){
+    if(pidfd != -1){
+        if(setns(pidfd, CLONE_NEWNS) == 0){
+            return true;
+        }
+        if(errno != EINVAL){
+            return false;
+        }
+    }
+    const int mntFd = openat(targetprocDirFd, "ns/mnt", O_RDONLY | O_CLOEXEC);
+    if(mntFd == -1){
+        return false;
+    }
+    const int ret = setns(mntFd, CLONE_NEWNS);
+    const int err = errno;
+    close(mntFd);
+    errno = err;
+    return ret == 0;
+}
+
+[[noreturn]]
+void usage(){
+    die("usage: shournal-msenter <target-pid> [NAME=VALUE ...] -- "
+        "<filename> <argv0> [args...]");
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+    if(argc < 4){
+        usage();
+    }
+    char* end;
+    errno = 0;
+    const long targetPid = strtol(argv[1], &end, 10);
+    if(errno != 0 || *end != '\0' || targetPid <= 0){
+        usage();
+    }
+    int sepIdx = 2;
+    while(sepIdx < argc && strcmp(argv[sepIdx], "--") != 0){
+        sepIdx++;
+    }
+    if(sepIdx + 2 >= argc){
+        usage();
+    }
+    const char* filename = argv[sepIdx + 1];
+    char** commandArgv = argv + sepIdx + 2;
+
+    const uid_t realUid = getuid();
+
+    // pidfd first: if the process still lives after opening its proc-dir,
+    // both refer to the same process.
+    const int pidfd = pidfdOpen(static_cast<pid_t>(targetPid));
+    const std::string procPath = "/proc/" + std::to_string(targetPid);
+    const int targetprocDirFd = open(procPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(targetprocDirFd == -1){
+        die("Failed to open the target process", errno);
+    }
+    if(pidfd != -1 && ! pidfdIsAlive(pidfd)){
+        die("The target process does not exist anymore");
+    }
+    struct stat targetPidSt;
+    if(fstat(targetprocDirFd, &targetPidSt) == -1){
+        die("fstat of the target process failed", errno);
+    }
+    if(targetPidSt.st_uid != realUid){
+        die("Target process belongs to a different user.");
+    }
+    if(! isMsenterGid(targetPidSt.st_gid)){
+        fprintf(stderr, "shournal-msenter: The group of the target process is not '%s'\n",
+                MSENTER_ONLY_GROUP);
+        exit(1);
+    }
+
+    // Remember the old working dir (setns changes it). Note that it is
+    // not possible to fchdir back to oldWdFd, because doing
+    // so leads also back to the original mountspace...
+    // Opening the dir as *real* user is essential on NFS -> permissions.
+    const uid_t effectiveUid = geteuid();
+    if(seteuid(realUid) == -1){
+        die("seteuid failed", errno);
+    }
+    const int oldWdFd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(oldWdFd == -1){
+        printErr((errno == ESTALE) ? "Failed to open the working directory. "
+                                     "Most probably it was deleted"
+                                   : "Failed to open the working directory", errno);
+    }
+    if(seteuid(effectiveUid) == -1){
+        die("seteuid failed", errno);
+    }
+
+    if(oldWdFd != -1){
+        if(joinMountNs(pidfd, targetprocDirFd)){
+            // Drop root privileges, irrevocable, before touching the path
+            if(setuid(realUid) == -1){
+                die("setuid failed", errno);
+            }
+            reenterWorkingDir(oldWdFd);
+        } else {
+            // most probably setns failed, because we are not suid. Since this program
+            // is execve'd itself, do not exit here.
+            fprintf(stderr, "shournal-msenter: Entering the mount-namespace of process "
+                            "%ld failed, file events are not captured: %s\n",
+                    targetPid, strerror(errno));
+        }
+        close(oldWdFd);
+    }
+    if(setuid(realUid) == -1){
+        die("setuid failed", errno);
+    }
+    if(pidfd != -1){
+        close(pidfd);
+    }
+    close(targetprocDirFd);
+
+    // restore variables removed for setuid-programs
+    for(int i=2; i < sepIdx; i++){
+        if(strchr(argv[i], '=') != nullptr){
+            putenv(argv[i]);
+        }
+    }
+
+    execvpe(filename, commandArgv, environ);
+    const int err = errno;
+    // Only get here on error.
+    // Failed to launch the executable - print error and mimic shell-return-codes.
+    fprintf(stderr, "%s: %s\n", filename, strerror(err));
+    switch (err) {
+    case EACCES: exit(126);
+    case ENOENT: exit(127);
+    default: exit(1);
+    }
+}
@@ -419,7 +419,7 @@ void FanotifyController::handleCloseNoWrite_safe(const fanotify_event_metadata &
     }
 
     try {
-        m_feventHandler.handleCloseRead(metadata.fd);
+        m_feventHandler.handleCloseRead(metadata.fd, metadata.pid);
         // The count of cached read (script-) files might have been incremented,
         // so we might be done with read events. For the sake
         // of code-shortness only check that the *next* time we consume a read event.
@@ -431,7 +431,7 @@ void FanotifyController::handleCloseNoWrite_safe(const fanotify_event_metadata &
 
 void FanotifyController::handleModCloseWrite_safe(const fanotify_event_metadata & metadata){
     try {
-        m_feventHandler.handleCloseWrite( metadata.fd );
+        m_feventHandler.handleCloseWrite(metadata.fd, metadata.pid);
     } catch (const std::exception & e) {
         logCritical << e.what();
     }
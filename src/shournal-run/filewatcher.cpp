@@ -19,6 +19,7 @@
 #include "mount_controller.h"
 #include "os.h"
 #include "osutil.h"
+#include "fdentries.h"
 #include "oscaps.h"
 #include "cleanupresource.h"
 #include "fdcommunication.h"
@@ -38,7 +39,6 @@
 #include "orig_mountspace_process.h"
 #include "cpp_exit.h"
 #include "qfilethrow.h"
-#include "storedfiles.h"
 #include "qoutstream.h"
 #include "conversions.h"
 #include "socket_message.h"
@@ -67,7 +67,7 @@ static void unshareOrDie(){
 /// fact that they cannot be joined (except from root). Therefor shournal
 /// allows only joining of processes whose (effective) gid matches
 /// below group.
-static gid_t findMsenterGidOrDie(){
+gid_t FileWatcher::findMsenterGidOrDie(){
     auto* groupInfo = getgrnam(app::MSENTER_ONLY_GROUP);
     if(groupInfo == nullptr){
         logCritical << qtr("group %1 does not exist on your "
@@ -104,11 +104,14 @@ FileWatcher::MsenterChildReturnValue FileWatcher::setupMsenterTargetChildProcess
         return {msenterPid, pipe_[1]};
     }
     // child
-    if(m_sockFd != -1){
-        // the socket is used to wait for other processes, not this one, so:
-        os::close(m_sockFd);
+    // The socket is used to wait for other processes, not this one. Within
+    // the observer daemon we would also hold the sockets of the other
+    // sessions, so close everything.
+    for(const int fd : osutil::FdEntries()){
+        if(fd > 2 && fd != pipe_[0]){
+            close(fd);
+        }
     }
-    os::close(pipe_[1]);
     char c;
     // wait unitl parent-process closes its write-end
     os::read(pipe_[0], &c, 1);
@@ -117,12 +120,16 @@ FileWatcher::MsenterChildReturnValue FileWatcher::setupMsenterTargetChildProcess
 
 FileWatcher::FileWatcher() :
     m_sockFd(-1),
+    m_sessionMode(false),
+    m_sessionCmdActive(false),
     m_msenterGid(std::numeric_limits<gid_t>::max()),
     m_commandArgc(0),
     m_commandFilename(nullptr),
     m_commandArgv(nullptr),
     m_commandEnvp(environ),
-    m_realUid(os::getuid())
+    m_realUid(os::getuid()),
+    m_msenterPid(-1),
+    m_msenterPipeWriteEnd(-1)
 {}
 
 void FileWatcher::setupShellLogger()
@@ -140,6 +147,9 @@ void FileWatcher::setupShellLogger()
 /// special group id, which waits for us to finish.
 /// Process fanotify events until the observed process finishes (first case) or until
 /// all other instances of the passed socket are closed by the observed processes.
+/// In session mode, the observation continues after a command finished, until
+/// the socket is closed, see setSessionMode. In batch mode, several commands
+/// are executed one after another, see setBatchCommands.
 /// See also code in directory 'shell-integration'.
 void FileWatcher::run()
 {
@@ -156,45 +166,24 @@ void FileWatcher::run()
     os::seteuid(m_realUid);
     fanotifyCtrl.setupPaths();
 
-    CommandInfo cmdInfo =  CommandInfo::fromLocalEnv();
-    cmdInfo.sessionInfo.uuid = m_shellSessionUUID;
+    m_emptyCmdInfo = CommandInfo::fromLocalEnv();
+    m_emptyCmdInfo.sessionInfo.uuid = m_shellSessionUUID;
+    CommandInfo cmdInfo = m_emptyCmdInfo;
 
     int ret = 1;
     m_sockCom.setReceiveBufferSize(RECEIVE_BUF_SIZE);
     E_SocketMsg pollResult;
-    if(m_commandArgc != 0){
+    if(! m_batchCommands.isEmpty()){
+        cpp_exit(runBatch(fanotifyCtrl));
+    } else if(m_commandArgc != 0){
         if(m_commandFilename != nullptr){
             cmdInfo.text += QString(m_commandFilename) + " ";
         }
         cmdInfo.text += argvToQStr(m_commandArgc, m_commandArgv);
-        auto sockPair = os::socketpair(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC );
-        m_sockCom.setSockFd(sockPair[0]);
-
-        Subprocess proc;
-        proc.setAsRealUser(true);
-        proc.setEnviron(m_commandEnvp);
-        cmdInfo.startTime = QDateTime::currentDateTime();
-        // TOODO: evtl. allow to configure proc to not close one of our sockets,
-        // to wait on grandchildren.
-        // Remove SOCK_CLOEXEC for one of them in that case
         const char* cmdFilename = (m_commandFilename == nullptr) ? m_commandArgv[0]
                                                                  : m_commandFilename;
-        proc.call(cmdFilename, m_commandArgv);
-        std::future<E_SocketMsg> thread = std::async(&FileWatcher::pollUntilStopped, this,
-                                                     std::ref(cmdInfo),
-                                                     std::ref(fanotifyCtrl));
-        try {
-            cmdInfo.returnVal = proc.waitFinish();
-        } catch (const os::ExcProcessExitNotNormal& ex) {
-            // return typical shell cpp_exit code
-            cmdInfo.returnVal = 128 + ex.status();
-        }
+        pollResult = observeCommand(cmdInfo, fanotifyCtrl, cmdFilename, m_commandArgv);
         ret = cmdInfo.returnVal;
-        // that should stop the polling event loop:
-        os::close(sockPair[1]);
-        thread.wait();
-        os::close(sockPair[0]);
-        pollResult = thread.get();
     } else if(m_sockFd != -1){
         MsenterChildReturnValue msenterChildRet = setupMsenterTargetChildProcess();
         auto closeMsenterWritePipe = finally([&msenterChildRet] {
@@ -253,6 +242,76 @@ void FileWatcher::run()
     cpp_exit(ret);
 }
 
+/// Execute the command and process its events, until it finished.
+/// @return the result of pollUntilStopped
+E_SocketMsg FileWatcher::observeCommand(CommandInfo &cmdInfo, FanotifyController &fanotifyCtrl,
+                                        const char *filename, char * const argv[])
+{
+    auto sockPair = os::socketpair(PF_UNIX, SOCK_STREAM | SOCK_CLOEXEC );
+    m_sockCom.setSockFd(sockPair[0]);
+
+    Subprocess proc;
+    proc.setAsRealUser(true);
+    proc.setEnviron(m_commandEnvp);
+    cmdInfo.startTime = QDateTime::currentDateTime();
+    // TOODO: evtl. allow to configure proc to not close one of our sockets,
+    // to wait on grandchildren.
+    // Remove SOCK_CLOEXEC for one of them in that case
+    proc.call(filename, argv);
+    std::future<E_SocketMsg> thread = std::async(&FileWatcher::pollUntilStopped, this,
+                                                 std::ref(cmdInfo),
+                                                 std::ref(fanotifyCtrl));
+    try {
+        cmdInfo.returnVal = proc.waitFinish();
+    } catch (const os::ExcProcessExitNotNormal& ex) {
+        // return typical shell cpp_exit code
+        cmdInfo.returnVal = 128 + ex.status();
+    }
+    // that should stop the polling event loop:
+    os::close(sockPair[1]);
+    thread.wait();
+    os::close(sockPair[0]);
+    return thread.get();
+}
+
+/// Execute the batch commands one after another via /bin/sh -c and store
+/// each as a separate command. Stop at the first failing command.
+/// Unless a shell session uuid was passed, the commands of a batch share a new
+/// session, so they can be queried together.
+/// Note that events of processes outliving their command (e.g. started
+/// in background) are attributed to the following command.
+/// @return the return value of the last executed command
+int FileWatcher::runBatch(FanotifyController &fanotifyCtrl)
+{
+    if(m_emptyCmdInfo.sessionInfo.uuid.isNull()){
+        m_emptyCmdInfo.sessionInfo.uuid = make_uuid();
+    }
+    int ret = 0;
+    for(const QString& cmdText : m_batchCommands){
+        CommandInfo cmdInfo = m_emptyCmdInfo;
+        cmdInfo.text = cmdText;
+        const QByteArray cmdBytes = cmdText.toLocal8Bit();
+        const char* shArgv[] { "sh", "-c", cmdBytes.constData(), nullptr };
+        const E_SocketMsg pollResult = observeCommand(cmdInfo, fanotifyCtrl, "/bin/sh",
+                                                      const_cast<char**>(shArgv));
+        cmdInfo.endTime = QDateTime::currentDateTime();
+        if(pollResult != E_SocketMsg::EMPTY){
+            logCritical << qtr("Because an error occurred, processing of "
+                               "fanotify/socket-events was "
+                               "stopped");
+            return (cmdInfo.returnVal == 0) ? 1 : cmdInfo.returnVal;
+        }
+        flushToDisk(cmdInfo);
+        ret = cmdInfo.returnVal;
+        if(ret != 0){
+            logInfo << qtr("batch command failed with return value %1, "
+                           "skipping the remaining commands: %2").arg(ret).arg(cmdText);
+            break;
+        }
+    }
+    return ret;
+}
+
 void FileWatcher::setShellSessionUUID(const QByteArray &shellSessionUUID)
 {
     m_shellSessionUUID = shellSessionUUID;
@@ -274,11 +333,98 @@ void FileWatcher::setSockFd(int sockFd)
     m_sockFd = sockFd;
 }
 
+/// In session mode a single observer serves all commands of a shell session,
+/// so the mount namespace and fanotify marks are set up only once.
+/// Each command is framed by BEGIN_COMMAND (answered by the same message, once
+/// we are ready) and END_COMMAND, which causes the command to be stored.
+/// File events between two commands are discarded. Note that processes may
+/// outlive their command, so their events belong to the then current command.
+void FileWatcher::setSessionMode(bool sessionMode)
+{
+    m_sessionMode = sessionMode;
+}
+
+/// Each non-empty command is passed to /bin/sh -c and stored separately,
+/// while the mount namespace, fanotify marks and settings are only set up once.
+void FileWatcher::setBatchCommands(const QStringList &batchCommands)
+{
+    m_batchCommands = batchCommands;
+}
+
 int FileWatcher::sockFd() const
 {
     return m_sockFd;
 }
 
+/// Set up a session observed within the observer daemon: like run() for
+/// a socket in session mode, except that we return after sending SETUP_DONE
+/// and the events are processed by the caller, see ObserverDaemon.
+/// Must be called with effective uid 0 after unsharing the mount-namespace.
+void FileWatcher::setupDaemonSession(gid_t msenterGid)
+{
+    assert(m_sockFd != -1);
+    m_msenterGid = msenterGid;
+    m_sessionMode = true;
+    m_fanotifyCtrl.reset(new FanotifyController(m_fEventHandler));
+    os::seteuid(m_realUid);
+    m_fanotifyCtrl->setupPaths();
+
+    m_emptyCmdInfo = CommandInfo::fromLocalEnv();
+    m_emptyCmdInfo.sessionInfo.uuid = m_shellSessionUUID;
+    m_daemonCmdInfo = m_emptyCmdInfo;
+    m_daemonCmdInfo.startTime = QDateTime::currentDateTime();
+
+    MsenterChildReturnValue msenterChildRet = setupMsenterTargetChildProcess();
+    m_msenterPid = msenterChildRet.pid;
+    m_msenterPipeWriteEnd = msenterChildRet.pipeWriteEnd;
+
+    m_sockCom.setReceiveBufferSize(RECEIVE_BUF_SIZE);
+    m_sockCom.setSockFd(m_sockFd);
+    setupShellLogger();
+    int rootDirFd = os::open("/", O_RDONLY | O_DIRECTORY);
+    auto closeRootDir = finally([&rootDirFd] { closeVerbose(rootDirFd);} );
+    m_sockCom.sendMsg({int(E_SocketMsg::SETUP_DONE),
+                       qBytesFromVar(m_msenterPid), rootDirFd});
+}
+
+int FileWatcher::fanFd() const
+{
+    return (m_fanotifyCtrl == nullptr) ? -1 : m_fanotifyCtrl->fanFd();
+}
+
+void FileWatcher::handleFanotifyEvents()
+{
+    m_fanotifyCtrl->handleEvents();
+    flushIfCacheExceeded(m_daemonCmdInfo);
+}
+
+/// Note: handle the pending fanotify events before, otherwise final
+/// events of a command might get lost.
+/// @return false, if the session ended or an error occurred.
+bool FileWatcher::handleSocketEvents()
+{
+    if(processSocketEvent(m_daemonCmdInfo) == E_SocketMsg::EMPTY){
+        return false;
+    }
+    flushIfCacheExceeded(m_daemonCmdInfo);
+    return true;
+}
+
+/// Store the last command (if any) and release the resources of the session.
+void FileWatcher::finishDaemonSession()
+{
+    storeCommand(m_daemonCmdInfo);
+    if(m_msenterPipeWriteEnd != -1){
+        closeVerbose(m_msenterPipeWriteEnd);
+        m_msenterPipeWriteEnd = -1;
+        os::waitpid(m_msenterPid);
+        m_msenterPid = -1;
+    }
+    m_fanotifyCtrl.reset();
+    closeVerbose(m_sockFd);
+    m_sockFd = -1;
+}
+
 void FileWatcher::setCommandFilename(char *commandFilename)
 {
     m_commandFilename = commandFilename;
@@ -326,6 +472,12 @@ E_SocketMsg FileWatcher::processSocketEvent( CommandInfo& cmdInfo ){
             m_fEventHandler.clearEvents();
             cmdInfo.startTime = QDateTime::currentDateTime();
             break;
+        case E_SocketMsg::BEGIN_COMMAND:
+            beginSessionCommand(cmdInfo, msg.bytes);
+            break;
+        case E_SocketMsg::END_COMMAND:
+            endSessionCommand(cmdInfo);
+            break;
         default: {
             // application bug?
             returnMsg = E_SocketMsg::EMPTY;
@@ -352,9 +504,10 @@ void FileWatcher::flushToDisk(CommandInfo& cmdInfo){
             db_controller::updateCommand(cmdInfo);
         }
 
-        StoredFiles::mkpath();
         db_controller::addFileEvents(cmdInfo, m_fEventHandler.writeEvents(),
-                                     m_fEventHandler.readEvents() );
+                                     m_fEventHandler.readEvents(),
+                                     m_fEventHandler.scriptStaging(),
+                                     m_fEventHandler.processes() );
     } catch (std::exception& e) {
         // May happen, e.g. if we run out of disk space...
         // We discard events anyway, so this error will not happen too soon again...
@@ -363,6 +516,73 @@ void FileWatcher::flushToDisk(CommandInfo& cmdInfo){
     m_fEventHandler.clearEvents();
 }
 
+/// Discard the events since the last command and reply, so the shell
+/// executes the command only after that.
+void FileWatcher::beginSessionCommand(CommandInfo &cmdInfo, const QByteArray &workingDir)
+{
+    if(! m_sessionMode){
+        logWarning << "received begin of command, but not in session mode";
+        return;
+    }
+    m_fEventHandler.clearEvents();
+    m_sessionCmdActive = true;
+    cmdInfo = m_emptyCmdInfo;
+    cmdInfo.workingDirectory = QString::fromLocal8Bit(workingDir);
+    cmdInfo.startTime = QDateTime::currentDateTime();
+    m_sockCom.sendMsg(int(E_SocketMsg::BEGIN_COMMAND));
+}
+
+/// Store the command, whose fields (text, return value,...) were sent
+/// right before. Its file events are already read: they were queued
+/// before the shell sent this message and the fanotify events are
+/// processed before socket events.
+void FileWatcher::endSessionCommand(CommandInfo &cmdInfo)
+{
+    if(! m_sessionMode){
+        logWarning << "received end of command, but not in session mode";
+        return;
+    }
+    storeCommand(cmdInfo);
+    m_sessionCmdActive = false;
+    cmdInfo = m_emptyCmdInfo;
+    cmdInfo.startTime = QDateTime::currentDateTime();
+}
+
+/// Store the finished command, unless it is empty and not in the database yet,
+/// which happens e.g. if the shell session exits.
+void FileWatcher::storeCommand(CommandInfo &cmdInfo)
+{
+    cmdInfo.endTime = QDateTime::currentDateTime();
+    if(cmdInfo.text.isEmpty() && cmdInfo.idInDb == db::INVALID_INT_ID){
+        logDebug << "command-text is empty, not pushing to database...";
+        m_fEventHandler.clearEvents();
+    } else {
+        flushToDisk(cmdInfo);
+    }
+}
+
+/// Note: for a (more or less) short time, the size of cached files might be bigger than
+/// specified in settings. That should not be a problem though.
+/// In session mode, events between two commands are discarded instead, as they
+/// would be on the next BEGIN_COMMAND, so no command without text is stored.
+void FileWatcher::flushIfCacheExceeded(CommandInfo &cmdInfo)
+{
+    auto & prefs = Settings::instance();
+    if(m_fEventHandler.sizeOfCachedReadFiles() >
+            prefs.readEventScriptSettings().flushToDiskTotalSize ||
+       m_fEventHandler.writeEvents().size() >
+            prefs.writeFileSettings().flushToDiskEventCount ||
+       m_fEventHandler.processCacheIsFull()){
+        if(m_sessionMode && ! m_sessionCmdActive){
+            logDebug << "discarding the events between two commands";
+            m_fEventHandler.clearEvents();
+            return;
+        }
+        logInfo << qtr("flushing to disk.");
+        flushToDisk(cmdInfo);
+    }
+}
+
 
 
 /// @return: EMPTY, if stopped regulary
@@ -423,18 +643,7 @@ E_SocketMsg FileWatcher::pollUntilStopped(CommandInfo& cmdInfo,
                 return E_SocketMsg::EMPTY;
             }
         }
-        auto & prefs = Settings::instance();
-
-        // Note: for a (more or less) short time, the size of cached files might be bigger than
-        // specified in settings. That should not be a problem though.
-        if(m_fEventHandler.sizeOfCachedReadFiles() >
-                prefs.readEventScriptSettings().flushToDiskTotalSize ||
-           m_fEventHandler.writeEvents().size() >
-                prefs.writeFileSettings().flushToDiskEventCount){
-            logInfo << qtr("flushing to disk.");
-            flushToDisk(cmdInfo);
-
-        }
+        flushIfCacheExceeded(cmdInfo);
     }
 
 }
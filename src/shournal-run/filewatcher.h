@@ -5,9 +5,12 @@
 #include "fanotify_controller.h"
 #include "socket_message.h"
 #include "fdcommunication.h"
+#include "commandinfo.h"
+
+#include <memory>
+#include <QStringList>
 
 class FanotifyController;
-struct CommandInfo;
 
 class FileWatcher {
 public:
@@ -26,9 +29,18 @@ public:
     void setCommandFilename(char *commandFilename);
 
     void setSockFd(int sockFd);
+    void setSessionMode(bool sessionMode);
+    void setBatchCommands(const QStringList& batchCommands);
 
     int sockFd() const;
 
+    void setupDaemonSession(gid_t msenterGid);
+    int fanFd() const;
+    static gid_t findMsenterGidOrDie();
+    void handleFanotifyEvents();
+    bool handleSocketEvents();
+    void finishDaemonSession();
+
 
 private:
     struct MsenterChildReturnValue {
@@ -40,6 +52,8 @@ private:
     static const int RECEIVE_BUF_SIZE = 1024*1024;
 
     int m_sockFd;
+    bool m_sessionMode;
+    bool m_sessionCmdActive; // between BEGIN_COMMAND and END_COMMAND
     logger::LogRotate m_shellLogger;
     FileEventHandler m_fEventHandler;
     gid_t m_msenterGid;
@@ -51,12 +65,27 @@ private:
     char ** m_commandEnvp;
     uid_t m_realUid;
     fdcommunication::SocketCommunication::Messages m_sockMessages;
+    CommandInfo m_emptyCmdInfo;
+    QStringList m_batchCommands;
+    // only used for sessions hosted by the observer daemon
+    std::unique_ptr<FanotifyController> m_fanotifyCtrl;
+    CommandInfo m_daemonCmdInfo;
+    pid_t m_msenterPid;
+    int m_msenterPipeWriteEnd;
 
     MsenterChildReturnValue setupMsenterTargetChildProcess();
+    socket_message::E_SocketMsg observeCommand(CommandInfo& cmdInfo,
+                                               FanotifyController& fanotifyCtrl,
+                                               const char* filename, char* const argv[]);
+    int runBatch(FanotifyController& fanotifyCtrl);
     socket_message::E_SocketMsg pollUntilStopped(CommandInfo& cmdInfo,
                                  FanotifyController& fanotifyCtrl);
     socket_message::E_SocketMsg processSocketEvent( CommandInfo& cmdInfo );
+    void flushIfCacheExceeded(CommandInfo& cmdInfo);
     void flushToDisk(CommandInfo& cmdInfo);
+    void storeCommand(CommandInfo& cmdInfo);
+    void beginSessionCommand(CommandInfo& cmdInfo, const QByteArray& workingDir);
+    void endSessionCommand(CommandInfo& cmdInfo);
 
 
 };
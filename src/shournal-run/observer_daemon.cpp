@@ -0,0 +1,478 @@
+
+#include <algorithm>
+#include <cassert>
+#include <csignal>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/capability.h>
+#include <unordered_set>
+#include <vector>
+
+#include "observer_daemon.h"
+#include "observer_daemon_socket.h"
+#include "filewatcher.h"
+#include "orig_mountspace_process.h"
+#include "fdcommunication.h"
+#include "socket_message.h"
+#include "os.h"
+#include "osutil.h"
+#include "oscaps.h"
+#include "excos.h"
+#include "logger.h"
+#include "translation.h"
+#include "cpp_exit.h"
+#include "app.h"
+#include "cleanupresource.h"
+
+using socket_message::E_SocketMsg;
+using osutil::closeVerbose;
+
+namespace  {
+
+/// Exit, if no session was registered for that long
+const int IDLE_TIMEOUT_MS = 10 * 60 * 1000;
+/// Max. time to wait for the REGISTER_SESSION message of a new connection
+const int REGISTER_TIMEOUT_MS = 5 * 1000;
+const int MAX_EPOLL_EVENTS = 64;
+/// Handling a session for longer is logged, as it delays the others
+const int STALL_LOG_MS = 1000;
+
+/// The integration tests must not wait ten minutes for the daemon to exit
+int idleTimeoutMs(){
+    if(app::inIntegrationTestMode()){
+        bool ok;
+        const int ms = qgetenv("_SHOURNAL_DAEMON_IDLE_TIMEOUT_MS").toInt(&ok);
+        if(ok){
+            return ms;
+        }
+    }
+    return IDLE_TIMEOUT_MS;
+}
+
+/// See FileWatcher::pollUntilStopped. Note that changing the euid from 0
+/// to nonzero resets the effective capabilities, so call it again afterwards.
+void enableEventProcessingCaps(){
+    auto caps = os::Capabilites::fromProc();
+    caps->setFlags(CAP_EFFECTIVE, { CAP_SYS_PTRACE, CAP_SYS_NICE });
+}
+
+void epollAdd(int epollFd, int fd){
+    struct epoll_event ev {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1){
+        throw os::ExcOs("epoll_ctl failed");
+    }
+}
+
+void epollDel(int epollFd, int fd){
+    // The fd might still be open within a just forked msenter-process,
+    // so do not rely on the implicit removal on close.
+    if(epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr) == -1){
+        logWarning << "epoll_ctl del failed:" << translation::strerror_l();
+    }
+}
+
+/// The daemon outlives the shell which launched it, so do not keep
+/// its terminal open.
+void redirectStdioToDevNull(){
+    const int devNull = os::open("/dev/null", O_RDWR, false);
+    for(int fd=0; fd <= 2; fd++){
+        if(fd != devNull){
+            os::dup2(devNull, fd);
+        }
+    }
+    if(devNull > 2){
+        os::close(devNull);
+    }
+}
+
+} // namespace
+
+
+ObserverDaemon::ObserverDaemon() :
+    m_realUid(os::getuid()),
+    m_msenterGid(0),
+    m_origMntNsFd(-1),
+    m_epollFd(-1),
+    m_listenFd(-1),
+    m_lockFd(-1),
+    m_signalFd(-1),
+    m_idleTimeoutMs(idleTimeoutMs())
+{}
+
+ObserverDaemon::~ObserverDaemon()
+{
+    try {
+        finishAllSessions();
+        for(const auto& con : m_pendingConnections){
+            closeVerbose(con.first);
+        }
+        if(m_listenFd != -1){
+            // still holding the lock, so no other daemon listens there yet
+            unlink(observer_daemon_socket::path().toLocal8Bit().constData());
+            closeVerbose(m_listenFd);
+        }
+        for(int fd : {m_lockFd, m_signalFd, m_epollFd, m_origMntNsFd}){
+            if(fd != -1){
+                closeVerbose(fd);
+            }
+        }
+    } catch (const std::exception& e) {
+        logCritical << __func__ << e.what();
+    }
+}
+
+
+/// Must be called with effective uid 0. Serve the registered sessions until
+/// SIGTERM or SIGINT is received or no session was left for a while.
+void ObserverDaemon::run()
+{
+    assert(os::geteuid() == 0);
+    m_msenterGid = FileWatcher::findMsenterGidOrDie();
+    orig_mountspace_process::setupIfNotExist();
+    m_origMntNsFd = os::open("/proc/self/ns/mnt", O_RDONLY);
+    if(chdir("/") == -1){
+        throw os::ExcOs("chdir / failed");
+    }
+
+    os::seteuid(m_realUid);
+    m_listenFd = observer_daemon_socket::listen(&m_lockFd);
+    if(m_listenFd == -1){
+        logInfo << qtr("Another observer daemon is already running, exiting.");
+        cpp_exit(0);
+    }
+    setupSignalFd();
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(m_epollFd == -1){
+        throw os::ExcOs("epoll_create1 failed");
+    }
+    epollAdd(m_epollFd, m_listenFd);
+    epollAdd(m_epollFd, m_signalFd);
+
+    enableEventProcessingCaps();
+    // slightly increase priority to prevent fanotify queue overflows
+    os::setpriority(PRIO_PROCESS, 0, -2);
+    redirectStdioToDevNull();
+    m_clock.start();
+
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    while(true){
+        const int readyCount = epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS,
+                                          epollTimeout());
+        if(readyCount == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            logCritical << qtr("epoll_wait failed (%1) - %2").arg(errno)
+                           .arg(translation::strerror_l());
+            cpp_exit(1);
+        }
+        if(readyCount == 0 && m_sessions.empty() && m_pendingConnections.empty()){
+            logInfo << qtr("No shell session was observed for %1 seconds, exiting.")
+                       .arg(m_idleTimeoutMs / 1000);
+            cpp_exit(0);
+        }
+        bool acceptPending = false;
+        bool stopRequested = false;
+        // Finished sessions and connections are handled after the whole batch,
+        // so their fd-numbers are not reused by a new session meanwhile.
+        std::unordered_set<int> finishedSockFds;
+        std::vector<int> readableConnections;
+        std::vector<int> fanotifyReadySockFds;
+        for(int i=0; i < readyCount; i++){
+            const int fd = events[i].data.fd;
+            if(fd == m_listenFd){
+                acceptPending = true;
+                continue;
+            }
+            if(fd == m_signalFd){
+                stopRequested = true;
+                continue;
+            }
+            if(m_pendingConnections.find(fd) != m_pendingConnections.end()){
+                readableConnections.push_back(fd);
+                continue;
+            }
+            auto fanIt = m_fanFdToSockFd.find(fd);
+            if(fanIt != m_fanFdToSockFd.end()){
+                fanotifyReadySockFds.push_back(fanIt->second);
+                continue;
+            }
+            auto sessionIt = m_sessions.find(fd);
+            if(sessionIt != m_sessions.end() &&
+                    ! handleSessionSocket(*sessionIt->second)){
+                finishedSockFds.insert(fd);
+            }
+        }
+        // only now, as handling the events may flush them to disk
+        for(int sockFd : fanotifyReadySockFds){
+            if(finishedSockFds.find(sockFd) == finishedSockFds.end() &&
+                    ! handleSessionFanotify(*m_sessions.at(sockFd))){
+                finishedSockFds.insert(sockFd);
+            }
+        }
+        for(int sockFd : finishedSockFds){
+            finishSession(m_sessions.find(sockFd));
+        }
+        if(stopRequested){
+            logInfo << qtr("Received termination signal, exiting.");
+            cpp_exit(0);
+        }
+        for(int conFd : readableConnections){
+            m_pendingConnections.erase(conFd);
+            epollDel(m_epollFd, conFd);
+            try {
+                registerSession(conFd);
+            } catch (const std::exception& e) {
+                logWarning << qtr("Failed to register a shell session: %1").arg(e.what());
+            }
+            closeVerbose(conFd);
+        }
+        closeExpiredConnections();
+        if(acceptPending){
+            acceptSessions();
+        }
+    }
+}
+
+void ObserverDaemon::setupSignalFd()
+{
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGTERM);
+    sigaddset(&sigs, SIGINT);
+    if(sigprocmask(SIG_BLOCK, &sigs, nullptr) == -1){
+        throw os::ExcOs("sigprocmask failed");
+    }
+    m_signalFd = signalfd(-1, &sigs, SFD_CLOEXEC | SFD_NONBLOCK);
+    if(m_signalFd == -1){
+        throw os::ExcOs("signalfd failed");
+    }
+}
+
+/// @return the timeout for epoll_wait: wait for the next deadline of a
+/// connection, if any, otherwise only exit, if idle.
+int ObserverDaemon::epollTimeout() const
+{
+    if(! m_pendingConnections.empty()){
+        qint64 nextDeadline = std::numeric_limits<qint64>::max();
+        for(const auto& con : m_pendingConnections){
+            nextDeadline = std::min(nextDeadline, con.second);
+        }
+        return int(std::max(nextDeadline - m_clock.elapsed(), qint64(0)));
+    }
+    return (m_sessions.empty()) ? m_idleTimeoutMs : -1;
+}
+
+/// Accept new connections, which are registered once readable, so a
+/// connecting process cannot stall the other sessions.
+void ObserverDaemon::acceptSessions()
+{
+    while(true){
+        const int conFd = accept4(m_listenFd, nullptr, nullptr,
+                                  SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if(conFd == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                logWarning << qtr("accept failed: %1").arg(translation::strerror_l());
+            }
+            return;
+        }
+        try {
+            if(peerAllowed(conFd)){
+                epollAdd(m_epollFd, conFd);
+                m_pendingConnections[conFd] = m_clock.elapsed() + REGISTER_TIMEOUT_MS;
+                continue;
+            }
+        } catch (const std::exception& e) {
+            logWarning << qtr("Failed to register a shell session: %1").arg(e.what());
+        }
+        closeVerbose(conFd);
+    }
+}
+
+/// Only sessions of our own user are accepted. Further, the shell must live
+/// within the mount-namespace we were started in, as the mount-namespaces
+/// of the sessions are copies of it. Otherwise the shell falls back to its
+/// own observer, once we close the connection.
+/// @throws ExcOs
+bool ObserverDaemon::peerAllowed(int conFd)
+{
+    struct ucred cred {};
+    socklen_t credLen = sizeof (cred);
+    if(getsockopt(conFd, SOL_SOCKET, SO_PEERCRED, &cred, &credLen) == -1){
+        throw os::ExcOs("getsockopt SO_PEERCRED failed");
+    }
+    if(cred.uid != m_realUid){
+        logWarning << qtr("Rejecting shell session of user %1").arg(cred.uid);
+        return false;
+    }
+    const auto peerMntNs = os::stat("/proc/" + std::to_string(cred.pid) + "/ns/mnt");
+    const auto origMntNs = os::fstat(m_origMntNsFd);
+    if(peerMntNs.st_dev != origMntNs.st_dev || peerMntNs.st_ino != origMntNs.st_ino){
+        logInfo << qtr("Rejecting shell session of process %1, which lives within "
+                       "another mount-namespace").arg(cred.pid);
+        return false;
+    }
+    return true;
+}
+
+/// Receive the socket of a new session from the (readable) connection and
+/// set it up.
+void ObserverDaemon::registerSession(int conFd)
+{
+    fdcommunication::SocketCommunication conCom;
+    conCom.setReceiveBufferSize(1024);
+    conCom.setSockFd(conFd);
+    const auto messages = conCom.receiveMessages();
+    if(messages.size() != 1 ||
+            messages.first().msgId != int(E_SocketMsg::REGISTER_SESSION) ||
+            messages.first().fd == -1){
+        for(const auto& msg : messages){
+            if(msg.fd != -1){
+                closeVerbose(msg.fd);
+            }
+        }
+        logWarning << qtr("Invalid registration of a shell session received");
+        return;
+    }
+    const int sockFd = messages.first().fd;
+    os::setFdDescriptorFlags(sockFd, FD_CLOEXEC);
+
+    std::unique_ptr<FileWatcher> session(new FileWatcher);
+    session->setSockFd(sockFd);
+    session->setShellSessionUUID(messages.first().bytes);
+    try {
+        setupSession(*session);
+        epollAdd(m_epollFd, sockFd);
+        epollAdd(m_epollFd, session->fanFd());
+    } catch (const std::exception& e) {
+        logWarning << qtr("Failed to set up a shell session: %1").arg(e.what());
+        try {
+            fdcommunication::SocketCommunication sessionCom;
+            sessionCom.setSockFd(sockFd);
+            sessionCom.sendMsg(int(E_SocketMsg::SETUP_FAIL));
+        } catch (const std::exception& e) {
+            logDebug << "failed to send SETUP_FAIL:" << e.what();
+        }
+        epoll_ctl(m_epollFd, EPOLL_CTL_DEL, sockFd, nullptr);
+        session->finishDaemonSession();
+        return;
+    }
+    m_fanFdToSockFd[session->fanFd()] = sockFd;
+    m_sessions[sockFd] = std::move(session);
+    logDebug << "registered shell session, count:" << m_sessions.size();
+}
+
+/// Set up the session within a new mount-namespace and return to our
+/// original one afterwards, so the namespace of the next session is a copy
+/// of the original one and our own file operations (e.g. to the database)
+/// do not show up as events of a session.
+void ObserverDaemon::setupSession(FileWatcher &session)
+{
+    std::exception_ptr setupExc;
+    try {
+        os::seteuid(0);
+        os::unshare(CLONE_NEWNS);
+        session.setupDaemonSession(m_msenterGid);
+    } catch (...) {
+        setupExc = std::current_exception();
+    }
+    os::seteuid(0);
+    os::setns(m_origMntNsFd, CLONE_NEWNS);
+    os::seteuid(m_realUid);
+    enableEventProcessingCaps();
+    if(setupExc){
+        std::rethrow_exception(setupExc);
+    }
+}
+
+/// @return false, if the session failed
+bool ObserverDaemon::handleSessionFanotify(FileWatcher &session)
+{
+    const qint64 beginMs = m_clock.elapsed();
+    auto logStall = finally([this, beginMs] { logIfStalled(beginMs); });
+    try {
+        session.handleFanotifyEvents();
+        return true;
+    } catch (const std::exception& e) {
+        logWarning << qtr("Stopping the observation of a shell session: %1").arg(e.what());
+    }
+    return false;
+}
+
+/// @return false, if the session ended or failed
+bool ObserverDaemon::handleSessionSocket(FileWatcher &session)
+{
+    const qint64 beginMs = m_clock.elapsed();
+    auto logStall = finally([this, beginMs] { logIfStalled(beginMs); });
+    try {
+        // Important: first handle fanotify events, then the socket.
+        // Otherwise final fanotify-events might get lost!
+        session.handleFanotifyEvents();
+        return session.handleSocketEvents();
+    } catch (const std::exception& e) {
+        logWarning << qtr("Stopping the observation of a shell session: %1").arg(e.what());
+    }
+    return false;
+}
+
+/// Handling a session (mostly storing a command) delays all others, so
+/// make long delays visible.
+void ObserverDaemon::logIfStalled(qint64 beginMs) const
+{
+    const qint64 durationMs = m_clock.elapsed() - beginMs;
+    if(durationMs > STALL_LOG_MS && m_sessions.size() > 1){
+        logInfo << qtr("Handling a shell session took %1 ms, which delayed "
+                       "the other %2 session(s)").arg(durationMs).arg(m_sessions.size() - 1);
+    }
+}
+
+/// Close the connections which did not register in time.
+void ObserverDaemon::closeExpiredConnections()
+{
+    const qint64 now = m_clock.elapsed();
+    for(auto it = m_pendingConnections.begin(); it != m_pendingConnections.end(); ){
+        if(it->second > now){
+            ++it;
+            continue;
+        }
+        logWarning << qtr("A shell session did not register within %1 seconds")
+                      .arg(REGISTER_TIMEOUT_MS / 1000);
+        epollDel(m_epollFd, it->first);
+        closeVerbose(it->first);
+        it = m_pendingConnections.erase(it);
+    }
+}
+
+void ObserverDaemon::finishSession(Sessions::iterator it)
+{
+    FileWatcher& session = *it->second;
+    epollDel(m_epollFd, it->first);
+    epollDel(m_epollFd, session.fanFd());
+    m_fanFdToSockFd.erase(session.fanFd());
+    try {
+        session.finishDaemonSession();
+    } catch (const std::exception& e) {
+        logWarning << qtr("Failed to finish a shell session: %1").arg(e.what());
+    }
+    m_sessions.erase(it);
+    logDebug << "shell session finished, count:" << m_sessions.size();
+}
+
+void ObserverDaemon::finishAllSessions()
+{
+    while(! m_sessions.empty()){
+        finishSession(m_sessions.begin());
+    }
+}
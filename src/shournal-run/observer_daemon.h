@@ -0,0 +1,78 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <sys/types.h>
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+class FileWatcher;
+
+/// Observe the shell sessions of a user within a single process
+/// (shournal-run --daemon), so the settings, the database connection and
+/// the caches are shared among them. Each session still has its own
+/// mount-namespace, fanotify group and msenter-process, see
+/// FileWatcher::setupDaemonSession.
+/// A session registers at observer_daemon_socket::path() by passing its end
+/// of a socketpair (REGISTER_SESSION), which is then served like the socket of
+/// a session observer launched by the shell.
+/// All file descriptors are multiplexed by epoll within a single thread, which
+/// is also required for switching the mount-namespace (setns(2) refuses a
+/// multithreaded process). So new connections are only read once readable,
+/// while the setup of a session (mount-namespace, fanotify marks), handling
+/// its file events (hashing, collecting scripts) and storing a command still
+/// delay the other sessions for their duration. A store is bounded by the flush
+/// limits (events and size of collected scripts, see
+/// FileWatcher::flushIfCacheExceeded), archiving of partitions happens at most
+/// once per process and waiting for another writer by the busy timeout of
+/// the database. Meanwhile the fanotify events of the other sessions queue
+/// up in the kernel, which does not block the observed processes. Within a
+/// batch of ready descriptors, sessions with socket messages (possibly
+/// waiting for the reply to BEGIN_COMMAND) are served before the fanotify
+/// events of the others are handled, which may cause a flush.
+/// Only shells of the same user within the mount-namespace the daemon was
+/// started in are served, other shells fall back to their own observer.
+class ObserverDaemon
+{
+public:
+    ObserverDaemon();
+    ~ObserverDaemon();
+
+    [[noreturn]]
+    void run();
+
+public:
+    Q_DISABLE_COPY(ObserverDaemon)
+
+private:
+    typedef std::unordered_map<int, std::unique_ptr<FileWatcher>> Sessions;
+
+    void setupSignalFd();
+    int epollTimeout() const;
+    void acceptSessions();
+    bool peerAllowed(int conFd);
+    void registerSession(int conFd);
+    void closeExpiredConnections();
+    void setupSession(FileWatcher& session);
+    bool handleSessionFanotify(FileWatcher& session);
+    bool handleSessionSocket(FileWatcher& session);
+    void logIfStalled(qint64 beginMs) const;
+    void finishSession(Sessions::iterator it);
+    void finishAllSessions();
+
+    uid_t m_realUid;
+    gid_t m_msenterGid;
+    int m_origMntNsFd;
+    int m_epollFd;
+    int m_listenFd;
+    int m_lockFd;
+    int m_signalFd;
+    int m_idleTimeoutMs;
+    Sessions m_sessions; // key: socket fd of the session
+    std::unordered_map<int, int> m_fanFdToSockFd;
+    // connections which did not register yet, value: deadline (see m_clock)
+    std::unordered_map<int, qint64> m_pendingConnections;
+    QElapsedTimer m_clock;
+};
+
@@ -12,6 +12,7 @@
 #include "os.h"
 #include "excos.h"
 #include "filewatcher.h"
+#include "observer_daemon.h"
 #include "msenter.h"
 #include "logger.h"
 #include "fdcommunication.h"
@@ -29,8 +30,8 @@
 #include "orig_mountspace_process.h"
 #include "cpp_exit.h"
 #include "db_connection.h"
-#include "storedfiles.h"
 #include "socket_message.h"
+#include "qfilethrow.h"
 
 using fdcommunication::SocketCommunication;
 using socket_message::E_SocketMsg;
@@ -69,6 +70,43 @@ void callFilewatcherSafe(FileWatcher& fwatcher){
     cpp_exit(1);
 }
 
+[[noreturn]]
+void callObserverDaemonSafe(){
+    try {
+        ObserverDaemon daemon;
+        daemon.run();
+    } catch (const os::ExcOs & ex) {
+        logCritical << qtr("Sorry, need to close: ") << ex.what();
+    } catch (const std::exception & ex) {
+        // e.g. a database error while finishing the sessions
+        logCritical << qtr("Sorry, need to close: ") << ex.what();
+    }
+    cpp_exit(1);
+}
+
+/// @return the non-empty lines of the batch file (stdin for '-')
+/// @throws QExcIo
+QStringList readBatchCommands(const QString& filename){
+    QFileThrow f;
+    if(filename == "-"){
+        f.open(stdin, QFile::OpenModeFlag::ReadOnly);
+    } else {
+        f.setFileName(filename);
+        f.open(QFile::OpenModeFlag::ReadOnly);
+    }
+    QStringList cmds;
+    for(const auto& line : QString::fromLocal8Bit(f.readAll()).split('\n')){
+        if(! line.trimmed().isEmpty()){
+            cmds.push_back(line);
+        }
+    }
+    if(cmds.isEmpty()){
+        QIErr() << qtr("No commands found in %1").arg(filename);
+        cpp_exit(1);
+    }
+    return cmds;
+}
+
 } //  namespace
 
 
@@ -121,12 +159,32 @@ int shournal_run_main(int argc, char *argv[])
     argSocketFd.setInternalOnly(true);
     parser.addArg(&argSocketFd);
 
+    // keep observing the shell session after a command finished
+    QOptArg argSession("", "session", "", false);
+    argSession.setInternalOnly(true);
+    argSession.addRequiredArg(&argSocketFd);
+    parser.addArg(&argSession);
+
+    // observe the shell sessions registering at the observer daemon socket
+    QOptArg argDaemon("", "daemon", "", false);
+    argDaemon.setInternalOnly(true);
+    parser.addArg(&argDaemon);
+
     QOptArg argExec("e", "exec", qtr("Execute and observe the passed program "
                                      "and its arguments (this argument has to be last)."),
                     false);
     argExec.setFinalizeFlag(true);
     parser.addArg(&argExec);
 
+    QOptArg argExecBatch("", "exec-batch", qtr("<file>. Execute and observe the commands "
+                                               "in the passed file (one per line, '-' "
+                                               "for stdin) one after another via /bin/sh -c. "
+                                               "The observation is set up only once, but each "
+                                               "command is stored separately. Execution stops "
+                                               "at the first failing command, whose return "
+                                               "value is returned."));
+    parser.addArg(&argExecBatch);
+
     QOptArg argExecFilename("", "exec-filename", qtr("This is an advanced option. "
                                                      "In most cases the first argument of a "
                                                      "program is the program name. For "
@@ -216,6 +274,20 @@ int shournal_run_main(int argc, char *argv[])
             QIErr() << qtr("%1 and %2 are mutually exclusive").arg(argExec.name(), argSocketFd.name());
             cpp_exit(1);
         }
+        if(argExecBatch.wasParsed() &&
+                (argExec.wasParsed() || argSocketFd.wasParsed())) {
+            QIErr() << qtr("%1 is mutually exclusive with %2 and %3")
+                       .arg(argExecBatch.name(), argExec.name(), argSocketFd.name());
+            cpp_exit(1);
+        }
+        if(argDaemon.wasParsed() &&
+                (argExec.wasParsed() || argSocketFd.wasParsed() ||
+                 argExecBatch.wasParsed())) {
+            QIErr() << qtr("%1 is mutually exclusive with %2, %3 and %4")
+                       .arg(argDaemon.name(), argExec.name(), argSocketFd.name(),
+                            argExecBatch.name());
+            cpp_exit(1);
+        }
 
         if(argVersion.wasParsed()){
             QOut() << app::SHOURNAL_RUN << qtr(" version ") << app::version().toString() << "\n";
@@ -255,7 +327,10 @@ int shournal_run_main(int argc, char *argv[])
         try {
             logger::enableLogToFile(app::SHOURNAL_RUN);
             Settings::instance().load();
-            StoredFiles::mkpath();
+            if(argExecBatch.wasParsed()){
+                fwatcher.setBatchCommands(
+                            readBatchCommands(argExecBatch.getValue<QString>()));
+            }
         } catch(const qsimplecfg::ExcCfg & ex){
             QIErr() << qtr("Failed to load config file: ") << ex.descrip();
             cpp_exit(1);
@@ -276,10 +351,19 @@ int shournal_run_main(int argc, char *argv[])
                         QByteArray::fromBase64(argShellSessionUUID.getValue<QByteArray>()));
         }
 
+        if(argDaemon.wasParsed()){
+            callObserverDaemonSafe();
+        }
+
         if(argSocketFd.wasParsed()){
             int socketFd = argSocketFd.getValue<int>(-1);
             os::setFdDescriptorFlags(socketFd, FD_CLOEXEC);
             fwatcher.setSockFd(socketFd);
+            fwatcher.setSessionMode(argSession.wasParsed());
+            callFilewatcherSafe(fwatcher);
+        }
+
+        if(argExecBatch.wasParsed()){
             callFilewatcherSafe(fwatcher);
         }
 
@@ -1,5 +1,6 @@
 
 #include <QDebug>
+#include <unistd.h>
 
 #include "argcontrol_dbdelete.h"
 #include "argcontrol_dbquery.h"
@@ -8,6 +9,7 @@
 #include "qoptargparse.h"
 #include "qoptsqlarg.h"
 #include "database/db_controller.h"
+#include "database/db_partitions.h"
 #include "database/query_columns.h"
 #include "cpp_exit.h"
 #include "app.h"
@@ -34,7 +36,7 @@ void argcontrol_dbdelete::parse(int argc, char *argv[])
 
     QOptSqlArg argCmdCwd("cwd", "command-working-dir",
                          qtr("Delete commands with matching working-directory."),
-                          QOptSqlArg::cmpOpsText());
+                          QOptSqlArg::cmpOpsPath());
     parser.addArg(&argCmdCwd);
 
     QOptSqlArg argCmdDate("cmded", "command-end-date", qtr("Deletes commands given by end-date. Example:\n"
@@ -62,6 +64,25 @@ void argcontrol_dbdelete::parse(int argc, char *argv[])
     parser.addArg(&argCmdYoungerThan);
 
 
+    QOptArg argVacuum("", "vacuum",
+                      qtr("Rebuild the database file to give unused space back to the "
+                          "filesystem. Afterwards, this also happens for every deletion "
+                          "(databases created since version 2.4 do so anyway). "
+                          "May be passed without a query. Note that this may take a while "
+                          "for large databases."),
+                      false);
+    parser.addArg(&argVacuum);
+
+    QOptArg argPartition("", "partition",
+                         qtr("Move the commands of past years from the database into "
+                             "one database file per year. Afterwards this happens "
+                             "automatically when storing commands, and --older-than "
+                             "deletes whole years by removing their files. "
+                             "Beyond eight files the oldest years are merged. "
+                             "May be passed without a query."),
+                         false);
+    parser.addArg(&argPartition);
+
     parser.parse(argc, argv);
     SqlQuery query;
 
@@ -88,12 +109,37 @@ void argcontrol_dbdelete::parse(int argc, char *argv[])
         cpp_exit(1);
     }
 
+    if(argPartition.wasParsed()){
+        QOut() << qtr("%1 command(s) moved to yearly partitions.")
+                  .arg(db_partitions::archiveCompletedYears()) << "\n";
+    }
+
     if(query.isEmpty()){
+        if(argVacuum.wasParsed()){
+            db_controller::vacuum();
+        }
+        if(argVacuum.wasParsed() || argPartition.wasParsed()){
+            cpp_exit(0);
+        }
         QIErr() << qtr("No target fields given (empty query).");
         cpp_exit(1);
     }
 
-    QOut() << qtr("%1 command(s) deleted.").arg( db_controller::deleteCommand(query)) << "\n";
+    // report the progress of large deletions on the terminal
+    db_controller::DeleteProgress progress;
+    if(isatty(STDOUT_FILENO)){
+        progress = [](int processed, int total){
+            QOut() << "\r" << qtr("Deleting commands... %1/%2").arg(processed).arg(total);
+            if(processed == total){
+                QOut() << "\n";
+            }
+        };
+    }
+    const int countOfDeleted = db_controller::deleteCommand(query, progress);
+    QOut() << qtr("%1 command(s) deleted.").arg(countOfDeleted) << "\n";
+    if(argVacuum.wasParsed()){
+        db_controller::vacuum();
+    }
 
 
     cpp_exit(0);
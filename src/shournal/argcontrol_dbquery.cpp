@@ -35,6 +35,7 @@ queryCmdPrintAndExit(std::unique_ptr<CommandPrinter>& cmdPrinter,
                           SqlQuery& sqlQ,
                           bool reverseResultIter ){
     auto results = db_controller::queryForCmd(sqlQ, reverseResultIter);
+    results->setProjection(cmdPrinter->queryProjection());
     cmdPrinter->printCommandInfosEvtlRestore(results);
     cpp_exit(0);
 }
@@ -92,7 +93,7 @@ void argcontol_dbquery::parse(int argc, char *argv[])
         "%1 --query --wfile /tmp/foo123 - use existing file to find out, how it was created.\n"
         "%1 --query --wsize -gt 10KiB - print all commands which have written to files whose "
                                     "size is greater than 10KiB.\n"
-        "%1 --query --wpath -like /home/user% - print all commands, which have written to files "
+        "%1 --query --wpath -subtree /home/user - print all commands, which have written to files "
                                      "below /home/user and all subdirectories.\n"
                                    ).arg(app::SHOURNAL) + "\n");
 
@@ -102,6 +103,25 @@ void argcontol_dbquery::parse(int argc, char *argv[])
                             );
     parser.addArg(&argHistory);
 
+    QOptArg argAfter("", "after",
+                     qtr("Only display commands started after the given cursor "
+                         "<startTime,id> (start time in milliseconds since epoch). "
+                         "The json output format prints the cursors of the first and last "
+                         "command of a page in its footer."));
+    parser.addArg(&argAfter);
+
+    QOptArg argBefore("", "before",
+                      qtr("Only display the latest commands started before the given "
+                          "cursor <startTime,id>, see %1.").arg(argAfter.name()));
+    parser.addArg(&argBefore);
+
+    QOptArg argPageSize("", "page-size",
+                        qtr("Display at most N commands. To display the following "
+                            "(or previous) ones, pass the cursor of the last "
+                            "(or first) displayed command to %1 (or %2).")
+                        .arg(argAfter.name(), argBefore.name()));
+    parser.addArg(&argPageSize);
+
     // ------------ wfile
     QOptArg argWFile("wf", "wfile",
                     qtr("Pass an existing file(-path) to find out the command, "
@@ -124,8 +144,10 @@ void argcontol_dbquery::parse(int argc, char *argv[])
                         QOptSqlArg::cmpOpsText());
     parser.addArg(&argWName);
 
-    QOptSqlArg argWPath("wp", "wpath", wFilePreamble + qtr("by (full) directory-path."),
-                        QOptSqlArg::cmpOpsText());
+    QOptSqlArg argWPath("wp", "wpath", wFilePreamble + qtr("by (full) directory-path. "
+                                                           "Use -subtree to include all "
+                                                           "subdirectories."),
+                        QOptSqlArg::cmpOpsPath());
     parser.addArg(&argWPath);
 
     QOptSqlArg argWSize("ws", "wsize", wFilePreamble + qtr("by filesize."),
@@ -141,6 +163,12 @@ void argcontol_dbquery::parse(int argc, char *argv[])
                        QOptSqlArg::cmpOpsAllButLike() );
     parser.addArg(&argWMtime);
 
+    QOptSqlArg argWExe("wx", "wexe", wFilePreamble + qtr("by the executable of the "
+                                                         "(child-) process which wrote "
+                                                         "them."),
+                       QOptSqlArg::cmpOpsText());
+    parser.addArg(&argWExe);
+
     // ------------ rfile
 
     const QString rFilePreamble = qtr("Query for read files ");
@@ -148,8 +176,10 @@ void argcontol_dbquery::parse(int argc, char *argv[])
                         QOptSqlArg::cmpOpsText());
     parser.addArg(&argRName);
 
-    QOptSqlArg argRPath("rp", "rpath", rFilePreamble + qtr("by (full) directory-path."),
-                        QOptSqlArg::cmpOpsText());
+    QOptSqlArg argRPath("rp", "rpath", rFilePreamble + qtr("by (full) directory-path. "
+                                                           "Use -subtree to include all "
+                                                           "subdirectories."),
+                        QOptSqlArg::cmpOpsPath());
     parser.addArg(&argRPath);
 
     QOptSqlArg argRSize("rs", "rsize", rFilePreamble + qtr("by filesize."),
@@ -161,6 +191,12 @@ void argcontol_dbquery::parse(int argc, char *argv[])
                        QOptSqlArg::cmpOpsAllButLike() );
     parser.addArg(&argRMtime);
 
+    QOptSqlArg argRExe("rx", "rexe", rFilePreamble + qtr("by the executable of the "
+                                                         "(child-) process which read "
+                                                         "them."),
+                       QOptSqlArg::cmpOpsText());
+    parser.addArg(&argRExe);
+
     // TODO: argRHash (and others?)
 
     QOptArg argMaxReadFileLines("", "max-rfile-lines",
@@ -197,7 +233,7 @@ void argcontol_dbquery::parse(int argc, char *argv[])
 
     QOptSqlArg argCmdCwd("cwd", "command-working-dir",
                          qtr("Query for commands with matching working-directory."),
-                          QOptSqlArg::cmpOpsText());
+                          QOptSqlArg::cmpOpsPath());
     parser.addArg(&argCmdCwd);
 
     QOptSqlArg argCmdId("cmdid", "command-id", qtr("Query for commands with matching ids. "
@@ -334,12 +370,14 @@ void argcontol_dbquery::parse(int argc, char *argv[])
                          argWHash.parsedOperator());
     }
     addVariantSqlArgToQueryIfParsed<QDateTime>(query, argWMtime, cols.wfile_mtime);
+    addSimpleSqlArgToQueryIfParsed<QString>(query, argWExe, cols.wFile_processExe);
 
 
     addSimpleSqlArgToQueryIfParsed<QString>(query, argRName, cols.rFile_name);
     addSimpleSqlArgToQueryIfParsed<QString>(query, argRPath, cols.rFile_path);
     addBytesizeSqlArgToQueryIfParsed(query, argRSize, cols.rFile_size);
     addVariantSqlArgToQueryIfParsed<QDateTime>(query, argRMtime, cols.rFile_mtime);
+    addSimpleSqlArgToQueryIfParsed<QString>(query, argRExe, cols.rFile_processExe);
 
     addVariantSqlArgToQueryIfParsed<qint64>(query, argCmdId, cols.cmd_id);
     addSimpleSqlArgToQueryIfParsed<QString>(query, argCmdText, cols.cmd_txt);
@@ -376,20 +414,46 @@ void argcontol_dbquery::parse(int argc, char *argv[])
 
     // we always display commands in startDate-order, however,
     // to allow for a performant history query (where the last
-    // N entries are queried) we traverse the result-set from
-    // end -> reverseResultIter = true AND query.ascending = false.
+    // N entries are queried) the result-set is reversed in sql
+    // -> reverseResultIter = true AND query.ascending = false.
     bool reverseResultIter=false;
 
+    // Keyset pagination by (cmd.startTime, cmd.id), which is the order
+    // of displayed commands. A page before a cursor is queried like the history.
+    if(argAfter.wasParsed() && (argBefore.wasParsed() || argHistory.wasParsed())){
+        QIErr() << qtr("%1 cannot be combined with %2 or %3")
+                   .arg(argAfter.name(), argBefore.name(), argHistory.name());
+        cpp_exit(1);
+    }
+    if(argBefore.wasParsed() && argHistory.wasParsed()){
+        QIErr() << qtr("%1 cannot be combined with %2")
+                   .arg(argBefore.name(), argHistory.name());
+        cpp_exit(1);
+    }
+    if(argAfter.wasParsed()){
+        const auto cursor = argAfter.getValuesByDelim<QVector<qint64> >(",", {}, 2, 2);
+        query.addKeysetBound(cols.cmd_starttime, cursor[0], cols.cmd_id, cursor[1], true);
+    }
+    if(argBefore.wasParsed()){
+        const auto cursor = argBefore.getValuesByDelim<QVector<qint64> >(",", {}, 2, 2);
+        query.addKeysetBound(cols.cmd_starttime, cursor[0], cols.cmd_id, cursor[1], false);
+        reverseResultIter = true;
+        query.setAscending(false);
+    }
+    if(argPageSize.wasParsed()){
+        query.setLimit(static_cast<int>(argPageSize.getValue<uint>()));
+    }
+
     // argHistory *must* be last, in case of an otherwise empty
     // query, accept all (where 1).
     if(argHistory.wasParsed()){
         reverseResultIter = true;
         query.setAscending(false);
         query.setLimit(static_cast<int>(argHistory.getValue<uint>()));
-        if(query.isEmpty()){
-            // accept everything
-            query.setQuery(" 1 ");
-        }
+    }
+    if((argHistory.wasParsed() || argPageSize.wasParsed()) && query.isEmpty()){
+        // accept everything
+        query.setQuery(" 1 ");
     }
 
     if( parser.rest().len != 0){
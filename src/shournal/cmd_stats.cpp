@@ -15,16 +15,21 @@ void CmdStats::setMaxCountOfStats(const int &val)
     m_cmdsWithMostFileModsQueue.setMaxSize(val);
 }
 
+int CmdStats::maxCountOfStats() const
+{
+    return m_maxCountOfStats;
+}
+
 void CmdStats::collectCmd(const CommandInfo &cmd)
 {
     auto incrementIdxLater = finally([this] { ++m_currentCmdIdx; });
 
-    if(! cmd.fileWriteInfos.isEmpty()){
+    if(cmd.fileWriteCount > 0){
         MostFileModsEntry mostFileMods;
         mostFileMods.idx = m_currentCmdIdx;
         mostFileMods.idInDb = cmd.idInDb;
         mostFileMods.cmdTxt = cmd.text;
-        mostFileMods.countOfFileMods = cmd.fileWriteInfos.size();
+        mostFileMods.countOfFileMods = cmd.fileWriteCount;
         m_cmdsWithMostFileModsQueue.push(mostFileMods);
     }
 
@@ -44,6 +49,15 @@ void CmdStats::collectCmd(const CommandInfo &cmd)
         ++cwdCmdCountEntry.cmdCount;
     }
 
+    // the file infos may be limited, so prefer the counts from the database
+    if(! cmd.fileCountsPerDir.isEmpty()){
+        for(auto it = cmd.fileCountsPerDir.begin(); it != cmd.fileCountsPerDir.end(); ++it){
+            auto & dirIoEntry = m_dirIoCountMap[it.key()];
+            dirIoEntry.readCount += it.value().readCount;
+            dirIoEntry.writeCount += it.value().writeCount;
+        }
+        return;
+    }
     for(const auto& info : cmd.fileReadInfos){
         auto & dirIoEntry = m_dirIoCountMap[info.path];
         ++dirIoEntry.readCount;
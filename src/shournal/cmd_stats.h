@@ -49,6 +49,7 @@ public:
     CmdStats();
 
     void setMaxCountOfStats(const int &val);
+    int maxCountOfStats() const;
 
     void collectCmd(const CommandInfo& cmd);
 
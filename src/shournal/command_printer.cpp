@@ -12,6 +12,7 @@
 #include "util.h"
 #include "qfilethrow.h"
 #include "db_controller.h"
+#include "command_query_iterator.h"
 #include "logger.h"
 #include "file_query_helper.h"
 #include "excos.h"
@@ -40,14 +41,20 @@ void CommandPrinter::createRestoreTopleveDirIfNeeded()
 
 void CommandPrinter::restoreReadFile_safe(const FileReadInfo &readInfo, const QString &cmdIdStr)
 {
-    QFileThrow f(m_storedFiles.mkPathStringToStoredReadFile(readInfo));
-    f.open(QFile::ReadOnly);
-    restoreReadFile_safe(readInfo, cmdIdStr, f);
+    QByteArray content;
+    try {
+        content = m_storedFiles.readContent(readInfo);
+    } catch(const QExcIo& e){
+        logWarning << qtr("Failed to restore read file with id %1:").arg(readInfo.idInDb)
+                   << e.descrip();
+        return;
+    }
+    restoreReadFile_safe(readInfo, cmdIdStr, content);
 }
 
 
 void CommandPrinter::restoreReadFile_safe(const FileReadInfo &readInfo, const QString &cmdIdStr,
-                                  const QFile &openReadFile)
+                                  const QByteArray &content)
 {  
     QDir fullDirPath(m_restoreDir.absoluteFilePath(qtr("command-id-") + cmdIdStr) + QDir::separator() +
                   readInfo.path);
@@ -58,7 +65,7 @@ void CommandPrinter::restoreReadFile_safe(const FileReadInfo &readInfo, const QS
             throw QExcIo(qtr("Failed to create the read-files restore directory for command-id %1")
                                  .arg(cmdIdStr));
         }
-        m_storedFiles.restoreReadFileAtDIr(readInfo, fullDirPath, openReadFile);
+        m_storedFiles.restoreReadFileAtDIr(readInfo, fullDirPath, content);
         ++m_countOfRestoredFiles;
     } catch (const os::ExcOs& e) {
         logWarning << failMsg << e.what();
@@ -73,6 +80,25 @@ void CommandPrinter::setMinCountOfStats(int val)
     m_minCountOfStats = val;
 }
 
+/// The file events actually printed, so only those are fetched from the
+/// database (the total counts are always available).
+CmdQueryProjection CommandPrinter::queryProjection() const
+{
+    CmdQueryProjection projection;
+    projection.maxCountWFiles = m_maxCountWfiles;
+    projection.maxCountRFiles = m_maxCountRfiles;
+    return projection;
+}
+
+/// For printers showing the directory statistics, which shall consider all
+/// file events, not only the printed ones.
+CmdQueryProjection CommandPrinter::queryProjectionWithDirStats() const
+{
+    CmdQueryProjection projection = CommandPrinter::queryProjection();
+    projection.fileCountsPerDir = m_cmdStats.maxCountOfStats() > 0;
+    return projection;
+}
+
 void CommandPrinter::setMaxCountRfiles(int maxCountRfiles)
 {
     m_maxCountRfiles = maxCountRfiles;
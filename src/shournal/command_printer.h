@@ -10,6 +10,7 @@
 
 class CommandQueryIterator;
 class QFormattedStream;
+struct CmdQueryProjection;
 
 /// Base class for command-printers (human, json).
 /// Print command-infos and corresponding file events to stdout.
@@ -30,16 +31,18 @@ public:
     virtual void setMaxCountRfiles(int maxCountRfiles);
     virtual CmdStats& cmdStats();
     virtual void setMinCountOfStats(int val);
+    virtual CmdQueryProjection queryProjection() const;
 
 protected:
     Q_DISABLE_COPY(CommandPrinter)
 
     void createRestoreTopleveDirIfNeeded();
+    CmdQueryProjection queryProjectionWithDirStats() const;
 
     void restoreReadFile_safe(const FileReadInfo& readInfo,
                          const QString &cmdIdStr);
     void restoreReadFile_safe(const FileReadInfo& readInfo,
-                         const QString &cmdIdStr, const QFile &openReadFile);
+                         const QString &cmdIdStr, const QByteArray &content);
 
 
     StoredFiles m_storedFiles;
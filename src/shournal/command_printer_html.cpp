@@ -21,7 +21,7 @@ using qresource_helper::data_safe;
 
 void CommandPrinterHtml::printCommandInfosEvtlRestore(std::unique_ptr<CommandQueryIterator> &cmdIter)
 {
-    if( cmdIter->computeSize() == 0){
+    if(! cmdIter->hasNext()){
         QOut() << qtr("No results found matching the query.\n");
         return;
     }
@@ -194,8 +194,8 @@ void CommandPrinterHtml::writeCmdData(const CommandInfo &cmd,
 
     // since we may restrict the number of read/written files (to not generate
     // huge html-files), store the real number in any case:
-    jsonCmdData["fileReadEvents_length"] = cmd.fileReadInfos.length();
-    jsonCmdData["fileWriteEvents_length"] = cmd.fileWriteInfos.length();
+    jsonCmdData["fileReadEvents_length"] = cmd.fileReadCount;
+    jsonCmdData["fileWriteEvents_length"] = cmd.fileWriteCount;
 
     if(tmpCmdDataFile.write(QJsonDocument(jsonCmdData).toJson(QJsonDocument::Compact)) == -1){
         throw QExcIo("Failed to write cmdData to tmpfile: " +  tmpCmdDataFile.errorString());
@@ -212,7 +212,7 @@ void CommandPrinterHtml::addScriptsToReadFilesSet(const FileReadInfos &infos,
         if(info.isStoredToDisk){
             // don't check mimetype here, to avoid performing it multiple times
             // for the same script-id
-            set.insert(info.idInDb);
+            set.insert({info.idInDb, info});
         }
         ++counter;
         if(counter > m_maxCountRfiles){
@@ -228,22 +228,23 @@ void CommandPrinterHtml::writeReadFileContentsToHtml(QTextStream &outstream,
     outstream << "const readFileContentMap = new Map([\n";
     auto autoCloseNewMap = finally([&outstream] {  outstream << "]);\n"; });
 
-    for(const auto& id_ : readFileIdSet) {
+    for(const auto& idInfoPair : readFileIdSet) {
+        const qint64 id_ = idInfoPair.first;
         // javascript Maps can take 2d arrays in the constructor.
         // Each array entry has the format [key, value].
         outstream << "[" << id_ << ",";
         auto autoCloseBracket = finally([&outstream] { outstream << "],\n"; });
-        QFileThrow f(m_storedFiles.mkPathStringToStoredReadFile(id_));
         try {
-            f.open(QFile::OpenModeFlag::ReadOnly);
-            auto mtype = m_mimedb.mimeTypeForData(&f);
+            const QByteArray content = m_storedFiles.readContent(idInfoPair.second);
+            auto mtype = m_mimedb.mimeTypeForData(content);
             if(! mtype.inherits("text/plain")){
                 outstream << "null"; // don't use 'undefined' here!
                 continue;
             }
             outstream << "\"";
             auto autoSetQuote = finally([&outstream] { outstream << "\""; });
-            writeFileToStream(f, outstream);
+            // we could be writing anything here to the js file - KISS, and use base64
+            outstream << content.toBase64();
 
         } catch (const QExcIo& e) {
             logWarning << qtr("Error writing read file with id %1 to html: %2")
@@ -252,18 +253,6 @@ void CommandPrinterHtml::writeReadFileContentsToHtml(QTextStream &outstream,
     }
 }
 
-void CommandPrinterHtml::writeFileToStream(QFileThrow &f, QTextStream &outstream)
-{
-    const int BUFSIZE = 9000; // MUST be divisible by 3, so we create no padding '='
-                              // between base64-chunks (;
-    char buf[BUFSIZE];
-    qint64 readCount;
-    while(  (readCount = f.read(buf, BUFSIZE)) > 0 ){
-        // we could be writing anything here to the js file - KISS, and use base64
-        outstream << QByteArray::fromRawData(buf, int(readCount)).toBase64();
-    }
-}
-
 void CommandPrinterHtml::writeStatistics(QTextStream &outstream)
 {
     {
@@ -327,4 +316,7 @@ void CommandPrinterHtml::writeStatistics(QTextStream &outstream)
 
 }
 
-
+CmdQueryProjection CommandPrinterHtml::queryProjection() const
+{
+    return queryProjectionWithDirStats();
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <unordered_set>
+#include <unordered_map>
 #include <QMimeDatabase>
 
 #include "command_printer.h"
@@ -18,11 +18,13 @@ public:
     CommandPrinterHtml() = default;
 
     void printCommandInfosEvtlRestore(std::unique_ptr<CommandQueryIterator>& cmdIter) override;
+    CmdQueryProjection queryProjection() const override;
 
 protected:
      Q_DISABLE_COPY(CommandPrinterHtml)
 
-    typedef std::unordered_set<qint64> FileReadInfoSet_t;
+    // read files by id
+    typedef std::unordered_map<qint64, FileReadInfo> FileReadInfoSet_t;
     void processSingleCommand(QTextStream& outstream, CommandInfo& cmd, QDateTime&
                               finalCommandEndDate, QTemporaryFile& tmpCmdDataFile);
     void writeCmdStartup(const CommandInfo& cmd, QTextStream& outstream);
@@ -31,7 +33,6 @@ protected:
 
     void addScriptsToReadFilesSet(const FileReadInfos& infos, FileReadInfoSet_t& set);
     void writeReadFileContentsToHtml(QTextStream& outstream, FileReadInfoSet_t& readFileIdSet);
-    void writeFileToStream(QFileThrow& f, QTextStream& outstream);
     void writeStatistics(QTextStream& outstream);
 
     QMimeDatabase m_mimedb;
@@ -26,7 +26,7 @@
 
 void CommandPrinterHuman::printCommandInfosEvtlRestore(std::unique_ptr<CommandQueryIterator> &cmdIter)
 {
-    if( cmdIter->computeSize() == 0){
+    if(! cmdIter->hasNext()){
         QOut() << qtr("No results found matching the query.\n");
         return;
     }
@@ -64,7 +64,7 @@ void CommandPrinterHuman::printCommandInfosEvtlRestore(std::unique_ptr<CommandQu
             s << qtr("Hostname: %1\n").arg(cmd.hostname);
         }
 
-        printWriteInfos(s, cmd.fileWriteInfos);
+        printWriteInfos(s, cmd);
         printReadInfos(s, cmd);
     }
 
@@ -137,20 +137,19 @@ CommandPrinterHuman::printReadFileEventEvtlRestore(QFormattedStream& s,
     }
 
     bool printFileContentSuccess {false};
-    QFileThrow f(m_storedFiles.mkPathStringToStoredReadFile(readInfo));
     try {
-        f.open(QFile::OpenModeFlag::ReadOnly);
-        auto mtype = m_mimedb.mimeTypeForData(&f);
+        const QByteArray content = m_storedFiles.readContent(readInfo);
+        auto mtype = m_mimedb.mimeTypeForData(content);
         s.setLineStart(m_indentlvl3);
         if(! mtype.inherits("text/plain")){
             s << qtr("Not printing content (mimetype %1)").arg(mtype.name()) << "\n";
             return;
         }
-        printReadFile(s, f);
+        printReadFile(s, content);
         printFileContentSuccess = true;
 
         if(m_restoreReadFiles){
-            restoreReadFile_safe(readInfo, cmdIdStr, f);
+            restoreReadFile_safe(readInfo, cmdIdStr, content);
         }
     } catch (const QExcIo& e) {
         if(printFileContentSuccess){
@@ -164,9 +163,9 @@ CommandPrinterHuman::printReadFileEventEvtlRestore(QFormattedStream& s,
 }
 
 
-void CommandPrinterHuman::printReadFile(QFormattedStream &s, QFile &f)
+void CommandPrinterHuman::printReadFile(QFormattedStream &s, const QByteArray &content)
 {
-    QTextStream fstream(&f);
+    QTextStream fstream(content);
     int nLinesPrinted = 0;
     while(! fstream.atEnd()){
         QString line = fstream.readLine();
@@ -181,55 +180,55 @@ void CommandPrinterHuman::printReadFile(QFormattedStream &s, QFile &f)
     }
 }
 
-void CommandPrinterHuman::printWriteInfos(QFormattedStream &s, const FileWriteInfos &fileWriteInfos)
+void CommandPrinterHuman::printWriteInfos(QFormattedStream &s, const CommandInfo &cmd)
 {
-    if(fileWriteInfos.isEmpty()){
+    if(cmd.fileWriteCount == 0){
         return;
     }
     s.setLineStart(m_indentlvl1);
     const char dotOrColon = (m_maxCountWfiles == 0) ? '.' : ':';
-    s << qtr("%1 written file(s)%2\n").arg(fileWriteInfos.size()).arg(dotOrColon);
+    s << qtr("%1 written file(s)%2\n").arg(cmd.fileWriteCount).arg(dotOrColon);
     s.setLineStart(m_indentlvl2);
     int counter = 0;
-    for(const auto& f : fileWriteInfos){
+    for(const auto& f : cmd.fileWriteInfos){
         if(counter >= m_maxCountWfiles){
-            if(counter > 0){
-                s << qtr("... and %1 more files.\n")
-                     .arg(fileWriteInfos.size() - m_maxCountWfiles);
-            }
             break;
         }
         s << f.path  + QDir::separator() + f.name
           << "(" + m_userStrConv.bytesToHuman(f.size) + ")"
-          << qtr("Hash:") << ((f.hash.isNull()) ? "-" : QString::number(f.hash.value()))
-          << "\n";
+          << qtr("Hash:") << ((f.hash.isNull()) ? "-" : QString::number(f.hash.value()));
+        if(! f.processExe.isEmpty()){
+            s << qtr("Process:") << f.processExe;
+        }
+        s << "\n";
         ++counter;
     }
-
+    if(counter > 0 && cmd.fileWriteCount > counter){
+        s << qtr("... and %1 more files.\n").arg(cmd.fileWriteCount - counter);
+    }
 }
 
 void CommandPrinterHuman::printReadInfos(QFormattedStream &s, const CommandInfo &cmd)
 {
-    if(cmd.fileReadInfos.isEmpty()){
+    if(cmd.fileReadCount == 0){
         return;
     }
     s.setLineStart(m_indentlvl1);
 
     const char dotOrColon = (m_maxCountRfiles == 0) ? '.' : ':';
-    s << qtr("%1 read file(s)%2\n").arg(cmd.fileReadInfos.size()).arg(dotOrColon);
+    s << qtr("%1 read file(s)%2\n").arg(cmd.fileReadCount).arg(dotOrColon);
     const QString cmdIdStr = QString::number(cmd.idInDb);
     int counter = 0;
     for(const auto & f : cmd.fileReadInfos){
         if(counter >= m_maxCountRfiles){
-            if(counter > 0){
-                s << qtr("... and %1 more files.\n")
-                     .arg(cmd.fileReadInfos.size() - m_maxCountRfiles);
-            }
             break;
         }
         printReadFileEventEvtlRestore(s, f, cmdIdStr);
         ++counter;
     }
+    if(counter > 0 && cmd.fileReadCount > counter){
+        s << qtr("... and %1 more files.\n").arg(cmd.fileReadCount - counter);
+    }
 }
 
 
@@ -239,3 +238,8 @@ void CommandPrinterHuman::setMaxCountOfReadFileLines(int maxCountOfReadFileLines
 {
     m_maxCountOfReadFileLines = maxCountOfReadFileLines;
 }
+
+CmdQueryProjection CommandPrinterHuman::queryProjection() const
+{
+    return queryProjectionWithDirStats();
+}
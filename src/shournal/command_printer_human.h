@@ -12,6 +12,7 @@ public:
     CommandPrinterHuman() = default;
 
     void printCommandInfosEvtlRestore(std::unique_ptr<CommandQueryIterator>& cmdIter) override;
+    CmdQueryProjection queryProjection() const override;
 
     virtual void setMaxCountOfReadFileLines(int maxCountOfReadFileLines);
 
@@ -20,9 +21,9 @@ protected:
 
     void printReadFileEventEvtlRestore(QFormattedStream& s, const FileReadInfo& readInfo,
                                        const QString& cmdIdStr);
-    void printReadFile(QFormattedStream& s, QFile& f);
+    void printReadFile(QFormattedStream& s, const QByteArray& content);
 
-    void printWriteInfos(QFormattedStream& s, const FileWriteInfos& fileWriteInfos);
+    void printWriteInfos(QFormattedStream& s, const CommandInfo& cmd);
     void printReadInfos(QFormattedStream& s, const CommandInfo& cmd);
 
     QMimeDatabase m_mimedb;
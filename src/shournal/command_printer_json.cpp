@@ -22,7 +22,17 @@ void CommandPrinterJson::printCommandInfosEvtlRestore(std::unique_ptr<CommandQue
         outstream << "HEADER:" << doc.toJson(QJsonDocument::Compact) << "\n";
     }
 
+    // continuation tokens for --before/--after
+    QJsonValue pageCursorFirst;
+    QJsonValue pageCursorLast;
     while(cmdIter->next()){
+        const QString cursor = QString("%1,%2")
+                .arg(cmdIter->value().startTime.toMSecsSinceEpoch())
+                .arg(cmdIter->value().idInDb);
+        if(pageCursorFirst.isNull()){
+            pageCursorFirst = cursor;
+        }
+        pageCursorLast = cursor;
         QJsonObject cmdObject;
         cmdIter->value().write(cmdObject);
         QJsonDocument doc(cmdObject);
@@ -44,7 +54,15 @@ void CommandPrinterJson::printCommandInfosEvtlRestore(std::unique_ptr<CommandQue
         footer["restorePath"] =QJsonValue::fromVariant(
                     (m_countOfRestoredFiles == 0) ? QVariant() : m_restoreDir.absolutePath() );
         footer["countOfRestoredFiles"] = m_countOfRestoredFiles;
+        footer["pageCursorFirst"] = pageCursorFirst;
+        footer["pageCursorLast"] = pageCursorLast;
         QJsonDocument doc(footer);
         outstream << "FOOTER:" << doc.toJson(QJsonDocument::Compact) << "\n";
     }
 }
+
+/// All file events are written, statistics are not collected.
+CmdQueryProjection CommandPrinterJson::queryProjection() const
+{
+    return CmdQueryProjection();
+}
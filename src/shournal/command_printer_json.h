@@ -8,6 +8,7 @@ public:
     CommandPrinterJson() = default;
 
     void printCommandInfosEvtlRestore(std::unique_ptr<CommandQueryIterator>& cmdIter) override;
+    CmdQueryProjection queryProjection() const override;
 
 private:
     Q_DISABLE_COPY(CommandPrinterJson)
@@ -79,3 +79,12 @@ QString testhelper::readStringFromFile(const QString &fpath)
     return stream.readAll();
 
 }
+
+
+/// Benchmarks take long or need lots of resources, so they only run, if
+/// SHOURNAL_TEST_BENCHMARKS is set, e.g.
+/// SHOURNAL_TEST_BENCHMARKS=1 ./runTests
+bool testhelper::benchmarksEnabled()
+{
+    return ! qgetenv("SHOURNAL_TEST_BENCHMARKS").isEmpty();
+}
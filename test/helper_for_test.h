@@ -12,6 +12,8 @@ std::shared_ptr<QTemporaryDir> mkAutoDelTmpDir();
 void writeStringToFile(const QString& filepath, const QString& str);
 QString readStringFromFile(const QString& fpath);
 
+bool benchmarksEnabled();
+
 }
 
 
@@ -1,5 +1,16 @@
 
+#include <algorithm>
+#include <cstring>
+#include <ctime>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+#include <sched.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 
 #include "autotest.h"
 #include "qoutstream.h"
@@ -13,9 +24,15 @@
 #include "qsimplecfg/cfg.h"
 #include "settings.h"
 #include "database/storedfiles.h"
+#include "app.h"
+#include "fdcommunication.h"
+#include "observer_daemon_socket.h"
+#include "socket_message.h"
 
 using subprocess::Subprocess;
 using db_controller::QueryColumns;
+using fdcommunication::SocketCommunication;
+using socket_message::E_SocketMsg;
 
 namespace  {
 
@@ -56,6 +73,65 @@ int callWithRedirectedStdin(Subprocess& proc){
     return pipe_[1];
 }
 
+bool observerDaemonRunning(){
+    const int fd = observer_daemon_socket::connect();
+    if(fd == -1){
+        return false;
+    }
+    os::close(fd);
+    return true;
+}
+
+/// @return true, if pred became true within timeoutMs
+template <class Pred>
+bool waitUntil(Pred pred, int timeoutMs){
+    for(int waited=0; ! pred(); waited += 100){
+        if(waited >= timeoutMs){
+            return false;
+        }
+        QThread::msleep(100);
+    }
+    return true;
+}
+
+/// Connect to the observer daemon from a child within a new mount-namespace.
+/// @return 0, if the daemon closed the connection (rejected us), 1 if not
+/// rejected and 2, if the mount-namespace could not be created.
+int connectFromOtherMountNs(){
+    const QByteArray sockPath = observer_daemon_socket::path().toLocal8Bit();
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sockPath.constData(), sizeof (addr.sun_path) - 1);
+
+    const pid_t pid = os::fork();
+    if(pid == 0){
+        // unprivileged, a user-namespace is required as well
+        if(unshare(CLONE_NEWNS) == -1 && unshare(CLONE_NEWUSER | CLONE_NEWNS) == -1){
+            _exit(2);
+        }
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd == -1 ||
+                connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof (addr)) == -1){
+            _exit(1);
+        }
+        struct pollfd pfd {fd, POLLIN, 0};
+        char c;
+        if(poll(&pfd, 1, 10000) == 1 && recv(fd, &c, 1, 0) == 0){
+            _exit(0);
+        }
+        _exit(1);
+    }
+    int status = 1;
+    os::waitpid(pid, &status);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+qint64 realtimeNs(){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return qint64(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
 
 } // anonymous namespace
 
@@ -86,6 +162,67 @@ private:
     }
 
 
+    /// Keys not passed get their default value.
+    void writeShellIntegrationToCfgFile(const QVector<QPair<const char*, bool>>& values){
+        auto & sets = Settings::instance();
+        qsimplecfg::Cfg cfg;
+        auto sectShell = cfg[Settings::SECT_SHELL_NAME];
+        for(const auto& keyVal : values){
+            sectShell->getValue(keyVal.first, keyVal.second, true);
+        }
+        auto cfgPath = sets.cfgFilepath();
+        QDir().mkpath(QFileInfo(cfgPath).absolutePath());
+        cfg.store(cfgPath);
+    }
+
+    void writeStandbyObserverToCfgFile(bool standbyObserver){
+        writeShellIntegrationToCfgFile({{Settings::SECT_SHELL_STANDBY_OBSERVER, standbyObserver}});
+    }
+
+    /// Pass cmdCount commands to an observed shell, each after a pause (like a
+    /// typing user), which append the time of their exec to timestampPath.
+    /// @param latenciesUs: the times in microseconds from passing the command
+    /// line to the shell until the exec of the command.
+    void measurePromptToExecLatency(const QString& timestampPath, int cmdCount,
+                                    const std::string& setupCommand,
+                                    QVector<qint64>& latenciesUs){
+        auto pipe_ = prepareHighFdNumberPipe();
+        Subprocess proc;
+        proc.setForwardFdsOnExec({pipe_[1]});
+        int writeFd = callWithRedirectedStdin(proc);
+        os::close(pipe_[1]);
+
+        if(! setupCommand.empty()){
+            writeLine(writeFd, setupCommand);
+        }
+        writeLine(writeFd, "SHOURNAL_ENABLE");
+
+        const std::string cmd = "/bin/date +%s%N >> " + timestampPath.toStdString();
+        QVector<qint64> writeTimes;
+        for(int i=0; i < cmdCount; i++){
+            // let the previous command finish and a standby observer set up
+            QThread::msleep(300);
+            writeTimes.push_back(realtimeNs());
+            writeLine(writeFd, cmd);
+        }
+        writeLine(writeFd, "SHOURNAL_DISABLE");
+        writeLine(writeFd, "exit 123");
+
+        os::close(writeFd);
+        QCOMPARE(proc.waitFinish(), 123);
+        char c;
+        // wait for shournal grand-child processes to finish (close their write end)
+        os::read(pipe_[0], &c, 1);
+        os::close(pipe_[0]);
+
+        const auto execTimes = testhelper::readStringFromFile(timestampPath)
+                .split('\n', QString::SkipEmptyParts);
+        QCOMPARE(execTimes.size(), cmdCount);
+        for(int i=0; i < cmdCount; i++){
+            latenciesUs.push_back((execTimes[i].toLongLong() - writeTimes[i]) / 1000);
+        }
+    }
+
     /// @param cmd: the command to be executed
     /// @param setupCommand: command executed before SHOURNAL_ENABLE
     void executeCmdInbservedShell(const std::string& cmd, const std::string& setupCommand){
@@ -118,7 +255,60 @@ private:
         executeCmdInbservedShell(cmd.toStdString(), setupCommand);
     }
 
+    struct ObservedShell {
+        Subprocess proc;
+        int writeFd {-1};
+        int pipeReadFd {-1};
+    };
+
+    void startObservedShell(ObservedShell& shell, const std::string& setupCommand){
+        auto pipe_ = prepareHighFdNumberPipe();
+        shell.proc.setForwardFdsOnExec({pipe_[1]});
+        shell.writeFd = callWithRedirectedStdin(shell.proc);
+        os::close(pipe_[1]);
+        shell.pipeReadFd = pipe_[0];
+
+        if(! setupCommand.empty()){
+            writeLine(shell.writeFd, setupCommand);
+        }
+        writeLine(shell.writeFd, "SHOURNAL_ENABLE");
+    }
+
+    void finishObservedShell(ObservedShell& shell){
+        writeLine(shell.writeFd, "SHOURNAL_DISABLE");
+        writeLine(shell.writeFd, "exit 123");
+
+        os::close(shell.writeFd);
+        QCOMPARE(shell.proc.waitFinish(), 123);
+        char c;
+        // wait for the session observer to finish (close its write end)
+        os::read(shell.pipeReadFd, &c, 1);
+        os::close(shell.pipeReadFd);
+    }
+
+    /// Execute all cmds within one observed shell session.
+    void executeCmdsInObservedShell(const QStringList& cmds, const std::string& setupCommand){
+        ObservedShell shell;
+        startObservedShell(shell, setupCommand);
+        for(const auto& cmd : cmds){
+            writeLine(shell.writeFd, cmd.toStdString());
+        }
+        finishObservedShell(shell);
+    }
 
+    /// Append the texts and session uuids of the commands which wrote dir/fname
+    void queryWritingCmds(const QString& dir, const QString& fname, QStringList& texts,
+                          QVector<QByteArray>& sessionUuids){
+        const auto & cols = QueryColumns::instance();
+        SqlQuery query;
+        query.addWithAnd(cols.wFile_path, dir);
+        query.addWithAnd(cols.wFile_name, fname);
+        auto cmdIter = db_controller::queryForCmd(query);
+        while(cmdIter->next()){
+            texts.push_back(cmdIter->value().text);
+            sessionUuids.push_back(cmdIter->value().sessionInfo.uuid);
+        }
+    }
 
     void cmdWrittenFileCheck(const std::string& cmd, const std::string& fpath,
                              const std::string& setupCommand){
@@ -154,6 +344,9 @@ private slots:
                     "cd " + tmpDirPath + "; echo hi > f1",
                     "cd " + tmpDirPath + "; echo hi > ./f1",
                     "cd " + tmpDirPath + "; echo hi > ../" + splitAbsPath(tmpDirPath).second + "/f1",
+                    // the cached working directory must follow cd (also in subshells)
+                    "cd /; : < ./dev/null; cd " + tmpDirPath + "; echo hi > f1",
+                    "cd /; : < ./dev/null; (cd " + tmpDirPath + "; echo hi > f1)",
         };
 
         const auto setupCmd = AutoTest::globals().integrationSetupCommand;
@@ -229,19 +422,393 @@ private slots:
         QCOMPARE(fReadInfo.name, fname);
         QCOMPARE(fReadInfo.path, pTmpDir->path());
         QCOMPARE(fReadInfo.isStoredToDisk, true);
-        StoredFiles storedFiles;
-        const QString pathToFileInDb = StoredFiles::getReadFilesDir() + "/" +
-                QString::number(fReadInfo.idInDb);
-        QFileThrow fInDb(pathToFileInDb);
-        QVERIFY(fInDb.exists());
-        fInDb.open(QFile::ReadOnly);
-        QCOMPARE(content, testhelper::readStringFromFile(fullPath));
+        QVERIFY(! fReadInfo.blobHash.isEmpty());
+        QCOMPARE(StoredFiles().readContent(fReadInfo), content.toUtf8());
 
         QVERIFY(! cmdIter->next());
     }
 
+    /// With session_observer, one observer serves all commands of the shell
+    /// session (BEGIN_COMMAND/END_COMMAND), yet each command must be stored
+    /// separately with its own text, return value and file events. File events
+    /// between two commands are discarded.
+    void testSessionObserver(){
+        testhelper::deletePaths();
+        writeShellIntegrationToCfgFile({{Settings::SECT_SHELL_SESSION_OBSERVER, true}});
+        auto resetCfg = finally([this] { writeShellIntegrationToCfgFile({}); });
+        auto pTmpDir = testhelper::mkAutoDelTmpDir();
+        const QString dir = pTmpDir->path();
+        const QStringList cmds {
+            "echo one > " + dir + "/f1",
+            "echo two > " + dir + "/f2; (exit 3)",
+            "true",
+            "cd " + dir + "; echo three > f3; echo four >> f1",
+        };
+        executeCmdsInObservedShell(cmds, AutoTest::globals().integrationSetupCommand);
+
+        const auto & cols = QueryColumns::instance();
+        auto dbCleanup = finally([] { db_connection::close(); });
+        QVector<qint64> cmdIds;
+        QVector<QByteArray> sessionUuids;
+        const auto checkCmds = [&](const QString& fname, const QStringList& expectedTexts,
+                                   const QVector<int>& expectedReturnVals){
+            SqlQuery query;
+            query.addWithAnd(cols.wFile_path, dir);
+            query.addWithAnd(cols.wFile_name, fname);
+            auto cmdIter = db_controller::queryForCmd(query);
+            QStringList texts;
+            QVector<int> returnVals;
+            while(cmdIter->next()){
+                const auto cmd = cmdIter->value();
+                texts.push_back(cmd.text);
+                returnVals.push_back(cmd.returnVal);
+                if(! cmdIds.contains(cmd.idInDb)){
+                    cmdIds.push_back(cmd.idInDb);
+                }
+                sessionUuids.push_back(cmd.sessionInfo.uuid);
+            }
+            QCOMPARE(texts, expectedTexts);
+            QCOMPARE(returnVals, expectedReturnVals);
+        };
+        checkCmds("f1", {cmds[0], cmds[3]}, {0, 0});
+        checkCmds("f2", {cmds[1]}, {3});
+        checkCmds("f3", {cmds[3]}, {0});
+        if(QTest::currentTestFailed()){
+            return;
+        }
+        QCOMPARE(cmdIds.size(), 3);
+        QVERIFY(! sessionUuids.first().isNull());
+        for(const auto& uuid : sessionUuids){
+            QCOMPARE(uuid, sessionUuids.first());
+        }
+    }
+
+    /// More file events than flushed at once, which occur while no command is
+    /// executed (by a background job), are discarded instead of being stored
+    /// as a command without text.
+    void testSessionObserverEventsBetweenCmds(){
+        testhelper::deletePaths();
+        writeShellIntegrationToCfgFile({{Settings::SECT_SHELL_SESSION_OBSERVER, true}});
+        auto resetCfg = finally([this] { writeShellIntegrationToCfgFile({}); });
+        auto pTmpDir = testhelper::mkAutoDelTmpDir();
+        const QString dir = pTmpDir->path();
+        const int countOfBgFiles = Settings::instance().writeFileSettings().flushToDiskEventCount + 500;
+        const QStringList cmds {
+            "echo one > " + dir + "/f1",
+            "(sleep 1; for i in $(seq " + QString::number(countOfBgFiles) + "); do "
+                "echo bg > " + dir + "/bg$i; done; touch " + dir + "/bgdone) &",
+            "echo two > " + dir + "/f2",
+        };
+        ObservedShell shell;
+        startObservedShell(shell, AutoTest::globals().integrationSetupCommand);
+        writeLine(shell.writeFd, cmds[0].toStdString());
+        writeLine(shell.writeFd, cmds[1].toStdString());
+        QVERIFY(waitUntil([&dir] { return QFileInfo::exists(dir + "/bgdone"); }, 30000));
+        // let the observer process the events
+        QThread::msleep(500);
+        writeLine(shell.writeFd, cmds[2].toStdString());
+        finishObservedShell(shell);
+
+        auto dbCleanup = finally([] { db_connection::close(); });
+        SqlQuery query;
+        query.addWithAnd(QueryColumns::instance().wFile_path, dir);
+        auto cmdIter = db_controller::queryForCmd(query);
+        QStringList texts;
+        while(cmdIter->next()){
+            texts.push_back(cmdIter->value().text);
+        }
+        QCOMPARE(texts, QStringList({cmds[0], cmds[2]}));
+    }
+
+    /// With observer_daemon, the session observers are hosted by a single
+    /// daemon, which is launched on demand: the first session falls back to
+    /// a session observer of its own. Sessions run concurrently, connections
+    /// from another mount-namespace are rejected and the daemon exits once idle.
+    void testObserverDaemon(){
+        testhelper::deletePaths();
+        const int idleTimeoutMs = 4000;
+        os::setenv<QByteArray>("_SHOURNAL_DAEMON_IDLE_TIMEOUT_MS",
+                               QByteArray::number(idleTimeoutMs));
+        writeShellIntegrationToCfgFile({{Settings::SECT_SHELL_SESSION_OBSERVER, true},
+                                        {Settings::SECT_SHELL_OBSERVER_DAEMON, true}});
+        auto resetCfg = finally([this] { writeShellIntegrationToCfgFile({}); });
+        QVERIFY(waitUntil([] { return ! observerDaemonRunning(); }, idleTimeoutMs * 2));
 
+        const auto setupCmd = AutoTest::globals().integrationSetupCommand;
+        auto pTmpDir = testhelper::mkAutoDelTmpDir();
+        const QString dir = pTmpDir->path();
+
+        // no daemon yet: observed by a session observer of its own
+        const QString fallbackCmd = "echo fallback > " + dir + "/f0";
+        executeCmdsInObservedShell({fallbackCmd}, setupCmd);
+        QVERIFY(waitUntil(observerDaemonRunning, 5000));
+
+        // handshake of a session registered by hand
+        const int daemonFd = observer_daemon_socket::connect();
+        QVERIFY(daemonFd != -1);
+        auto sockets = os::socketpair(PF_UNIX, SOCK_STREAM);
+        SocketCommunication daemonCom;
+        daemonCom.setSockFd(daemonFd);
+        daemonCom.sendMsg({int(E_SocketMsg::REGISTER_SESSION),
+                           QByteArray(16, 'u'), sockets[0]});
+        os::close(sockets[0]);
+        os::close(daemonFd);
+        SocketCommunication sessionCom;
+        sessionCom.setReceiveBufferSize(1024);
+        sessionCom.setSockFd(sockets[1]);
+        auto closeSession = finally([&sockets] { os::close(sockets[1]); });
+        auto messages = sessionCom.receiveMessages();
+        QCOMPARE(messages.size(), 1);
+        QCOMPARE(messages.first().msgId, int(E_SocketMsg::SETUP_DONE));
+        QVERIFY(messages.first().fd != -1);
+        os::close(messages.first().fd);
+        sessionCom.sendMsg({int(E_SocketMsg::BEGIN_COMMAND), dir.toLocal8Bit()});
+        messages = sessionCom.receiveMessages();
+        QCOMPARE(messages.size(), 1);
+        QCOMPARE(messages.first().msgId, int(E_SocketMsg::BEGIN_COMMAND));
+
+        // two more concurrent sessions
+        ObservedShell shellA;
+        ObservedShell shellB;
+        startObservedShell(shellA, setupCmd);
+        startObservedShell(shellB, setupCmd);
+        const QStringList cmdsA {"echo a1 > " + dir + "/a1", "echo a2 > " + dir + "/a2"};
+        const QStringList cmdsB {"echo b1 > " + dir + "/b1", "echo b2 > " + dir + "/b2"};
+        for(int i=0; i < cmdsA.size(); i++){
+            writeLine(shellA.writeFd, cmdsA[i].toStdString());
+            writeLine(shellB.writeFd, cmdsB[i].toStdString());
+        }
+        finishObservedShell(shellA);
+        finishObservedShell(shellB);
+
+        // SO_PEERCRED: other users cannot even reach the private socket
+        // directory, so check the mount-namespace of the peer instead.
+        const int otherNsRet = connectFromOtherMountNs();
+        if(otherNsRet == 2){
+            QWARN("failed to create a mount-namespace, skipping the rejection check");
+        } else {
+            QCOMPARE(otherNsRet, 0);
+        }
+        QVERIFY(observerDaemonRunning());
 
+        // the commands are stored by the daemon asynchronously
+        auto dbCleanup = finally([] { db_connection::close(); });
+        QStringList texts;
+        QVector<QByteArray> uuids;
+        const auto fnames = {"f0", "a1", "a2", "b1", "b2"};
+        QVERIFY(waitUntil([&] {
+            texts.clear();
+            uuids.clear();
+            for(const char* fname : fnames){
+                queryWritingCmds(dir, fname, texts, uuids);
+            }
+            db_connection::close();
+            return texts.size() == 5;
+        }, 5000));
+        QCOMPARE(texts, QStringList({fallbackCmd, cmdsA[0], cmdsA[1], cmdsB[0], cmdsB[1]}));
+        QCOMPARE(uuids[1], uuids[2]);
+        QCOMPARE(uuids[3], uuids[4]);
+        QVERIFY(uuids[0] != uuids[1]);
+        QVERIFY(uuids[1] != uuids[3]);
+
+        closeSession.setEnabled(false);
+        os::close(sockets[1]);
+        QVERIFY(waitUntil([] { return ! observerDaemonRunning(); }, idleTimeoutMs * 2));
+    }
+
+    /// Compare the latency from prompt to exec of a session observer launched
+    /// by the shell and one hosted by the (already running) observer daemon.
+    /// The results are printed, not asserted.
+    void testObserverDaemonLatency(){
+        if(! testhelper::benchmarksEnabled()){
+            QSKIP("benchmarks disabled");
+        }
+        const int cmdCount = 10;
+        os::setenv<QByteArray>("_SHOURNAL_DAEMON_IDLE_TIMEOUT_MS", "60000");
+        auto resetCfg = finally([this] { writeShellIntegrationToCfgFile({}); });
+        for(bool observerDaemon : {false, true}){
+            testhelper::deletePaths();
+            writeShellIntegrationToCfgFile({{Settings::SECT_SHELL_SESSION_OBSERVER, true},
+                                            {Settings::SECT_SHELL_OBSERVER_DAEMON,
+                                             observerDaemon}});
+            if(observerDaemon){
+                // the first session only launches the daemon
+                executeCmdsInObservedShell({"true"}, AutoTest::globals().integrationSetupCommand);
+                QVERIFY(waitUntil(observerDaemonRunning, 5000));
+            }
+            auto pTmpDir = testhelper::mkAutoDelTmpDir();
+            QVector<qint64> latenciesUs;
+            measurePromptToExecLatency(pTmpDir->path() + "/timestamps", cmdCount,
+                                       AutoTest::globals().integrationSetupCommand,
+                                       latenciesUs);
+            if(QTest::currentTestFailed()){
+                return;
+            }
+            std::sort(latenciesUs.begin(), latenciesUs.end());
+            QOut() << "prompt-to-exec latency of a session observer "
+                   << (observerDaemon ? "within the daemon" : "of its own") << ": "
+                   << "median " << latenciesUs[cmdCount / 2] << "us, "
+                   << "max " << latenciesUs.last() << "us\n";
+        }
+    }
+
+    /// Compare the latency from prompt to exec without and with
+    /// standby observer. Results are printed, not asserted, as they
+    /// depend on the machine.
+    void testStandbyObserverLatency(){
+        if(! testhelper::benchmarksEnabled()){
+            QSKIP("benchmarks disabled");
+        }
+        const auto setupCmd = AutoTest::globals().integrationSetupCommand;
+        const int cmdCount = 10;
+
+        auto resetCfg = finally([this] { writeShellIntegrationToCfgFile({}); });
+        for(bool standbyObserver : {false, true}){
+            testhelper::deletePaths();
+            writeStandbyObserverToCfgFile(standbyObserver);
+            auto pTmpDir = testhelper::mkAutoDelTmpDir();
+            const QString timestampPath = pTmpDir->path() + "/timestamps";
+
+            QVector<qint64> latenciesUs;
+            measurePromptToExecLatency(timestampPath, cmdCount, setupCmd, latenciesUs);
+            if(QTest::currentTestFailed()){
+                return;
+            }
+            std::sort(latenciesUs.begin(), latenciesUs.end());
+            qint64 sum = 0;
+            for(qint64 l : latenciesUs){
+                sum += l;
+            }
+            QOut() << "prompt-to-exec latency with standby observer "
+                   << (standbyObserver ? "on" : "off") << ": "
+                   << "avg " << sum / cmdCount << "us, "
+                   << "median " << latenciesUs[cmdCount / 2] << "us\n";
+
+            // all commands must have been observed
+            SqlQuery query;
+            file_query_helper::addWrittenFileSmart(query, timestampPath);
+            auto cmdIter = db_controller::queryForCmd(query);
+            auto dbCleanup = finally([] { db_connection::close(); });
+            int countOfCmds = 0;
+            while(cmdIter->next()){
+                ++countOfCmds;
+            }
+            QCOMPARE(countOfCmds, cmdCount);
+        }
+    }
+
+    /// Every exec within an observed command passes through shournal-msenter,
+    /// so compare the average time per fork+exec of a loop of /bin/true
+    /// without and with observation. The results are printed, not asserted.
+    void testExecLatency(){
+        if(! testhelper::benchmarksEnabled()){
+            QSKIP("benchmarks disabled");
+        }
+        const int execCount = 500;
+        auto pTmpDir = testhelper::mkAutoDelTmpDir();
+        const QString unobservedPath = pTmpDir->path() + "/unobserved";
+        const QString observedPath = pTmpDir->path() + "/observed";
+        const auto measureCmd = [execCount](const QString& resultPath){
+            return QString("s=$(/bin/date +%s%N); "
+                           "for ((i=0; i<%1; i++)); do /bin/true; done; "
+                           "e=$(/bin/date +%s%N); "
+                           "echo $(( (e - s) / %1 / 1000 )) > %2")
+                    .arg(execCount).arg(resultPath).toStdString();
+        };
+        testhelper::deletePaths();
+        executeCmdInbservedShell(measureCmd(observedPath),
+                                 AutoTest::globals().integrationSetupCommand + "; " +
+                                 measureCmd(unobservedPath));
+
+        const QString unobservedUs = testhelper::readStringFromFile(unobservedPath).trimmed();
+        const QString observedUs = testhelper::readStringFromFile(observedPath).trimmed();
+        QVERIFY(! unobservedUs.isEmpty());
+        QVERIFY(! observedUs.isEmpty());
+        QOut() << "per-exec latency unobserved: " << unobservedUs << "us, "
+               << "observed: " << observedUs << "us\n";
+    }
+
+    /// All commands of a batch are observed by one shournal-run, but
+    /// stored separately. The first failing command ends the batch.
+    void testExecBatch(){
+        testhelper::deletePaths();
+        auto pTmpDir = testhelper::mkAutoDelTmpDir();
+        const QString f1 = pTmpDir->path() + "/f1";
+        const QString f2 = pTmpDir->path() + "/f2";
+        const QString f3 = pTmpDir->path() + "/f3";
+        const QStringList cmds {
+            "echo one > " + f1,
+            "",
+            "echo two > " + f2 + "; exit 3",
+            "echo three > " + f3,
+        };
+        const QString batchPath = pTmpDir->path() + "/batch";
+        QFile batchFile(batchPath);
+        QVERIFY(batchFile.open(QFile::OpenModeFlag::WriteOnly));
+        batchFile.write(cmds.join('\n').toLocal8Bit());
+        batchFile.close();
+
+        Subprocess proc;
+        proc.call({app::SHOURNAL_RUN, "--exec-batch", batchPath.toStdString()});
+        QCOMPARE(proc.waitFinish(), 3);
+        QVERIFY(! QFile::exists(f3));
+
+        auto dbCleanup = finally([] { db_connection::close(); });
+        QVector<int> returnVals;
+        QVector<QByteArray> sessionUuids;
+        for(const auto& f : {f1, f2}){
+            SqlQuery query;
+            file_query_helper::addWrittenFileSmart(query, f);
+            auto cmdIter = db_controller::queryForCmd(query);
+            QVERIFY(cmdIter->next());
+            returnVals.push_back(cmdIter->value().returnVal);
+            sessionUuids.push_back(cmdIter->value().sessionInfo.uuid);
+            QVERIFY(! cmdIter->next());
+        }
+        QCOMPARE(returnVals, QVector<int>({0, 3}));
+        QVERIFY(! sessionUuids[0].isNull());
+        QCOMPARE(sessionUuids[0], sessionUuids[1]);
+    }
+
+    /// The interposed open of the shell is called for every redirection,
+    /// so compare the average time per open of a plain shell, a shell
+    /// with shournal preloaded but disabled and an observed shell.
+    /// The results are printed, not asserted.
+    void testOpenOverhead(){
+        if(! testhelper::benchmarksEnabled()){
+            QSKIP("benchmarks disabled");
+        }
+        const int openCount = 20000;
+        auto pTmpDir = testhelper::mkAutoDelTmpDir();
+        const QString inputPath = pTmpDir->path() + "/input";
+        QVERIFY(QFile(inputPath).open(QFile::OpenModeFlag::WriteOnly));
+        const QString plainPath = pTmpDir->path() + "/plain";
+        const QString disabledPath = pTmpDir->path() + "/disabled";
+        const QString observedPath = pTmpDir->path() + "/observed";
+        const auto measureCmd = [openCount, &inputPath](const QString& resultPath){
+            return QString("s=$(/bin/date +%s%N); "
+                           "for ((i=0; i<%1; i++)); do : < %2; done; "
+                           "e=$(/bin/date +%s%N); "
+                           "echo $(( (e - s) / %1 )) > %3")
+                    .arg(openCount).arg(inputPath, resultPath).toStdString();
+        };
+        const std::string plainCmd = "env -u LD_PRELOAD /bin/bash -c '" +
+                                     measureCmd(plainPath) + "'";
+        testhelper::deletePaths();
+        executeCmdInbservedShell(measureCmd(observedPath),
+                                 AutoTest::globals().integrationSetupCommand + "; " +
+                                 plainCmd + "; " + measureCmd(disabledPath));
+
+        const QString plainNs = testhelper::readStringFromFile(plainPath).trimmed();
+        const QString disabledNs = testhelper::readStringFromFile(disabledPath).trimmed();
+        const QString observedNs = testhelper::readStringFromFile(observedPath).trimmed();
+        QVERIFY(! plainNs.isEmpty());
+        QVERIFY(! disabledNs.isEmpty());
+        QVERIFY(! observedNs.isEmpty());
+        QOut() << "per-open latency plain: " << plainNs << "ns, "
+               << "preloaded but disabled: " << disabledNs << "ns, "
+               << "observed: " << observedNs << "ns\n";
+    }
 
 };
 
@@ -1,5 +1,10 @@
 
 #include <QTest>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSet>
 
 
 #include "autotest.h"
@@ -8,10 +13,14 @@
 #include "database/fileinfos.h"
 
 #include "database/db_controller.h"
+#include "database/db_partitions.h"
 #include "database/db_connection.h"
 #include "database/query_columns.h"
 #include "database/db_conversions.h"
 #include "database/storedfiles.h"
+#include "database/sqlite_database_scheme.h"
+#include "database/sqlite_database_scheme_updates.h"
+#include "qexcdatabase.h"
 #include "cleanupresource.h"
 #include "settings.h"
 
@@ -53,6 +62,17 @@ FileWriteEvent generateFileWriteEvent(){
     return  e;
 }
 
+/// The read files (scripts) of generated read events
+ScriptStaging& testStaging(){
+    static ScriptStaging staging;
+    return staging;
+}
+
+void stageScript(FileReadEvent& e, const QByteArray& bytes){
+    e.stagedOffset = testStaging().size();
+    e.stagedSize = testStaging().append(bytes);
+}
+
 FileReadEvent generateFileReadEvent(){
     static auto hash_ = std::numeric_limits<uint64_t>::max();
     static int id_ = 1;
@@ -60,7 +80,7 @@ FileReadEvent generateFileReadEvent(){
     FileReadEvent e;
     e.mode = S_IREAD;
     e.size = id_;
-    e.bytes = QByteArray::number(id_);
+    stageScript(e, QByteArray::number(id_));
     e.mtime = QDateTime(QDate(2019,1, id_ % 28)).toTime_t();
     e.fullPath = "/tmp/" + std::to_string(id_) + ".txt";
     e.hash = hash_;
@@ -77,7 +97,7 @@ FileWriteInfo fileWriteEventToWriteInfo(const FileWriteEvent& e){
     i.path = QString::fromStdString(splittedPah.first);
     i.name = QString::fromStdString(splittedPah.second);
     i.size = e.size;
-    i.mtime = db_conversions::fromMtime(e.mtime).toDateTime();
+    i.mtime = db_conversions::toDateTime(db_conversions::fromMtime(e.mtime));
     return i;
 }
 
@@ -91,7 +111,7 @@ FileReadInfo fileReadEventToReadInfo(const FileReadEvent& e){
     i.path = QString::fromStdString(splittedPah.first);
     i.name = QString::fromStdString(splittedPah.second);
     i.size = e.size;
-    i.mtime = db_conversions::fromMtime(e.mtime).toDateTime();
+    i.mtime = db_conversions::toDateTime(db_conversions::fromMtime(e.mtime));
     i.hash = e.hash;
     return i;
 }
@@ -112,7 +132,65 @@ void sortFileReadInfos(FileReadInfos & fInos){
 }
 
 int countStoredFiles(){
-    return QDir(StoredFiles::getReadFilesDir()).entryList(QDir::Filter::NoDotDot | QDir::Files).size();
+    auto query = db_connection::mkQuery();
+    query->exec("select count(*) from blobs.blob");
+    query->next(true);
+    return query->value(0).toInt() +
+            QDir(StoredFiles::getReadFilesDir()).entryList(QDir::Filter::NoDotDot | QDir::Files).size();
+}
+
+QDateTime legacyCmdTime(int i){
+    return QDateTime(QDate(2019, 1, 1), QTime(12, 0)).addMSecs(qint64(i) * 60001);
+}
+
+HashValue legacyHash(int i){
+    return std::numeric_limits<uint64_t>::max() - uint64_t(i);
+}
+
+/// Create a database in the format of shournal 2.3 (text-timestamps, blob-hashes,
+/// no dictionary tables) with nCmds commands and two written files each.
+void createLegacyDb(int nCmds){
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "legacy");
+        db.setDatabaseName(db_connection::mkDbPath() + "/database.db");
+        if(! db.open()){
+            throw QExcDatabase(__func__, db.lastError());
+        }
+        QSqlQueryThrow query(db);
+        query.transaction();
+        for(const QString& stmt : QString(SQLITE_DATABASE_SCHEME).split(';', QString::SkipEmptyParts)){
+            query.exec(stmt);
+        }
+        sqlite_database_scheme_updates::v0_9(query);
+        sqlite_database_scheme_updates::v2_1(query);
+        sqlite_database_scheme_updates::v2_2(query);
+        query.exec("replace into version (id, ver) values (1, '2.3')");
+        query.exec("insert into env (id, username, hostname) values (1, 'myuser', 'myhost')");
+
+        for(int i=0; i < nCmds; i++){
+            query.prepare("insert into cmd (envId,txt,returnVal,startTime,endTime,workingDirectory) "
+                          "values (1,?,0,?,?,?)");
+            query.addBindValue("cmd " + QString::number(i % 100));
+            query.addBindValue(legacyCmdTime(i));
+            query.addBindValue(legacyCmdTime(i).addSecs(1));
+            query.addBindValue("/home/user/" + QString::number(i % 50));
+            query.exec();
+            const QVariant cmdId = query.lastInsertId();
+            for(int j=0; j < 2; j++){
+                query.prepare("insert into writtenFile (cmdId,path,name,mtime,size,hash) "
+                              "values (?,?,?,?,?,?)");
+                query.addBindValue(cmdId);
+                query.addBindValue("/tmp/" + QString::number(i % 1000));
+                query.addBindValue(QString::number(j) + ".txt");
+                query.addBindValue(legacyCmdTime(i));
+                query.addBindValue(j);
+                query.addBindValue(qBytesFromVar(legacyHash(i*2 + j).value()));
+                query.exec();
+            }
+        }
+        query.commit();
+    }
+    QSqlDatabase::removeDatabase("legacy");
 }
 
 int deleteCommandInDb(qint64 id)
@@ -152,7 +230,7 @@ private slots:
         auto closeDb = finally([] {
             db_connection::close();
         });
-        db_controller::addFileEvents(cmd1, fInfos, FileReadEventHash());
+        db_controller::addFileEvents(cmd1, fInfos, FileReadEventHash(), testStaging());
 
         QueryColumns & queryCols = QueryColumns::instance();
         SqlQuery q1;
@@ -164,7 +242,7 @@ private slots:
         sortFileWriteInfos(cmd1Back->value().fileWriteInfos);
         QCOMPARE(cmd1Back->value(), cmd1);
         q1.clear();
-        q1.addWithAnd(queryCols.wFile_hash, qBytesFromVar(fInfo1.hash.value()) );
+        q1.addWithAnd(queryCols.wFile_hash, db_conversions::fromHashValue(fInfo1.hash) );
         cmd1Back = queryForCmd(q1);
         QVERIFY(cmd1Back->next());
         sortFileWriteInfos(cmd1Back->value().fileWriteInfos);
@@ -190,7 +268,7 @@ private slots:
             db_connection::close();
         });
 
-        db_controller::addFileEvents(cmd1, FileWriteEventHash(), readEvents );
+        db_controller::addFileEvents(cmd1, FileWriteEventHash(), readEvents, testStaging());
 
         cmd1.fileReadInfos = {fileReadEventToReadInfo(readEvent1), fileReadEventToReadInfo(readEvent2)};
 
@@ -213,6 +291,84 @@ private slots:
         QCOMPARE(cmd1Back->value(), cmd1);
     }
 
+    void tProcesses(){
+        FileWriteEventHash writeEvents;
+        auto writeEvent1 = generateFileWriteEvent();
+        writeEvent1.pid = 100;
+        writeEvents.insert({1, 1}, writeEvent1);
+        auto writeEvent2 = generateFileWriteEvent();
+        writeEvent2.pid = 101;
+        writeEvents.insert({2, 2}, writeEvent2);
+
+        FileReadEventHash readEvents;
+        auto readEvent1 = generateFileReadEvent();
+        readEvent1.pid = 100;
+        readEvents.insert({3, 3}, readEvent1);
+
+        ProcessInfos processes;
+        auto& make = processes[ProcessKey(100, 0)];
+        make.pid = 100;
+        make.parentPid = 99;
+        make.exe = "/usr/bin/make";
+        make.argv = std::string("make\0all", 8);
+        auto& cc = processes[ProcessKey(101, 0)];
+        cc.pid = 101;
+        cc.parentPid = 100;
+        cc.exe = "/usr/bin/cc";
+        cc.argv = std::string("cc\0-c\0my main.c", 15);
+
+        CommandInfo cmd1 = generateCmdInfo();
+        cmd1.idInDb = db_controller::addCommand(cmd1);
+        auto closeDb = finally([] { db_connection::close(); });
+        db_controller::addFileEvents(cmd1, writeEvents, readEvents, testStaging(), processes);
+        // a second flush of the same command must not duplicate the processes
+        writeEvents.remove({1, 1});
+        db_controller::addFileEvents(cmd1, writeEvents, FileReadEventHash(), testStaging(),
+                                     processes);
+
+        auto query = db_connection::mkQuery();
+        query->exec("select count(*) from process");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 2);
+        // argument boundaries are kept
+        query->exec("select argv from process where pid=101");
+        query->next(true);
+        QCOMPARE(query->value(0).toString(), QString("[\"cc\",\"-c\",\"my main.c\"]"));
+        for(const char* table : {"writtenFile", "readFileCmd"}){
+            query->exec(QString("select count(*) from pragma_foreign_key_list('%1') "
+                                "where `table`='process'").arg(table));
+            query->next(true);
+            QCOMPARE(query->value(0).toInt(), 1);
+        }
+
+        QueryColumns & queryCols = QueryColumns::instance();
+        SqlQuery q1;
+        q1.addWithAnd(queryCols.wFile_processExe, QString("/usr/bin/cc"));
+        auto cmd1Back = queryForCmd(q1);
+        QVERIFY(cmd1Back->next());
+        QCOMPARE(cmd1Back->value().idInDb, cmd1.idInDb);
+        bool ccFound = false;
+        for(const auto& w : cmd1Back->value().fileWriteInfos){
+            if(w.processExe == "/usr/bin/cc"){
+                ccFound = true;
+                QCOMPARE(w.size, qint64(writeEvent2.size));
+            }
+        }
+        QVERIFY(ccFound);
+
+        q1.clear();
+        q1.addWithAnd(queryCols.rFile_processExe, QString("/usr/bin/make"));
+        QVERIFY(queryForCmd(q1)->next());
+        q1.clear();
+        q1.addWithAnd(queryCols.rFile_processExe, QString("/usr/bin/cc"));
+        QVERIFY(! queryForCmd(q1)->next());
+
+        QCOMPARE(deleteCommandInDb(cmd1.idInDb), 1);
+        query->exec("select count(*) from process");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 0);
+    }
+
 
     void tDeleteCommand(){
         ulong fCounter = 1;
@@ -236,7 +392,7 @@ private slots:
         CommandInfo cmd1 = generateCmdInfo();
         cmd1.idInDb = db_controller::addCommand(cmd1);
         auto closeDb = finally([] { db_connection::close(); });
-        db_controller::addFileEvents(cmd1, writeEvents, readEvents );
+        db_controller::addFileEvents(cmd1, writeEvents, readEvents, testStaging());
 
         cmd1.fileReadInfos = {fileReadEventToReadInfo(readEvent1),
                               fileReadEventToReadInfo(readEvent2)};
@@ -279,7 +435,7 @@ private slots:
         fCounter++;
         readEvents.insert({fCounter, fCounter}, readEvent2);
         fCounter++;
-        db_controller::addFileEvents(cmd1, FileWriteEventHash(), readEvents );
+        db_controller::addFileEvents(cmd1, FileWriteEventHash(), readEvents, testStaging());
 
         cmd2.idInDb = db_controller::addCommand(cmd2);
         readEvents.clear();
@@ -287,7 +443,7 @@ private slots:
         fCounter++;
         readEvents.insert({fCounter, fCounter}, readEvent3);
         fCounter++;
-        db_controller::addFileEvents(cmd2, FileWriteEventHash(), readEvents );
+        db_controller::addFileEvents(cmd2, FileWriteEventHash(), readEvents, testStaging());
 
         QCOMPARE(deleteCommandInDb(cmd1.idInDb), 1);
         // readEvent1 is common to both and should remain, readEvent2 should be deleted,
@@ -327,6 +483,725 @@ private slots:
         QCOMPARE(countStoredFiles(), 0);
     }
 
+    /// Migrate a legacy database to the current scheme. Increase
+    /// nCmds to benchmark the migration on a large database.
+    void tMigration(){
+        const int nCmds = 5000;
+        createLegacyDb(nCmds);
+        auto closeDb = finally([] { db_connection::close(); });
+
+        QBENCHMARK_ONCE {
+            db_connection::setupIfNeeded();
+        }
+
+        auto query = db_connection::mkQuery();
+        query->exec("select count(*) from cmd");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), nCmds);
+
+        query->exec("select count(*) from writtenFile where "
+                    "typeof(mtime) != 'integer' or typeof(hash) != 'integer'");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 0);
+
+        const int i = 1234;
+        QueryColumns & queryCols = QueryColumns::instance();
+        SqlQuery q1;
+        q1.addWithAnd(queryCols.cmd_starttime, legacyCmdTime(i));
+        q1.addWithAnd(queryCols.wFile_hash, db_conversions::fromHashValue(legacyHash(i*2)));
+        auto cmdIter = queryForCmd(q1);
+        QVERIFY(cmdIter->next());
+        const CommandInfo& cmd = cmdIter->value();
+        QCOMPARE(cmd.startTime, legacyCmdTime(i));
+        QCOMPARE(cmd.endTime, legacyCmdTime(i).addSecs(1));
+        QCOMPARE(cmd.text, "cmd " + QString::number(i % 100));
+        QCOMPARE(cmd.workingDirectory, "/home/user/" + QString::number(i % 50));
+        QCOMPARE(cmd.fileWriteInfos.size(), 2);
+        sortFileWriteInfos(cmdIter->value().fileWriteInfos);
+        QCOMPARE(cmd.fileWriteInfos.first().hash, legacyHash(i*2));
+        QCOMPARE(cmd.fileWriteInfos.first().path, "/tmp/" + QString::number(i % 1000));
+        QCOMPARE(cmd.fileWriteInfos.first().mtime, legacyCmdTime(i));
+        QVERIFY(! cmdIter->next());
+    }
+
+    void tPrefetch(){
+        const int nCmds = 5;
+        QVector<CommandInfo> cmds;
+        ulong fCounter = 1;
+        for(int i=0; i < nCmds; i++){
+            CommandInfo cmd = generateCmdInfo();
+            cmd.idInDb = db_controller::addCommand(cmd);
+            FileWriteEventHash writeEvents;
+            auto writeEvent = generateFileWriteEvent();
+            writeEvents.insert({fCounter, fCounter}, writeEvent);
+            fCounter++;
+            FileReadEventHash readEvents;
+            auto readEvent = generateFileReadEvent();
+            readEvents.insert({fCounter, fCounter}, readEvent);
+            fCounter++;
+            db_controller::addFileEvents(cmd, writeEvents, readEvents, testStaging());
+            cmd.fileWriteInfos = { fileWriteEventToWriteInfo(writeEvent) };
+            cmd.fileReadInfos = { fileReadEventToReadInfo(readEvent) };
+            cmds.push_back(cmd);
+        }
+        auto closeDb = finally([] { db_connection::close(); });
+
+        SqlQuery q1;
+        q1.addWithAnd(QueryColumns::instance().cmd_id, 0, E_CompareOperator::GT);
+        auto cmdIter = queryForCmd(q1);
+        // pages of 2 commands -> the last page is incomplete
+        cmdIter->setPageSize(2);
+        for(const auto& cmd : cmds){
+            QVERIFY(cmdIter->next());
+            QCOMPARE(cmdIter->value().idInDb, cmd.idInDb);
+            QCOMPARE(cmdIter->value().fileWriteInfos, cmd.fileWriteInfos);
+            QCOMPARE(cmdIter->value().fileReadInfos, cmd.fileReadInfos);
+        }
+        QVERIFY(! cmdIter->next());
+    }
+
+    void tProjection(){
+        CommandInfo cmd = generateCmdInfo();
+        cmd.idInDb = db_controller::addCommand(cmd);
+        FileWriteEventHash writeEvents;
+        FileReadEventHash readEvents;
+        for(ulong i=1; i <= 3; i++){
+            writeEvents.insert({i, i}, generateFileWriteEvent());
+            readEvents.insert({i, i}, generateFileReadEvent());
+        }
+        db_controller::addFileEvents(cmd, writeEvents, readEvents, testStaging());
+        auto closeDb = finally([] { db_connection::close(); });
+
+        SqlQuery q1;
+        q1.addWithAnd(QueryColumns::instance().cmd_id, cmd.idInDb);
+        auto cmdIter = queryForCmd(q1);
+        QVERIFY(cmdIter->next());
+        const CommandInfo fullCmd = cmdIter->value();
+        QCOMPARE(fullCmd.fileWriteInfos.size(), 3);
+        QCOMPARE(fullCmd.fileWriteCount, 3);
+        QCOMPARE(fullCmd.fileReadCount, 3);
+        QVERIFY(fullCmd.fileCountsPerDir.isEmpty());
+
+        CmdQueryProjection projection;
+        projection.maxCountWFiles = 1;
+        projection.maxCountRFiles = 0;
+        projection.fileCountsPerDir = true;
+        cmdIter = queryForCmd(q1);
+        cmdIter->setProjection(projection);
+        QVERIFY(cmdIter->next());
+        const auto& cmdLimited = cmdIter->value();
+        QCOMPARE(cmdLimited.fileWriteInfos.size(), 1);
+        QCOMPARE(cmdLimited.fileWriteInfos.first(), fullCmd.fileWriteInfos.first());
+        QVERIFY(cmdLimited.fileReadInfos.isEmpty());
+        QCOMPARE(cmdLimited.fileWriteCount, 3);
+        QCOMPARE(cmdLimited.fileReadCount, 3);
+
+        DirFileCounts expectedCounts;
+        for(const auto& info : fullCmd.fileWriteInfos){
+            ++expectedCounts[info.path].writeCount;
+        }
+        for(const auto& info : fullCmd.fileReadInfos){
+            ++expectedCounts[info.path].readCount;
+        }
+        QCOMPARE(cmdLimited.fileCountsPerDir.size(), expectedCounts.size());
+        for(auto it = expectedCounts.begin(); it != expectedCounts.end(); ++it){
+            QCOMPARE(cmdLimited.fileCountsPerDir.value(it.key()).writeCount, it.value().writeCount);
+            QCOMPARE(cmdLimited.fileCountsPerDir.value(it.key()).readCount, it.value().readCount);
+        }
+    }
+
+    void tQueryPlan(){
+        // synthetic database: a few commands with file events
+        QString firstReadName;
+        for(int i=0; i < 20; i++){
+            CommandInfo cmd = generateCmdInfo();
+            cmd.idInDb = db_controller::addCommand(cmd);
+            FileWriteEventHash writeEvents;
+            FileReadEventHash readEvents;
+            for(ulong j=1; j <= 3; j++){
+                writeEvents.insert({j, j}, generateFileWriteEvent());
+                auto readEvent = generateFileReadEvent();
+                if(firstReadName.isNull()){
+                    firstReadName = QFileInfo(QString::fromStdString(readEvent.fullPath)).fileName();
+                }
+                readEvents.insert({j, j}, readEvent);
+            }
+            db_controller::addFileEvents(cmd, writeEvents, readEvents, testStaging());
+        }
+        auto closeDb = finally([] { db_connection::close(); });
+        auto & cols = QueryColumns::instance();
+        auto usesTempBTree = [](const QStringList& plan){
+            return plan.join("\n").contains("TEMP B-TREE");
+        };
+
+        // ordering by startTime must not require sorting
+        SqlQuery qTime;
+        qTime.addWithAnd(cols.cmd_starttime, QDateTime(QDate(2019,1,1)), E_CompareOperator::GT);
+        auto plan = db_controller::explainQueryForCmd(qTime);
+        QVERIFY2(plan.join("\n").contains("idx_cmd_startTime"), qPrintable(plan.join("\n")));
+        QVERIFY2(! usesTempBTree(plan), qPrintable(plan.join("\n")));
+
+        // file filters are semi-joins -> no group by over the file rows
+        SqlQuery qFiles;
+        qFiles.addWithAnd(cols.wFile_path, QString("/tmp%"), E_CompareOperator::LIKE);
+        qFiles.addWithAnd(cols.wFile_size, 0, E_CompareOperator::GT);
+        qFiles.addWithAnd(cols.rFile_name, firstReadName);
+        plan = db_controller::explainQueryForCmd(qFiles);
+        const QString planStr = plan.join("\n");
+        QVERIFY2(planStr.contains(QRegularExpression("SEARCH (TABLE )?writtenFile USING")),
+                 qPrintable(planStr));
+        QVERIFY2(planStr.contains("idx_readFileCmd_cmdId"), qPrintable(planStr));
+        QVERIFY2(! usesTempBTree(plan), qPrintable(planStr));
+
+        // the semi-join returns each command once
+        int count = 0;
+        auto cmdIter = queryForCmd(qFiles);
+        while(cmdIter->next()){
+            ++count;
+        }
+        QCOMPARE(count, 1);
+    }
+
+    void tSubtree(){
+        auto closeDb = finally([] { db_connection::close(); });
+        QHash<QString, qint64> cmdIdByDir;
+        for(const QString& dir : {"/tmp", "/tmp/sub/sub", "/tmpfoo", "/var"}){
+            CommandInfo cmd = generateCmdInfo();
+            cmd.idInDb = db_controller::addCommand(cmd);
+            auto writeEvent = generateFileWriteEvent();
+            writeEvent.fullPath = (dir + "/file.txt").toStdString();
+            FileWriteEventHash writeEvents;
+            writeEvents.insert({1, 1}, writeEvent);
+            db_controller::addFileEvents(cmd, writeEvents, {}, testStaging());
+            cmdIdByDir.insert(dir, cmd.idInDb);
+        }
+        auto queryIds = [](const QString& dir){
+            SqlQuery q;
+            q.addWithAnd(QueryColumns::instance().wFile_path, dir, E_CompareOperator::SUBTREE);
+            QSet<qint64> ids;
+            auto cmdIter = queryForCmd(q);
+            while(cmdIter->next()){
+                ids.insert(cmdIter->value().idInDb);
+            }
+            return ids;
+        };
+        const QSet<qint64> tmpIds{cmdIdByDir["/tmp"], cmdIdByDir["/tmp/sub/sub"]};
+        QCOMPARE(queryIds("/tmp"), tmpIds);
+        QCOMPARE(queryIds("/tmp/"), tmpIds);
+        QCOMPARE(queryIds("/tmp/sub"), QSet<qint64>{cmdIdByDir["/tmp/sub/sub"]});
+        QCOMPARE(queryIds("/").size(), cmdIdByDir.size());
+    }
+
+    void tFullTextIndex(){
+        auto closeDb = finally([] { db_connection::close(); });
+        if(! db_connection::hasFullTextIndex()){
+            QSKIP("sqlite without fts5 trigram tokenizer");
+        }
+        CommandInfo cmd1 = generateCmdInfo();
+        cmd1.text = "docker run --rm alpine";
+        cmd1.idInDb = db_controller::addCommand(cmd1);
+        CommandInfo cmd2 = generateCmdInfo();
+        cmd2.text = "make -j4";
+        cmd2.workingDirectory = "/home/user/build/shournal";
+        cmd2.idInDb = db_controller::addCommand(cmd2);
+
+        auto & cols = QueryColumns::instance();
+        SqlQuery qTxt;
+        qTxt.addWithAnd(cols.cmd_txt, QString("%OCKER r%"), E_CompareOperator::LIKE);
+        QVERIFY(db_controller::explainQueryForCmd(qTxt).join("\n").contains("cmdText_fts"));
+        auto cmdIter = queryForCmd(qTxt);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().idInDb, cmd1.idInDb);
+        QVERIFY(! cmdIter->next());
+
+        SqlQuery qCwd;
+        qCwd.addWithAnd(cols.cmd_workingDir, QString("%/build/%"), E_CompareOperator::LIKE);
+        cmdIter = queryForCmd(qCwd);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().idInDb, cmd2.idInDb);
+        QVERIFY(! cmdIter->next());
+
+        // fragments shorter than a trigram are compared by LIKE only
+        SqlQuery qShort;
+        qShort.addWithAnd(cols.cmd_txt, QString("%ak%"), E_CompareOperator::LIKE);
+        cmdIter = queryForCmd(qShort);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().idInDb, cmd2.idInDb);
+        QVERIFY(! cmdIter->next());
+
+        // deleted dictionary entries must vanish from the index
+        SqlQuery qDel;
+        qDel.addWithAnd(cols.cmd_id, cmd1.idInDb);
+        QCOMPARE(db_controller::deleteCommand(qDel), 1);
+        QVERIFY(! queryForCmd(qTxt)->hasNext());
+
+        // a host without fts5 drops the triggers. Entries added meanwhile
+        // must be found, once the index is usable again.
+        auto query = db_connection::mkQuery();
+        for(const QString& trigger : {"cmdText_fts_ai", "cmdText_fts_ad", "cmdText_fts_au",
+                                      "directory_fts_ai", "directory_fts_ad", "directory_fts_au"}){
+            query->exec("drop trigger " + trigger);
+        }
+        CommandInfo cmd3 = generateCmdInfo();
+        cmd3.text = "docker ps -a";
+        cmd3.idInDb = db_controller::addCommand(cmd3);
+        query.reset();
+        db_connection::close();
+        QVERIFY(db_connection::hasFullTextIndex());
+        SqlQuery qRebuilt;
+        qRebuilt.addWithAnd(cols.cmd_txt, QString("%ocker ps%"), E_CompareOperator::LIKE);
+        cmdIter = queryForCmd(qRebuilt);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().idInDb, cmd3.idInDb);
+        QVERIFY(! cmdIter->next());
+    }
+
+    void tInsertBenchmark(){
+        if(! testhelper::benchmarksEnabled()){
+            QSKIP("benchmarks disabled");
+        }
+        auto closeDb = finally([] { db_connection::close(); });
+        // roughly what shournal-run's flushToDisk does per command
+        // -> compare before and after changing the indexes.
+        QBENCHMARK {
+            CommandInfo cmd = generateCmdInfo();
+            cmd.idInDb = db_controller::addCommand(cmd);
+            FileWriteEventHash writeEvents;
+            for(ulong j=1; j <= 100; j++){
+                writeEvents.insert({j, j}, generateFileWriteEvent());
+            }
+            db_controller::addFileEvents(cmd, writeEvents, {}, testStaging());
+        }
+    }
+
+    void tKeysetPagination(){
+        auto closeDb = finally([] { db_connection::close(); });
+        // some commands share the start time -> the id breaks ties
+        QVector<CommandInfo> cmds;
+        for(int i=0; i < 7; i++){
+            CommandInfo cmd = generateCmdInfo();
+            cmd.startTime = QDateTime(QDate(2020, 1, 1 + i / 2));
+            cmd.idInDb = db_controller::addCommand(cmd);
+            cmds.push_back(cmd);
+        }
+        auto & cols = QueryColumns::instance();
+        auto cursorOf = [](const CommandInfo& cmd){
+            return QPair<qint64, qint64>(cmd.startTime.toMSecsSinceEpoch(), cmd.idInDb);
+        };
+        // page forward...
+        QVector<qint64> ids;
+        SqlQuery q;
+        q.setQuery(" 1 ");
+        q.setLimit(3);
+        while(true){
+            auto cmdIter = queryForCmd(q);
+            if(! cmdIter->hasNext()){
+                break;
+            }
+            CommandInfo last;
+            while(cmdIter->next()){
+                ids.push_back(cmdIter->value().idInDb);
+                last = cmdIter->value();
+            }
+            q.clear();
+            q.setLimit(3);
+            q.addKeysetBound(cols.cmd_starttime, cursorOf(last).first,
+                             cols.cmd_id, cursorOf(last).second, true);
+        }
+        QCOMPARE(ids.size(), cmds.size());
+        for(int i=0; i < cmds.size(); i++){
+            QCOMPARE(ids[i], cmds[i].idInDb);
+        }
+
+        // ...and backward, starting before the last command
+        SqlQuery qBefore;
+        qBefore.addKeysetBound(cols.cmd_starttime, cursorOf(cmds.last()).first,
+                               cols.cmd_id, cursorOf(cmds.last()).second, false);
+        qBefore.setAscending(false);
+        qBefore.setLimit(3);
+        auto cmdIter = queryForCmd(qBefore, true);
+        for(int i=cmds.size() - 4; i < cmds.size() - 1; i++){
+            QVERIFY(cmdIter->next());
+            QCOMPARE(cmdIter->value().idInDb, cmds[i].idInDb);
+        }
+        QVERIFY(! cmdIter->next());
+    }
+
+    void tReverseIter(){
+        QVector<qint64> cmdIds;
+        for(int i=0; i < 3; i++){
+            CommandInfo cmd = generateCmdInfo();
+            cmdIds.push_back(db_controller::addCommand(cmd));
+        }
+        auto closeDb = finally([] { db_connection::close(); });
+
+        // the last two commands in ascending order (like --history 2)
+        SqlQuery q1;
+        q1.setQuery(" 1 ");
+        q1.setAscending(false);
+        q1.setLimit(2);
+        auto cmdIter = queryForCmd(q1, true);
+        QVERIFY(cmdIter->hasNext());
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().idInDb, cmdIds[1]);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().idInDb, cmdIds[2]);
+        QVERIFY(! cmdIter->hasNext());
+        QVERIFY(! cmdIter->next());
+
+        SqlQuery q2;
+        q2.addWithAnd(QueryColumns::instance().cmd_id, -1);
+        QVERIFY(! queryForCmd(q2)->hasNext());
+    }
+
+    void tDictionaries(){
+        CommandInfo cmd1 = generateCmdInfo();
+        cmd1.text = "make";
+        CommandInfo cmd2 = generateCmdInfo();
+        cmd2.text = "make";
+
+        cmd1.idInDb = db_controller::addCommand(cmd1);
+        auto closeDb = finally([] { db_connection::close(); });
+        cmd2.idInDb = db_controller::addCommand(cmd2);
+
+        ulong fCounter = 1;
+        FileWriteEventHash writeEvents;
+        writeEvents.insert({fCounter, fCounter}, generateFileWriteEvent());
+        ++fCounter;
+        db_controller::addFileEvents(cmd1, writeEvents, FileReadEventHash(), testStaging());
+        writeEvents.clear();
+        writeEvents.insert({fCounter, fCounter}, generateFileWriteEvent());
+        ++fCounter;
+        db_controller::addFileEvents(cmd2, writeEvents, FileReadEventHash(), testStaging());
+
+        auto query = db_connection::mkQuery();
+        query->exec("select count(*) from cmdText");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 1);
+
+        // "/", "/home", "/home/user" and "/tmp", each only once
+        query->exec("select count(*) from directory");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 4);
+
+        query->exec("select parent.path from directory "
+                    "join directory as parent on parent.id=directory.parentId "
+                    "where directory.path='/home/user'");
+        query->next(true);
+        QCOMPARE(query->value(0).toString(), QString("/home"));
+
+        QueryColumns & queryCols = QueryColumns::instance();
+        SqlQuery q1;
+        q1.addWithAnd(queryCols.wFile_path, "/tmp");
+        q1.addWithAnd(queryCols.cmd_txt, "make");
+        q1.addWithAnd(queryCols.cmd_workingDir, "/home/user");
+        auto cmdIter = queryForCmd(q1);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().text, QString("make"));
+        QCOMPARE(cmdIter->value().workingDirectory, QString("/home/user"));
+        QCOMPARE(cmdIter->value().fileWriteInfos.first().path, QString("/tmp"));
+        QVERIFY(cmdIter->next());
+        QVERIFY(! cmdIter->next());
+
+        SqlQuery delQ;
+        delQ.addWithAnd(queryCols.cmd_txt, "make");
+        QCOMPARE(db_controller::deleteCommand(delQ), 2);
+
+        query->exec("select * from cmdText");
+        QVERIFY(! query->next());
+        query->exec("select * from directory");
+        QVERIFY(! query->next());
+    }
+
+    /// Delete more commands than fit into a single chunk, only
+    /// the parents of deleted commands may be collected.
+    void tChunkedDelete(){
+        CommandInfo keep = generateCmdInfo();
+        keep.text = "keep";
+        keep.idInDb = db_controller::addCommand(keep);
+        auto closeDb = finally([] { db_connection::close(); });
+
+        const int nCmds = 2500;
+        for(int i=0; i < nCmds; i++){
+            CommandInfo cmd = generateCmdInfo();
+            cmd.text = "rm";
+            // generateCmdInfo's day of month cycles through 0 (invalid)
+            cmd.startTime = QDateTime(QDate(2019, 1, 1));
+            cmd.endTime = cmd.startTime;
+            cmd.workingDirectory = "/home/user/tmp";
+            db_controller::addCommand(cmd);
+        }
+
+        QVector<int> progressCalls;
+        QSet<int> totals;
+        SqlQuery delQ;
+        delQ.addWithAnd(QueryColumns::instance().cmd_txt, "rm");
+        const int countOfDeleted = db_controller::deleteCommand(delQ,
+            [&progressCalls, &totals](int processed, int total){
+            totals.insert(total);
+            progressCalls.push_back(processed);
+        });
+        QCOMPARE(countOfDeleted, nCmds);
+        QCOMPARE(progressCalls, QVector<int>({1000, 2000, nCmds}));
+        QCOMPARE(totals, QSet<int>{nCmds});
+
+        auto query = db_connection::mkQuery();
+        query->exec("select txt from cmdText");
+        query->next(true);
+        QCOMPARE(query->value(0).toString(), QString("keep"));
+        QVERIFY(! query->next());
+
+        // "/", "/home" and "/home/user" are still referenced
+        query->exec("select count(*) from directory");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 3);
+    }
+
+    /// Move past years into their own database file, query across
+    /// them and delete a whole year by removing its file.
+    void tPartitions(){
+        CommandInfo oldCmd = generateCmdInfo();
+        oldCmd.startTime = QDateTime(QDate(2019, 1, 1));
+        oldCmd.endTime = oldCmd.startTime;
+        oldCmd.idInDb = db_controller::addCommand(oldCmd);
+        auto closeDb = finally([] { db_connection::close(); });
+        ulong fCounter = 1;
+        FileWriteEventHash writeEvents;
+        writeEvents.insert({fCounter, fCounter}, generateFileWriteEvent());
+        db_controller::addFileEvents(oldCmd, writeEvents, FileReadEventHash(), testStaging());
+
+        CommandInfo newCmd = generateCmdInfo();
+        newCmd.text = "new";
+        newCmd.startTime = QDateTime::currentDateTime();
+        newCmd.endTime = newCmd.startTime;
+        newCmd.idInDb = db_controller::addCommand(newCmd);
+
+        QCOMPARE(db_partitions::archiveCompletedYears(), 1);
+        QCOMPARE(db_partitions::existing().size(), 1);
+        QCOMPARE(db_partitions::existing().first().firstYear, oldCmd.startTime.date().year());
+        {
+            auto query = db_connection::mkQuery();
+            query->exec("select id from main.cmd");
+            query->next(true);
+            QCOMPARE(query->value(0).toLongLong(), newCmd.idInDb);
+        }
+
+        QueryColumns & queryCols = QueryColumns::instance();
+        const QDateTime thisYear(QDate(newCmd.startTime.date().year(), 1, 1));
+        {
+            // no partition is needed
+            SqlQuery q;
+            q.addWithAnd(queryCols.cmd_starttime, thisYear, E_CompareOperator::GE);
+            auto cmdIter = queryForCmd(q);
+            QVERIFY(cmdIter->next());
+            QCOMPARE(cmdIter->value().idInDb, newCmd.idInDb);
+            QVERIFY(! cmdIter->next());
+            QVERIFY(db_partitions::attached().isEmpty());
+        }
+        {
+            SqlQuery q;
+            q.addWithAnd(queryCols.wFile_path, "/tmp");
+            auto cmdIter = queryForCmd(q);
+            QVERIFY(cmdIter->next());
+            QCOMPARE(cmdIter->value().idInDb, oldCmd.idInDb);
+            QCOMPARE(cmdIter->value().fileWriteInfos.size(), 1);
+            QVERIFY(! cmdIter->next());
+            QCOMPARE(db_partitions::attached().size(), 1);
+        }
+
+        SqlQuery delQ;
+        delQ.addWithAnd(queryCols.cmd_starttime, thisYear, E_CompareOperator::LT);
+        QCOMPARE(db_controller::deleteCommand(delQ), 1);
+        QVERIFY(db_partitions::existing().isEmpty());
+
+        auto query = db_connection::mkQuery();
+        query->exec("select count(*) from directory where path='/tmp'");
+        query->next(true);
+        QCOMPARE(query->value(0).toInt(), 0);
+    }
+
+    /// More years than sqlite can attach at once (besides the store of read
+    /// files) are merged into partitions spanning several years.
+    void tPartitionLimit(){
+        const int nYears = db_partitions::MAX_PARTITIONS + 4;
+        const int firstYear = 2008;
+        QVector<qint64> ids;
+        for(int i=0; i < nYears; i++){
+            CommandInfo cmd = generateCmdInfo();
+            cmd.startTime = QDateTime(QDate(firstYear + i, 6, 1));
+            cmd.endTime = cmd.startTime;
+            cmd.idInDb = db_controller::addCommand(cmd);
+            FileWriteEventHash writeEvents;
+            writeEvents.insert({1, 1}, generateFileWriteEvent());
+            db_controller::addFileEvents(cmd, writeEvents, FileReadEventHash(), testStaging());
+            ids.push_back(cmd.idInDb);
+        }
+        auto closeDb = finally([] { db_connection::close(); });
+
+        QCOMPARE(db_partitions::archiveCompletedYears(), nYears);
+        auto partitions = db_partitions::existing();
+        QCOMPARE(partitions.size(), db_partitions::MAX_PARTITIONS);
+        QCOMPARE(partitions.first().firstYear, firstYear);
+        QCOMPARE(partitions.first().lastYear, firstYear + nYears - db_partitions::MAX_PARTITIONS);
+        QCOMPARE(partitions.last().firstYear, firstYear + nYears - 1);
+        QCOMPARE(partitions.last().lastYear, firstYear + nYears - 1);
+
+        // unbounded, like --history
+        SqlQuery q;
+        q.setQuery(" 1 ");
+        QVector<qint64> foundIds;
+        auto cmdIter = queryForCmd(q);
+        while(cmdIter->next()){
+            foundIds.push_back(cmdIter->value().idInDb);
+            QCOMPARE(cmdIter->value().fileWriteInfos.size(), 1);
+        }
+        QCOMPARE(foundIds, ids);
+        QCOMPARE(db_partitions::attached().size(), db_partitions::MAX_PARTITIONS);
+
+        // a late command of a merged year goes to the merged partition
+        CommandInfo late = generateCmdInfo();
+        late.startTime = QDateTime(QDate(firstYear + 1, 1, 2));
+        late.endTime = late.startTime;
+        late.idInDb = db_controller::addCommand(late);
+        QCOMPARE(db_partitions::archiveCompletedYears(), 1);
+        partitions = db_partitions::existing();
+        QCOMPARE(partitions.size(), db_partitions::MAX_PARTITIONS);
+        QCOMPARE(partitions.first().firstYear, firstYear);
+    }
+
+    /// Commands still observed at the turn of the year stay in the main
+    /// database. One archived nevertheless can still be completed.
+    void tPartitionsRunningCmd(){
+        CommandInfo running = generateCmdInfo();
+        running.startTime = QDateTime(QDate(2019, 12, 31));
+        // preliminary, as stored by a flush during its execution
+        running.endTime = QDateTime::currentDateTime();
+        running.idInDb = db_controller::addCommand(running);
+        auto closeDb = finally([] { db_connection::close(); });
+
+        CommandInfo archived = generateCmdInfo();
+        archived.startTime = running.startTime;
+        archived.endTime = running.startTime;
+        archived.idInDb = db_controller::addCommand(archived);
+
+        QCOMPARE(db_partitions::archiveCompletedYears(), 1);
+        {
+            auto query = db_connection::mkQuery();
+            query->exec("select id from main.cmd");
+            query->next(true);
+            QCOMPARE(query->value(0).toLongLong(), running.idInDb);
+            QVERIFY(! query->next());
+        }
+
+        FileWriteEventHash writeEvents;
+        writeEvents.insert({1, 1}, generateFileWriteEvent());
+        db_controller::addFileEvents(archived, writeEvents, FileReadEventHash(), testStaging());
+        archived.returnVal = 7;
+        db_controller::updateCommand(archived);
+
+        SqlQuery q;
+        q.addWithAnd(QueryColumns::instance().cmd_id, archived.idInDb);
+        auto cmdIter = queryForCmd(q);
+        QVERIFY(cmdIter->next());
+        QCOMPARE(cmdIter->value().returnVal, 7);
+        QCOMPARE(cmdIter->value().fileWriteInfos.size(), 1);
+        QVERIFY(! cmdIter->next());
+    }
+
+    /// Read files with equal content share one compressed blob,
+    /// which is deleted along with the last read file.
+    /// Read files stored by older versions are still found.
+    void tStoredBlobs(){
+        const QByteArray content(10000, 'a');
+        auto readEvent1 = generateFileReadEvent();
+        stageScript(readEvent1, content);
+        readEvent1.size = content.size();
+        auto readEvent2 = generateFileReadEvent();
+        stageScript(readEvent2, content);
+        readEvent2.size = content.size();
+
+        CommandInfo cmd1 = generateCmdInfo();
+        cmd1.idInDb = db_controller::addCommand(cmd1);
+        auto closeDb = finally([] { db_connection::close(); });
+        CommandInfo cmd2 = generateCmdInfo();
+        cmd2.idInDb = db_controller::addCommand(cmd2);
+
+        FileReadEventHash readEvents;
+        readEvents.insert({1, 1}, readEvent1);
+        db_controller::addFileEvents(cmd1, FileWriteEventHash(), readEvents, testStaging());
+        readEvents.clear();
+        readEvents.insert({2, 2}, readEvent2);
+        db_controller::addFileEvents(cmd2, FileWriteEventHash(), readEvents, testStaging());
+
+        QCOMPARE(countStoredFiles(), 1);
+        const QString blobHash = StoredFiles::mkBlobHash(content);
+        {
+            auto query = db_connection::mkQuery();
+            query->prepare("select length(data) from blobs.blob where hash=?");
+            query->addBindValue(blobHash);
+            query->exec();
+            query->next(true);
+            QVERIFY(query->value(0).toLongLong() < readEvent1.size);
+        }
+
+        const auto readInfos = db_controller::queryReadInfos_byCmdId(cmd2.idInDb);
+        QCOMPARE(readInfos.size(), 1);
+        QCOMPARE(readInfos.first().blobHash, blobHash);
+        QCOMPARE(StoredFiles().readContent(readInfos.first()), content);
+
+        QCOMPARE(deleteCommandInDb(cmd1.idInDb), 1);
+        QCOMPARE(countStoredFiles(), 1);
+        QCOMPARE(deleteCommandInDb(cmd2.idInDb), 1);
+        QCOMPARE(countStoredFiles(), 0);
+
+        FileReadInfo legacyInfo = readInfos.first();
+        legacyInfo.blobHash.clear();
+        QVERIFY(QDir().mkpath(StoredFiles::getReadFilesDir()));
+        QFile legacyFile(StoredFiles::getReadFilesDir() + "/" +
+                         QString::number(legacyInfo.idInDb));
+        QVERIFY(legacyFile.open(QFile::WriteOnly));
+        legacyFile.write("legacy");
+        legacyFile.close();
+        QCOMPARE(StoredFiles().readContent(legacyInfo), QByteArray("legacy"));
+    }
+
+    /// Read files stored by older versions are moved into the blob store,
+    /// when the database is opened.
+    void tLegacyStoredFilesMigration(){
+        const QByteArray content(5000, 'b');
+        auto readEvent = generateFileReadEvent();
+        stageScript(readEvent, content);
+        readEvent.size = content.size();
+        CommandInfo cmd = generateCmdInfo();
+        cmd.idInDb = db_controller::addCommand(cmd);
+        auto closeDb = finally([] { db_connection::close(); });
+        FileReadEventHash readEvents;
+        readEvents.insert({1, 1}, readEvent);
+        db_controller::addFileEvents(cmd, FileWriteEventHash(), readEvents, testStaging());
+
+        // turn it into a read file as stored by shournal 2.3
+        const qint64 readFileId = db_controller::queryReadInfos_byCmdId(cmd.idInDb).first().idInDb;
+        const QString legacyPath = StoredFiles::getReadFilesDir() + "/" +
+                                   QString::number(readFileId);
+        {
+            auto query = db_connection::mkQuery();
+            query->exec("update readFile set blobHash=NULL");
+            query->exec("delete from blobs.blob");
+            QVERIFY(QDir().mkpath(StoredFiles::getReadFilesDir()));
+            testhelper::writeStringToFile(legacyPath, QString::fromLatin1(content));
+        }
+        db_connection::close();
+
+        const auto readInfos = db_controller::queryReadInfos_byCmdId(cmd.idInDb);
+        QCOMPARE(readInfos.size(), 1);
+        QCOMPARE(readInfos.first().blobHash, StoredFiles::mkBlobHash(content));
+        QVERIFY(! QFileInfo::exists(legacyPath));
+        // so later opens skip the migration
+        QVERIFY(! QFileInfo::exists(StoredFiles::getReadFilesDir()));
+        QCOMPARE(countStoredFiles(), 1);
+        QCOMPARE(StoredFiles().readContent(readInfos.first()), content);
+    }
+
 };
 
 
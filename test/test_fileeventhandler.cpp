@@ -101,17 +101,47 @@ private slots:
 
     }
 
+    /// The script is staged and its hash is calculated from the staged copy,
+    /// which must equal the one of the original file.
     void tRead(){
-        // TODO: implement a test...
+        char tmpFileName[] = "fileevent_read_test_XXXXXX";
+        int fd = mkstemp(tmpFileName);
+        auto rmTmpFile = finally([&tmpFileName] { remove(tmpFileName); });
 
-        auto & readSettings = Settings::instance().m_scriptSettings;
+        auto & sets = Settings::instance();
+        auto & readSettings = sets.m_scriptSettings;
         readSettings.enable = true;
         readSettings.includePaths.insert("/"); // todo: mk unique path
         readSettings.maxFileSize = 50000;
         readSettings.onlyWritable = true;
+        readSettings.excludeHidden = false;
         readSettings.includeExtensions = {};
+        readSettings.includeMimetypes = {};
         readSettings.maxCountOfFiles = 1;
         readSettings.flushToDiskTotalSize = 10*1000;
+
+        sets.m_hashSettings.hashEnable = true;
+        sets.m_hashSettings.hashMeta = HashMeta(2, 3);
+
+        const QByteArray content = "#!/bin/sh\n" + QByteArray(100, '#') + "\necho hi\n";
+        os::write(fd, content);
+        lseek(fd, 0, SEEK_SET);
+
+        FileEventHandler fEventHandler;
+        fEventHandler.handleCloseRead(fd);
+        QCOMPARE(os::ltell(fd), off_t(0));
+        QCOMPARE(fEventHandler.readEvents().size(), 1);
+        const auto readEvent = fEventHandler.readEvents().begin().value();
+        QCOMPARE(readEvent.stagedSize, off64_t(content.size()));
+        QCOMPARE(fEventHandler.scriptStaging().read(readEvent.stagedOffset,
+                                                    readEvent.stagedSize), content);
+
+        HashControl hashCtrl;
+        QVERIFY(readEvent.hash ==
+                hashCtrl.genPartlyHash(fd, content.size(), sets.m_hashSettings.hashMeta));
+
+        fEventHandler.clearEvents();
+        QCOMPARE(fEventHandler.sizeOfCachedReadFiles(), off64_t(0));
     }
 
 };
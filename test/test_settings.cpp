@@ -0,0 +1,76 @@
+
+#include <QTest>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "autotest.h"
+#include "helper_for_test.h"
+
+#include "settings.h"
+#include "qsimplecfg/cfg.h"
+
+
+class SettingsTest : public QObject {
+    Q_OBJECT
+
+    void writeCfgFile(const QStringList& fileExtensions, bool sessionObserver){
+        auto & sets = Settings::instance();
+        qsimplecfg::Cfg cfg;
+        auto sectScripts = cfg[Settings::SECT_SCRIPTS_NAME];
+        sectScripts->getValues(Settings::SECT_SCRIPTS_INCLUDE_FILE_EXTENSIONS,
+                               fileExtensions, true, "\n");
+        auto sectShell = cfg[Settings::SECT_SHELL_NAME];
+        sectShell->getValue(Settings::SECT_SHELL_SESSION_OBSERVER, sessionObserver, true);
+        const auto cfgPath = sets.cfgFilepath();
+        QDir().mkpath(QFileInfo(cfgPath).absolutePath());
+        cfg.store(cfgPath);
+    }
+
+private slots:
+    void cleanup(){
+        testhelper::deletePaths();
+    }
+
+    void tSnapshot() {
+        testhelper::deletePaths();
+        auto & sets = Settings::instance();
+        writeCfgFile({"sh", "py"}, true);
+
+        sets.load();
+        QVERIFY(! sets.m_loadedFromSnapshot);
+        QVERIFY(QFile::exists(sets.snapshotFilepath()));
+
+        sets.load();
+        QVERIFY(sets.m_loadedFromSnapshot);
+        QVERIFY(sets.sessionObserver());
+        QCOMPARE(sets.readEventScriptSettings().includeExtensions,
+                 Settings::StringSet({"sh", "py"}));
+        QVERIFY(sets.writeFileSettings().includePaths.contains("/"));
+        QVERIFY(sets.getMountIgnorePaths().find("/proc") !=
+                sets.getMountIgnorePaths().end());
+
+        // a changed config file must be parsed again
+        writeCfgFile({"sh"}, false);
+        sets.load();
+        QVERIFY(! sets.m_loadedFromSnapshot);
+        QVERIFY(! sets.sessionObserver());
+        QCOMPARE(sets.readEventScriptSettings().includeExtensions,
+                 Settings::StringSet({"sh"}));
+
+        // so must a corrupt snapshot
+        QFile snapshot(sets.snapshotFilepath());
+        QVERIFY(snapshot.open(QFile::OpenModeFlag::ReadWrite));
+        snapshot.resize(snapshot.size() / 2);
+        snapshot.close();
+        sets.load();
+        QVERIFY(! sets.m_loadedFromSnapshot);
+        QCOMPARE(sets.readEventScriptSettings().includeExtensions,
+                 Settings::StringSet({"sh"}));
+    }
+};
+
+
+DECLARE_TEST(SettingsTest)
+
+#include "test_settings.moc"
@@ -0,0 +1,111 @@
+
+#include <QTest>
+#include <QElapsedTimer>
+#include <sys/mman.h>
+
+#include "autotest.h"
+#include "qoutstream.h"
+#include "subprocess.h"
+#include "excos.h"
+#include "cleanupresource.h"
+#include "helper_for_test.h"
+
+using subprocess::Subprocess;
+
+namespace  {
+
+/// @return the exit code of a shell, which checks whether the
+/// passed fd is open.
+int callFdOpenCheck(bool useFork, int fd, bool forward){
+    Subprocess proc;
+    proc.setUseFork(useFork);
+    if(forward){
+        proc.setForwardFdsOnExec({fd});
+    }
+    proc.call({"/bin/sh", "-c", "[ -e /dev/fd/" + std::to_string(fd) + " ]"});
+    return proc.waitFinish();
+}
+
+/// @return the average time in microseconds to launch and wait for /bin/true
+qint64 measureLaunchLatencyUs(bool useFork, int count){
+    QElapsedTimer timer;
+    timer.start();
+    for(int i=0; i < count; i++){
+        Subprocess proc;
+        proc.setUseFork(useFork);
+        proc.call({"/bin/true"});
+        proc.waitFinish();
+    }
+    return timer.nsecsElapsed() / 1000 / count;
+}
+
+} // namespace
+
+
+class SubprocessTest : public QObject {
+    Q_OBJECT
+private slots:
+    void tCall_data(){
+        QTest::addColumn<bool>("useFork");
+        QTest::newRow("spawn") << false;
+        QTest::newRow("fork") << true;
+    }
+
+    void tCall(){
+        QFETCH(bool, useFork);
+        Subprocess proc;
+        proc.setUseFork(useFork);
+        proc.call({"/bin/sh", "-c", "exit 7"});
+        QCOMPARE(proc.waitFinish(), 7);
+
+        bool thrown = false;
+        try {
+            proc.call({"/nonexisting/shournal-test-executable"});
+        } catch (const os::ExcOs& ex) {
+            thrown = true;
+            QCOMPARE(ex.errorNumber(), ENOENT);
+        }
+        QVERIFY(thrown);
+
+        thrown = false;
+        try {
+            proc.callDetached({"/nonexisting/shournal-test-executable"});
+        } catch (const os::ExcOs& ex) {
+            thrown = true;
+            QCOMPARE(ex.errorNumber(), ENOENT);
+        }
+        QVERIFY(thrown);
+
+        // fds are closed, unless forwarded, even without O_CLOEXEC
+        const int fd = os::open("/dev/null", O_RDONLY, false);
+        auto closeFd = finally([&fd] { os::close(fd); });
+        QCOMPARE(callFdOpenCheck(useFork, fd, false), 1);
+        QCOMPARE(callFdOpenCheck(useFork, fd, true), 0);
+    }
+
+    /// Compare the launch latency of fork and spawn from a process with a
+    /// large resident memory. The results are printed, not asserted.
+    void tLaunchLatency(){
+        if(! testhelper::benchmarksEnabled()){
+            QSKIP("benchmarks disabled");
+        }
+        const size_t memSize = size_t(2) << 30;
+        void* mem = mmap(nullptr, memSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(mem == MAP_FAILED){
+            QSKIP("Failed to allocate 2 GiB");
+        }
+        auto unmap = finally([&mem, &memSize] { munmap(mem, memSize); });
+
+        const int count = 50;
+        const qint64 spawnUs = measureLaunchLatencyUs(false, count);
+        const qint64 forkUs = measureLaunchLatencyUs(true, count);
+        QOut() << "launch latency with 2 GiB RSS: spawn " << spawnUs << "us, "
+               << "fork " << forkUs << "us\n";
+    }
+};
+
+
+DECLARE_TEST(SubprocessTest)
+
+#include "test_subprocess.moc"